@@ -0,0 +1,234 @@
+#include "pch.h"
+#include "BTreeRecordManager.h"
+#include "../DatabaseSystem.Core/Assertions.h"
+
+BTreeRecordManager::BTreeRecordManager(size_t blockSize, BufferPool* bufferPool) :
+    BaseRecordManager(blockSize, bufferPool),
+    m_Tree(blockSize, m_BufferPool),
+    m_OrderedByColumnId(0)
+{
+}
+
+BTreeRecordManager::BTreeRecordManager(size_t blockSize, unsigned int orderedByColumnId, BufferPool* bufferPool) : BTreeRecordManager(blockSize, bufferPool)
+{
+    m_OrderedByColumnId = orderedByColumnId;
+}
+
+void BTreeRecordManager::Create(string path, Schema* schema)
+{
+    // The tree makes its files and their heads, the file of the leaves is the file of the records
+    m_Tree.Create(path, schema, m_OrderedByColumnId);
+    InitializeCreatedFile(path);
+}
+
+void BTreeRecordManager::Open(string path)
+{
+    m_Tree.Open(path);
+    m_OrderedByColumnId = m_Tree.GetKeyColumnId();
+    InitializeOpenedFile(path);
+}
+
+void BTreeRecordManager::Close()
+{
+    // Every record is in the tree, the write block is never used
+    CloseIndexes();
+    m_Tree.Close();
+}
+
+void BTreeRecordManager::SetFileAccessMode(FileAccessMode mode)
+{
+    m_Tree.SetFileAccessMode(mode);
+}
+
+void BTreeRecordManager::SetWriteBack(bool enabled)
+{
+    m_Tree.SetWriteBack(enabled);
+}
+
+void BTreeRecordManager::Checkpoint()
+{
+    m_Tree.Checkpoint();
+    BaseRecordManager::Checkpoint();
+}
+
+void BTreeRecordManager::Insert(Record record)
+{
+    ClearAccessCount();
+    auto fileHead = GetFile()->GetHead();
+    auto btreeRecord = record.As<BaseRecord>();
+    btreeRecord->Id = fileHead->NextId;
+    fileHead->NextId += 1;
+
+    auto recordData = record.GetData();
+    BPlusTree::EntryPosition position;
+    m_Tree.Insert(*recordData, &position);
+    AddTreeAccessCount();
+
+    if (position.Moved)
+    {
+        // Records of the leaf moved to make room, the positions kept by the indexes are no longer valid
+        InvalidateIndexes();
+        return;
+    }
+    AddToIndexes(*recordData, position.LeafId, position.Index);
+}
+
+Record* BTreeRecordManager::Select(unsigned long long id)
+{
+    // if the file is not ordered by id, linear search the leaves
+    if (m_OrderedByColumnId != 0)
+    {
+        return BaseRecordManager::Select(id);
+    }
+
+    ClearAccessCount();
+    auto record = new Record(GetSchema());
+    auto found = m_Tree.Find(span<const unsigned char>((unsigned char*)&id, sizeof(id)), id, *record->GetData());
+    AddTreeAccessCount();
+    if (!found)
+    {
+        delete record;
+        return nullptr;
+    }
+    return record;
+}
+
+ResultSet BTreeRecordManager::Select(vector<unsigned long long> ids)
+{
+    if (m_OrderedByColumnId != 0)
+    {
+        return BaseRecordManager::Select(ids);
+    }
+
+    // In order, close ids go down the same path and find its pages in the buffer pool
+    ClearAccessCount();
+    sort(ids.begin(), ids.end());
+    ids.erase(unique(ids.begin(), ids.end()), ids.end());
+
+    auto records = ResultSet(GetSchema());
+    auto record = vector<unsigned char>(GetSchema()->GetSize());
+    for (auto id : ids)
+    {
+        if (m_Tree.Find(span<const unsigned char>((unsigned char*)&id, sizeof(id)), id, record))
+        {
+            records.Append(record);
+        }
+    }
+    AddTreeAccessCount();
+    return records;
+}
+
+ResultSet BTreeRecordManager::SelectWhere(const Predicate& predicate, const Projection* projection)
+{
+    vector<unsigned char> min, max;
+    if (!GetKeyRange(predicate, min, max))
+    {
+        return BaseRecordManager::SelectWhere(predicate, projection);
+    }
+
+    // The nodes read by the search are not returned by the cursor, they are added back
+    ClearAccessCount();
+    auto cursor = m_Tree.OpenCursor(min, max, predicate.ToFilter(GetSchema()));
+    AddTreeAccessCount();
+    auto searchReadsCount = m_LastQueryBlockReadAccessCount;
+    auto records = Materialize(*cursor, projection);
+    m_LastQueryBlockReadAccessCount += searchReadsCount;
+    return records;
+}
+
+unique_ptr<RecordCursor> BTreeRecordManager::OpenCursorWhere(const Predicate& predicate)
+{
+    vector<unsigned char> min, max;
+    if (!GetKeyRange(predicate, min, max))
+    {
+        return BaseRecordManager::OpenCursorWhere(predicate);
+    }
+    auto cursor = m_Tree.OpenCursor(min, max, predicate.ToFilter(GetSchema()));
+    AddTreeAccessCount();
+    return cursor;
+}
+
+void BTreeRecordManager::Delete(unsigned long long id)
+{
+    auto record = Select(id);
+    if (record == nullptr)
+    {
+        return;
+    }
+    Remove(*record->GetData());
+    delete record;
+}
+
+int BTreeRecordManager::DeleteWhere(const Predicate& predicate)
+{
+    // Removing a record may merge leaves and move other records, so the positions seen by the select are not kept
+    auto records = SelectWhere(predicate);
+    for (auto record : records)
+    {
+        Remove(record.GetData());
+    }
+    return (int)records.size();
+}
+
+FileHead* BTreeRecordManager::CreateNewFileHead(Schema* schema)
+{
+    // Create and Open leave the heads of its files to the tree
+    auto fileHead = new BPlusTreeFileHead(schema);
+    fileHead->KeyColumnId = m_OrderedByColumnId;
+    return fileHead;
+}
+
+FileWrapper<FileHead>* BTreeRecordManager::GetFile()
+{
+    return (FileWrapper<FileHead>*)m_Tree.GetLeafFile();
+}
+
+void BTreeRecordManager::DeleteInternal(unsigned long long recordId, unsigned long long blockNumber, unsigned long long recordNumberInBlock)
+{
+    // The record is removed from the tree by its key, read at the position given
+    ReadBlock(m_ReadBlock, blockNumber);
+    span<unsigned char> record;
+    if (!m_ReadBlock->GetRecordSpan(recordNumberInBlock, &record) || *(unsigned long long*)record.data() != recordId)
+    {
+        Assert(false, "Record not found");
+        return;
+    }
+    Remove(vector<unsigned char>(record.begin(), record.end()));
+}
+
+void BTreeRecordManager::Reorganize()
+{
+    // Pages are split and merged as records come and go, there is nothing left to reorganize
+}
+
+void BTreeRecordManager::Remove(span<const unsigned char> record)
+{
+    auto& column = GetSchema()->GetColumn(m_OrderedByColumnId);
+    RemoveFromIndexes(record);
+
+    bool moved;
+    m_Tree.Remove(record.subspan(column.Offset, column.Length), *(unsigned long long*)record.data(), &moved);
+    AddTreeAccessCount();
+    if (moved)
+    {
+        InvalidateIndexes();
+    }
+}
+
+bool BTreeRecordManager::GetKeyRange(const Predicate& predicate, vector<unsigned char>& min, vector<unsigned char>& max)
+{
+    // The tree only helps when the predicate bounds the ordering column, with values of the size of the column
+    auto length = GetSchema()->GetColumn(m_OrderedByColumnId).Length;
+    if (!predicate.GetRange(GetSchema(), m_OrderedByColumnId, min, max) || (min.empty() && max.empty()))
+    {
+        return false;
+    }
+    return (min.empty() || min.size() == length) && (max.empty() || max.size() == length);
+}
+
+void BTreeRecordManager::AddTreeAccessCount()
+{
+    m_LastQueryBlockReadAccessCount += m_Tree.GetReadBlocksCount();
+    m_LastQueryBlockWriteAccessCount += m_Tree.GetWrittenBlocksCount();
+    m_Tree.ClearAccessCount();
+}
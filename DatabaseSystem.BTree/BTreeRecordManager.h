@@ -0,0 +1,53 @@
+#pragma once
+#include "../DatabaseSystem.Core/BaseRecordManager.h"
+#include "../DatabaseSystem.Core/Record.h"
+#include "../DatabaseSystem.Core/File.h"
+#include "../DatabaseSystem.Core/Block.h"
+#include "../DatabaseSystem.Core/BPlusTree.h"
+
+/*
+  B+Tree, ou arquivo organizado em rvore B+ com os registros nas folhas (clustered), ordenados por uma coluna (o Id por padro).
+  Inseres e remoes dividem e juntam as pginas  medida que acontecem (ver BPlusTree), ento o arquivo nunca precisa
+  de reorganizao. As folhas so ligadas entre si para as buscas por faixa, e a busca por chave l uma pgina por nvel.
+*/
+class BTreeRecordManager : public BaseRecordManager
+{
+public:
+    BTreeRecordManager(size_t blockSize, BufferPool* bufferPool = nullptr);
+    BTreeRecordManager(size_t blockSize, unsigned int orderedByColumnId, BufferPool* bufferPool = nullptr);
+    virtual void Create(string path, Schema* schema) override;
+    virtual void Open(string path) override;
+    virtual void Close() override;
+    virtual void SetFileAccessMode(FileAccessMode mode) override;
+    virtual void SetWriteBack(bool enabled) override;
+    virtual void Checkpoint() override;
+
+    // Inherited via BaseRecordManager
+    virtual void Insert(Record record) override;
+    // Searches the tree when ordered by the id, scans the leaves otherwise
+    virtual Record* Select(unsigned long long id) override;
+    virtual ResultSet Select(vector<unsigned long long> ids) override;
+    // Conditions on the ordering column only read the leaves of their range
+    virtual ResultSet SelectWhere(const Predicate& predicate, const Projection* projection = nullptr) override;
+    virtual unique_ptr<RecordCursor> OpenCursorWhere(const Predicate& predicate) override;
+    virtual void Delete(unsigned long long id) override;
+    // The records are found first (through the tree when possible) and then removed by key
+    virtual int DeleteWhere(const Predicate& predicate) override;
+
+protected:
+    // Inherited via BaseRecordManager
+    virtual FileHead* CreateNewFileHead(Schema* schema) override;
+    virtual FileWrapper<FileHead>* GetFile() override;
+    virtual void DeleteInternal(unsigned long long recordId, unsigned long long blockNumber, unsigned long long recordNumberInBlock) override;
+    virtual void Reorganize() override;
+
+private:
+    BPlusTree m_Tree;
+    unsigned int m_OrderedByColumnId;
+
+    void Remove(span<const unsigned char> record);
+    // Bounds of the ordering column set by the predicate, false when it has none the tree can search for
+    bool GetKeyRange(const Predicate& predicate, vector<unsigned char>& min, vector<unsigned char>& max);
+    // Adds the blocks read and written by the tree since the last call to the query access count
+    void AddTreeAccessCount();
+};
@@ -0,0 +1,5 @@
+#pragma once
+
+#include "BetterEnums.h"
+
+BETTER_ENUM(AggregateFunction, int, COUNT, SUM, MIN, MAX, AVG)
@@ -0,0 +1,266 @@
+#include "pch.h"
+#include "Aggregation.h"
+#include <unordered_map>
+
+namespace
+{
+	template <typename T>
+	T Load(const unsigned char* data)
+	{
+		T value;
+		memcpy(&value, data, sizeof(T));
+		return value;
+	}
+
+	template <typename T>
+	void Add(const unsigned char* value, unsigned char* state)
+	{
+		auto total = Load<T>(state) + Load<T>(value);
+		memcpy(state, &total, sizeof(T));
+	}
+
+	template <typename TValue, typename TTotal>
+	void AddAs(const unsigned char* value, unsigned char* state)
+	{
+		auto total = Load<TTotal>(state) + (TTotal)Load<TValue>(value);
+		memcpy(state, &total, sizeof(TTotal));
+	}
+
+	template <typename T>
+	void Keep(bool smaller, const unsigned char* value, unsigned char* state)
+	{
+		auto candidate = Load<T>(value);
+		auto current = Load<T>(state);
+		if (smaller ? candidate < current : candidate > current)
+		{
+			memcpy(state, &candidate, sizeof(T));
+		}
+	}
+
+	bool IsInteger(ColumnType type)
+	{
+		return type == +ColumnType::INT32 || type == +ColumnType::INT64;
+	}
+}
+
+Aggregation::Aggregation(const Schema* schema, const vector<unsigned int>& groupByColumnIds, const vector<Aggregate>& aggregates) :
+	m_Source(schema),
+	m_Schema(make_unique<Schema>())
+{
+	for (auto columnId : groupByColumnIds)
+	{
+		if (columnId >= schema->GetColumnsCount())
+		{
+			throw runtime_error("Invalid column " + to_string(columnId));
+		}
+		auto& column = schema->GetColumn(columnId);
+		m_Schema->AddColumn(column.Name, column.Type, column.ArraySize);
+		m_GroupByColumns.push_back(&column);
+	}
+
+	for (auto& aggregate : aggregates)
+	{
+		auto offset = m_Schema->GetSize();
+		auto function = aggregate.Function;
+		auto name = string(function._to_string());
+		if (function == +AggregateFunction::COUNT)
+		{
+			m_Schema->AddColumn(name + "(*)", ColumnType::INT64);
+			m_Accumulators.push_back({ function, nullptr, offset });
+			continue;
+		}
+
+		if (aggregate.ColumnId >= schema->GetColumnsCount())
+		{
+			throw runtime_error("Invalid column " + to_string(aggregate.ColumnId));
+		}
+		auto& column = schema->GetColumn(aggregate.ColumnId);
+		name += "(" + column.Name + ")";
+		switch (function)
+		{
+		case AggregateFunction::SUM:
+		case AggregateFunction::AVG:
+			if (column.Type == +ColumnType::CHAR || column.ArraySize != 1)
+			{
+				throw runtime_error(name + " needs a numeric column");
+			}
+			m_Schema->AddColumn(name, function == +AggregateFunction::SUM && IsInteger(column.Type) ? ColumnType::INT64 : ColumnType::DOUBLE);
+			break;
+		default:
+			m_Schema->AddColumn(name, column.Type, column.ArraySize);
+			break;
+		}
+		m_Accumulators.push_back({ function, &column, offset });
+	}
+}
+
+Schema* Aggregation::GetSchema() const
+{
+	return m_Schema.get();
+}
+
+ResultSet Aggregation::Run(RecordCursor& cursor) const
+{
+	auto rowSize = (size_t)m_Schema->GetSize();
+	// The rows of the groups hold the running state of their aggregates
+	vector<unsigned char> rows;
+	vector<unsigned long long> counts;
+	unordered_map<string, size_t> groups;
+	string key;
+
+	// The GROUP BY columns are copied once, MIN and MAX start from the first value of the group
+	auto startGroup = [&](size_t group, span<const unsigned char> record) {
+		auto row = rows.data() + group * rowSize;
+		unsigned int offset = sizeof(unsigned long long);
+		for (auto column : m_GroupByColumns)
+		{
+			memcpy(row + offset, record.data() + column->Offset, column->Length);
+			offset += column->Length;
+		}
+		for (auto& accumulator : m_Accumulators)
+		{
+			if (accumulator.Function == +AggregateFunction::MIN || accumulator.Function == +AggregateFunction::MAX)
+			{
+				memcpy(row + accumulator.Offset, record.data() + accumulator.Source->Offset, accumulator.Source->Length);
+			}
+		}
+	};
+
+	// Without GROUP BY there is a single group, even over no records
+	if (m_GroupByColumns.empty())
+	{
+		rows.resize(rowSize);
+		counts.push_back(0);
+	}
+
+	while (cursor.MoveNext())
+	{
+		auto record = cursor.GetCurrent().GetData();
+		size_t group = 0;
+		if (!m_GroupByColumns.empty())
+		{
+			key.clear();
+			for (auto column : m_GroupByColumns)
+			{
+				key.append((const char*)record.data() + column->Offset, column->Length);
+			}
+			auto entry = groups.find(key);
+			if (entry != groups.end())
+			{
+				group = entry->second;
+			}
+			else
+			{
+				group = counts.size();
+				rows.resize(rows.size() + rowSize);
+				counts.push_back(0);
+				groups.emplace(key, group);
+				startGroup(group, record);
+			}
+		}
+		else if (counts[0] == 0)
+		{
+			startGroup(0, record);
+		}
+
+		auto row = rows.data() + group * rowSize;
+		counts[group]++;
+		for (auto& accumulator : m_Accumulators)
+		{
+			if (accumulator.Source != nullptr)
+			{
+				Update(accumulator, record.data() + accumulator.Source->Offset, row + accumulator.Offset);
+			}
+		}
+	}
+
+	auto result = ResultSet(m_Schema.get());
+	for (size_t group = 0; group < counts.size(); group++)
+	{
+		auto row = result.Append();
+		memcpy(row.data(), rows.data() + group * rowSize, rowSize);
+		unsigned long long id = group;
+		memcpy(row.data(), &id, sizeof(id));
+		for (auto& accumulator : m_Accumulators)
+		{
+			auto state = row.data() + accumulator.Offset;
+			if (accumulator.Function == +AggregateFunction::COUNT)
+			{
+				memcpy(state, &counts[group], sizeof(unsigned long long));
+			}
+			else if (accumulator.Function == +AggregateFunction::AVG && counts[group] > 0)
+			{
+				auto average = Load<double>(state) / counts[group];
+				memcpy(state, &average, sizeof(double));
+			}
+		}
+	}
+	return result;
+}
+
+void Aggregation::Update(const Accumulator& accumulator, const unsigned char* value, unsigned char* state)
+{
+	auto& column = *accumulator.Source;
+	switch (accumulator.Function)
+	{
+	case AggregateFunction::SUM:
+	case AggregateFunction::AVG:
+	{
+		// Integers are summed as INT64 (SUM) and every other case as DOUBLE
+		auto asInteger = accumulator.Function == +AggregateFunction::SUM && IsInteger(column.Type);
+		switch (column.Type)
+		{
+		case ColumnType::INT32:
+			asInteger ? AddAs<int, long long>(value, state) : AddAs<int, double>(value, state);
+			return;
+		case ColumnType::INT64:
+			asInteger ? Add<long long>(value, state) : AddAs<long long, double>(value, state);
+			return;
+		case ColumnType::FLOAT:
+			AddAs<float, double>(value, state);
+			return;
+		case ColumnType::DOUBLE:
+			Add<double>(value, state);
+			return;
+		default:
+			return;
+		}
+	}
+	case AggregateFunction::MIN:
+	case AggregateFunction::MAX:
+	{
+		auto smaller = accumulator.Function == +AggregateFunction::MIN;
+		if (column.ArraySize == 1)
+		{
+			switch (column.Type)
+			{
+			case ColumnType::INT32:
+				Keep<int>(smaller, value, state);
+				return;
+			case ColumnType::INT64:
+				Keep<long long>(smaller, value, state);
+				return;
+			case ColumnType::FLOAT:
+				Keep<float>(smaller, value, state);
+				return;
+			case ColumnType::DOUBLE:
+				Keep<double>(smaller, value, state);
+				return;
+			default:
+				break;
+			}
+		}
+		// Strings and arrays
+		auto candidate = span<unsigned char>((unsigned char*)value, column.Length);
+		auto current = span<unsigned char>(state, column.Length);
+		auto comparison = Column::Compare(column, candidate, current);
+		if (smaller ? comparison < 0 : comparison > 0)
+		{
+			memcpy(state, value, column.Length);
+		}
+		return;
+	}
+	default:
+		return;
+	}
+}
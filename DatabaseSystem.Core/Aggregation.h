@@ -0,0 +1,53 @@
+#pragma once
+#include "Schema.h"
+#include "AggregateFunction.h"
+#include "RecordCursor.h"
+#include "ResultSet.h"
+
+/*
+	GROUP BY on any columns (none for a single group over every record) and aggregate functions,
+	computed while the records are scanned. The values are read straight from the blocks, the groups are
+	kept in a hash table keyed by the bytes of their columns, so the memory grows with the number of groups
+	and never with the number of records.
+	Each result row holds the number of the group in the Id column, the GROUP BY columns and one column per
+	aggregate: COUNT is an INT64, SUM an INT64 (integer columns) or a DOUBLE, MIN and MAX have the type of
+	their column and AVG is a DOUBLE. SUM and AVG need a numeric column with a single value.
+	Result sets built with an aggregation use its schema, the aggregation must outlive them.
+*/
+class Aggregation
+{
+public:
+	struct Aggregate
+	{
+		AggregateFunction Function;
+		// Ignored by COUNT
+		unsigned int ColumnId;
+	};
+
+	Aggregation(const Schema* schema, const vector<unsigned int>& groupByColumnIds, const vector<Aggregate>& aggregates);
+
+	Aggregation(const Aggregation&) = delete;
+	Aggregation& operator=(const Aggregation&) = delete;
+	Aggregation(Aggregation&&) noexcept = default;
+	Aggregation& operator=(Aggregation&&) noexcept = default;
+
+	Schema* GetSchema() const;
+	// One row per group, in the order the groups were first seen
+	ResultSet Run(RecordCursor& cursor) const;
+
+private:
+	struct Accumulator
+	{
+		AggregateFunction Function;
+		const Column* Source;
+		// Position of the value in the result row
+		unsigned int Offset;
+	};
+
+	const Schema* m_Source;
+	unique_ptr<Schema> m_Schema;
+	vector<const Column*> m_GroupByColumns;
+	vector<Accumulator> m_Accumulators;
+
+	static void Update(const Accumulator& accumulator, const unsigned char* value, unsigned char* state);
+};
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstring>
+
+/*
+	Fixed size heap buffer aligned to the disk sector/page size,
+	so blocks can be handed straight to positional (and eventually unbuffered) I/O.
+*/
+class AlignedBuffer
+{
+public:
+	static const size_t DefaultAlignment = 4096;
+
+	AlignedBuffer(size_t size, size_t alignment = DefaultAlignment) :
+		m_Size(size),
+		m_Alignment(alignment),
+		m_Data((unsigned char*)::operator new[](size, align_val_t(alignment)))
+	{
+		memset(m_Data, 0, m_Size);
+	}
+
+	AlignedBuffer(const AlignedBuffer&) = delete;
+	AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+	~AlignedBuffer()
+	{
+		::operator delete[](m_Data, align_val_t(m_Alignment));
+	}
+
+	unsigned char* data() const
+	{
+		return m_Data;
+	}
+
+	size_t size() const
+	{
+		return m_Size;
+	}
+
+	span<unsigned char> GetSpan() const
+	{
+		return span<unsigned char>(m_Data, m_Size);
+	}
+
+private:
+	size_t m_Size;
+	size_t m_Alignment;
+	unsigned char* m_Data;
+};
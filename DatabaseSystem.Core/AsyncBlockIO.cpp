@@ -0,0 +1,165 @@
+#include "pch.h"
+#include "AsyncBlockIO.h"
+
+AsyncBlockIO::AsyncBlockIO(size_t threadsCount) :
+	m_NextRequestId(0),
+	m_Stopping(false),
+	m_SubmittedCount(0),
+	m_CompletedCount(0),
+	m_QueueDepth(0),
+	m_MaxQueueDepth(0),
+	m_TotalLatency(0),
+	m_MaxLatency(0)
+{
+	if (threadsCount == 0)
+	{
+		throw runtime_error("Async block I/O needs at least one thread");
+	}
+
+	for (size_t i = 0; i < threadsCount; i++)
+	{
+		m_Threads.emplace_back(&AsyncBlockIO::Work, this);
+	}
+}
+
+AsyncBlockIO::~AsyncBlockIO()
+{
+	{
+		lock_guard<mutex> lock(m_Mutex);
+		m_Stopping = true;
+	}
+	m_RequestQueued.notify_all();
+	for (auto& worker : m_Threads)
+	{
+		worker.join();
+	}
+}
+
+AsyncBlockIO& AsyncBlockIO::GetDefault()
+{
+	static AsyncBlockIO engine;
+	return engine;
+}
+
+AsyncBlockIO::RequestId AsyncBlockIO::SubmitRead(BlockDevice* device, unsigned long long offset, span<unsigned char> data)
+{
+	return Submit(Request{ 0, false, device, offset, data });
+}
+
+AsyncBlockIO::RequestId AsyncBlockIO::SubmitWrite(BlockDevice* device, unsigned long long offset, span<const unsigned char> data)
+{
+	// The span is only read from, it is stored mutable to share the request layout with reads
+	return Submit(Request{ 0, true, device, offset, span<unsigned char>((unsigned char*)data.data(), data.size()) });
+}
+
+size_t AsyncBlockIO::Wait(RequestId requestId)
+{
+	unique_lock<mutex> lock(m_Mutex);
+	m_RequestCompleted.wait(lock, [this, requestId]() {
+		return m_Completions.find(requestId) != m_Completions.end();
+	});
+
+	auto entry = m_Completions.find(requestId);
+	auto completion = entry->second;
+	m_Completions.erase(entry);
+	lock.unlock();
+
+	if (completion.Error != nullptr)
+	{
+		rethrow_exception(completion.Error);
+	}
+	return completion.TransferredBytes;
+}
+
+AsyncBlockIO::Statistics AsyncBlockIO::GetStatistics()
+{
+	lock_guard<mutex> lock(m_Mutex);
+	Statistics statistics;
+	statistics.SubmittedCount = m_SubmittedCount;
+	statistics.CompletedCount = m_CompletedCount;
+	statistics.QueueDepth = m_QueueDepth;
+	statistics.MaxQueueDepth = m_MaxQueueDepth;
+	statistics.AverageLatency = m_CompletedCount == 0 ? 0 : m_TotalLatency / m_CompletedCount;
+	statistics.MaxLatency = m_MaxLatency;
+	return statistics;
+}
+
+void AsyncBlockIO::ResetStatistics()
+{
+	lock_guard<mutex> lock(m_Mutex);
+	m_SubmittedCount = 0;
+	m_CompletedCount = 0;
+	m_MaxQueueDepth = m_QueueDepth;
+	m_TotalLatency = 0;
+	m_MaxLatency = 0;
+}
+
+size_t AsyncBlockIO::GetThreadsCount() const
+{
+	return m_Threads.size();
+}
+
+AsyncBlockIO::RequestId AsyncBlockIO::Submit(Request request)
+{
+	{
+		lock_guard<mutex> lock(m_Mutex);
+		request.Id = m_NextRequestId++;
+		request.SubmittedAt = chrono::steady_clock::now();
+		m_Queue.push_back(request);
+
+		m_SubmittedCount++;
+		m_QueueDepth++;
+		m_MaxQueueDepth = max(m_MaxQueueDepth, m_QueueDepth);
+	}
+	m_RequestQueued.notify_one();
+	return request.Id;
+}
+
+void AsyncBlockIO::Work()
+{
+	while (true)
+	{
+		Request request;
+		{
+			unique_lock<mutex> lock(m_Mutex);
+			m_RequestQueued.wait(lock, [this]() { return m_Stopping || !m_Queue.empty(); });
+			if (m_Queue.empty())
+			{
+				// Stopping and nothing left to serve
+				return;
+			}
+			request = m_Queue.front();
+			m_Queue.pop_front();
+		}
+
+		// Positional I/O does not share a file position, so the workers can use the same device
+		Completion completion = { 0, nullptr };
+		try
+		{
+			if (request.IsWrite)
+			{
+				request.Device->WriteAt(request.Offset, request.Data);
+				completion.TransferredBytes = request.Data.size();
+			}
+			else
+			{
+				completion.TransferredBytes = request.Device->ReadAt(request.Offset, request.Data);
+			}
+		}
+		catch (...)
+		{
+			completion.Error = current_exception();
+		}
+
+		auto latency = chrono::duration<double, micro>(chrono::steady_clock::now() - request.SubmittedAt).count();
+		{
+			lock_guard<mutex> lock(m_Mutex);
+			m_Completions[request.Id] = completion;
+			m_CompletedCount++;
+			m_QueueDepth--;
+			m_TotalLatency += latency;
+			m_MaxLatency = max(m_MaxLatency, latency);
+		}
+		m_RequestCompleted.notify_all();
+	}
+}
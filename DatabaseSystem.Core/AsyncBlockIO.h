@@ -0,0 +1,91 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <unordered_map>
+#include <chrono>
+#include "BlockDevice.h"
+
+/*
+	Keeps many block reads and writes in flight.
+	Requests are queued and served by a pool of worker threads doing positional I/O on a
+	BlockDevice, so a caller can submit a batch of independent blocks and wait for all of them
+	instead of paying the latency of each one in turn.
+	The buffers given to a request must stay alive and untouched until it is waited for.
+*/
+class AsyncBlockIO
+{
+public:
+	typedef unsigned long long RequestId;
+
+	struct Statistics
+	{
+		unsigned long long SubmittedCount;
+		unsigned long long CompletedCount;
+		// Requests queued or being served right now, and the highest value seen
+		size_t QueueDepth;
+		size_t MaxQueueDepth;
+		// From submission to completion, in microseconds
+		double AverageLatency;
+		double MaxLatency;
+	};
+
+	static constexpr size_t DefaultThreadsCount = 8;
+
+	AsyncBlockIO(size_t threadsCount = DefaultThreadsCount);
+	~AsyncBlockIO();
+
+	AsyncBlockIO(const AsyncBlockIO&) = delete;
+	AsyncBlockIO& operator=(const AsyncBlockIO&) = delete;
+
+	// Shared engine used by the files that were not given one
+	static AsyncBlockIO& GetDefault();
+
+	RequestId SubmitRead(BlockDevice* device, unsigned long long offset, span<unsigned char> data);
+	RequestId SubmitWrite(BlockDevice* device, unsigned long long offset, span<const unsigned char> data);
+
+	// Blocks until the request is done and returns the bytes transferred, rethrowing its error if it failed
+	size_t Wait(RequestId requestId);
+
+	Statistics GetStatistics();
+	void ResetStatistics();
+	size_t GetThreadsCount() const;
+
+private:
+	struct Request
+	{
+		RequestId Id;
+		bool IsWrite;
+		BlockDevice* Device;
+		unsigned long long Offset;
+		span<unsigned char> Data;
+		// Set by Submit when the request is queued
+		chrono::steady_clock::time_point SubmittedAt = {};
+	};
+
+	struct Completion
+	{
+		size_t TransferredBytes;
+		exception_ptr Error;
+	};
+
+	vector<thread> m_Threads;
+	mutex m_Mutex;
+	condition_variable m_RequestQueued;
+	condition_variable m_RequestCompleted;
+	deque<Request> m_Queue;
+	unordered_map<RequestId, Completion> m_Completions;
+	RequestId m_NextRequestId;
+	bool m_Stopping;
+
+	unsigned long long m_SubmittedCount;
+	unsigned long long m_CompletedCount;
+	size_t m_QueueDepth;
+	size_t m_MaxQueueDepth;
+	double m_TotalLatency;
+	double m_MaxLatency;
+
+	RequestId Submit(Request request);
+	void Work();
+};
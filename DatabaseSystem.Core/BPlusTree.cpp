@@ -0,0 +1,845 @@
+#include "pch.h"
+#include "BPlusTree.h"
+#include "Predicate.h"
+
+BPlusTree::BPlusTree(size_t blockSize, BufferPool* bufferPool) :
+	m_Leaves(make_unique<FileWrapper<BPlusTreeFileHead>>(blockSize, LeafHeaderSize, bufferPool)),
+	m_Nodes(make_unique<FileWrapper<BPlusTreeFileHead>>(blockSize, 0, bufferPool)),
+	m_KeyColumn(nullptr),
+	m_ReadBlocksCount(0),
+	m_WrittenBlocksCount(0)
+{
+}
+
+void BPlusTree::Create(string path, Schema* entrySchema, unsigned int keyColumnId)
+{
+	m_EntrySchema = make_unique<Schema>(*entrySchema);
+	m_Head = make_unique<BPlusTreeFileHead>(m_EntrySchema.get());
+	m_Head->KeyColumnId = keyColumnId;
+	m_KeyColumn = &m_EntrySchema->GetColumn(keyColumnId);
+
+	// Node entry: the child block id (as the Id column) and the separator
+	m_NodeSchema = make_unique<Schema>();
+	m_NodeSchema->AddColumn("Key", m_KeyColumn->Type, m_KeyColumn->ArraySize);
+	m_NodeSchema->AddColumn("KeyId", ColumnType::INT64);
+	m_NodesHead = make_unique<BPlusTreeFileHead>(m_NodeSchema.get());
+
+	m_Leaves->NewFile(path, m_Head.get());
+	m_Nodes->NewFile(path + ".nodes", m_NodesHead.get());
+	CreateBlocks();
+}
+
+void BPlusTree::Open(string path)
+{
+	m_Head = make_unique<BPlusTreeFileHead>(nullptr);
+	m_Leaves->Open(path, m_Head.get());
+	m_EntrySchema.reset(m_Head->GetSchema());
+	m_KeyColumn = &m_EntrySchema->GetColumn(m_Head->KeyColumnId);
+
+	m_NodesHead = make_unique<BPlusTreeFileHead>(nullptr);
+	m_Nodes->Open(path + ".nodes", m_NodesHead.get());
+	m_NodeSchema.reset(m_NodesHead->GetSchema());
+	CreateBlocks();
+}
+
+void BPlusTree::CreateBlocks()
+{
+	m_Leaf.reset(m_Leaves->CreateBlock());
+	m_SiblingLeaf.reset(m_Leaves->CreateBlock());
+	m_Node.reset(m_Nodes->CreateBlock());
+	m_SiblingNode.reset(m_Nodes->CreateBlock());
+	m_ParentNode.reset(m_Nodes->CreateBlock());
+
+	// Pages below half full must still hold a record, and nodes two children, to be merged or completed
+	if (m_Leaf->GetCapacity() < 4 || m_Node->GetCapacity() < 4)
+	{
+		throw runtime_error("Block size too small for the entries of the tree");
+	}
+}
+
+void BPlusTree::Close()
+{
+	m_Leaves->Close();
+	m_Nodes->Close();
+}
+
+void BPlusTree::Checkpoint()
+{
+	m_Leaves->Checkpoint();
+	m_Nodes->Checkpoint();
+}
+
+void BPlusTree::SetFileAccessMode(FileAccessMode mode)
+{
+	m_Leaves->SetAccessMode(mode);
+	m_Nodes->SetAccessMode(mode);
+}
+
+void BPlusTree::SetWriteBack(bool enabled)
+{
+	m_Leaves->SetWriteBack(enabled);
+	m_Nodes->SetWriteBack(enabled);
+}
+
+Schema* BPlusTree::GetSchema()
+{
+	return m_EntrySchema.get();
+}
+
+unsigned int BPlusTree::GetKeyColumnId()
+{
+	return m_Head->KeyColumnId;
+}
+
+unsigned long long BPlusTree::GetEntriesCount()
+{
+	return m_Head->EntriesCount;
+}
+
+FileWrapper<BPlusTreeFileHead>* BPlusTree::GetLeafFile()
+{
+	return m_Leaves.get();
+}
+
+unsigned long long BPlusTree::GetReadBlocksCount() const
+{
+	return m_ReadBlocksCount;
+}
+
+unsigned long long BPlusTree::GetWrittenBlocksCount() const
+{
+	return m_WrittenBlocksCount;
+}
+
+void BPlusTree::ClearAccessCount()
+{
+	m_ReadBlocksCount = 0;
+	m_WrittenBlocksCount = 0;
+}
+
+bool BPlusTree::Insert(span<const unsigned char> entry, EntryPosition* position)
+{
+	auto head = GetHead();
+	auto key = GetEntryKey(entry);
+	auto id = GetId(entry);
+
+	if (head->RootBlockId == InvalidBlockId)
+	{
+		auto leafId = AllocateLeaf();
+		m_Leaf->Clear();
+		SetLeafLinks(m_Leaf.get(), InvalidBlockId, InvalidBlockId);
+		m_Leaf->Append(entry);
+		WriteLeaf(m_Leaf.get(), leafId);
+
+		head->RootBlockId = leafId;
+		head->FirstLeafBlockId = leafId;
+		head->Height = 0;
+		head->EntriesCount = 1;
+		if (position != nullptr)
+		{
+			*position = { leafId, 0, false };
+		}
+		return true;
+	}
+
+	vector<PathStep> path;
+	auto leafId = Descend(key, id, path);
+	ReadLeaf(m_Leaf.get(), leafId);
+	auto index = LowerBound(m_Leaf.get(), key, id);
+	if (index < m_Leaf->GetRecordsCount())
+	{
+		auto found = GetRecord(m_Leaf.get(), index);
+		if (Compare(GetEntryKey(found), GetId(found), key, id) == 0)
+		{
+			return false;
+		}
+	}
+	head->EntriesCount++;
+
+	if (m_Leaf->GetRecordsCount() < m_Leaf->GetCapacity())
+	{
+		if (position != nullptr)
+		{
+			*position = { leafId, index, index < m_Leaf->GetRecordsCount() };
+		}
+		m_Leaf->Insert(index, entry);
+		WriteLeaf(m_Leaf.get(), leafId);
+		return true;
+	}
+
+	auto capacity = m_Leaf->GetCapacity();
+	auto nextId = GetNextLeaf(m_Leaf.get());
+	auto siblingId = AllocateLeaf();
+	m_SiblingLeaf->Clear();
+	// Appending past the last entry (increasing keys, as the Ids) leaves the full leaf as it is
+	auto leftCount = index == capacity && nextId == InvalidBlockId ? capacity : (capacity + 1) / 2;
+	Split(m_Leaf.get(), m_SiblingLeaf.get(), index, entry, leftCount);
+	if (position != nullptr)
+	{
+		*position = index < leftCount ? EntryPosition{ leafId, index, true } : EntryPosition{ siblingId, index - leftCount, leftCount < capacity };
+	}
+
+	SetLeafLinks(m_SiblingLeaf.get(), nextId, leafId);
+	SetLeafLinks(m_Leaf.get(), siblingId, GetPrevLeaf(m_Leaf.get()));
+	if (nextId != InvalidBlockId)
+	{
+		SetPrevLeaf(nextId, siblingId);
+	}
+	WriteLeaf(m_Leaf.get(), leafId);
+	WriteLeaf(m_SiblingLeaf.get(), siblingId);
+
+	auto separator = GetRecord(m_SiblingLeaf.get(), 0);
+	auto separatorKey = GetEntryKey(separator);
+	InsertChild(path, siblingId, vector<unsigned char>(separatorKey.begin(), separatorKey.end()), GetId(separator));
+	return true;
+}
+
+bool BPlusTree::Remove(span<const unsigned char> key, unsigned long long id, bool* moved)
+{
+	auto head = GetHead();
+	if (moved != nullptr)
+	{
+		*moved = false;
+	}
+	if (head->RootBlockId == InvalidBlockId)
+	{
+		return false;
+	}
+
+	vector<PathStep> path;
+	auto leafId = Descend(key, id, path);
+	ReadLeaf(m_Leaf.get(), leafId);
+	auto index = LowerBound(m_Leaf.get(), key, id);
+	if (index >= m_Leaf->GetRecordsCount())
+	{
+		return false;
+	}
+	auto found = GetRecord(m_Leaf.get(), index);
+	if (Compare(GetEntryKey(found), GetId(found), key, id) != 0)
+	{
+		return false;
+	}
+
+	// The separators above stay valid lower bounds, they are not changed
+	m_Leaf->Remove(index);
+	head->EntriesCount--;
+	auto rebalance = head->Height > 0 && m_Leaf->GetRecordsCount() < m_Leaf->GetCapacity() / 2;
+	if (moved != nullptr)
+	{
+		*moved = index < m_Leaf->GetRecordsCount() || rebalance;
+	}
+
+	if (head->Height == 0)
+	{
+		if (m_Leaf->GetRecordsCount() == 0)
+		{
+			FreeLeaf(leafId);
+			head->RootBlockId = InvalidBlockId;
+			head->FirstLeafBlockId = InvalidBlockId;
+			return true;
+		}
+		WriteLeaf(m_Leaf.get(), leafId);
+		return true;
+	}
+
+	if (rebalance)
+	{
+		RebalanceLeaf(path, leafId);
+		return true;
+	}
+	WriteLeaf(m_Leaf.get(), leafId);
+	return true;
+}
+
+bool BPlusTree::Find(span<const unsigned char> key, unsigned long long id, span<unsigned char> entry)
+{
+	if (GetHead()->RootBlockId == InvalidBlockId)
+	{
+		return false;
+	}
+
+	vector<PathStep> path;
+	auto leafId = Descend(key, id, path);
+	ReadLeaf(m_Leaf.get(), leafId);
+	auto index = LowerBound(m_Leaf.get(), key, id);
+	if (index >= m_Leaf->GetRecordsCount())
+	{
+		return false;
+	}
+	auto found = GetRecord(m_Leaf.get(), index);
+	if (Compare(GetEntryKey(found), GetId(found), key, id) != 0)
+	{
+		return false;
+	}
+	memcpy(entry.data(), found.data(), min(entry.size(), found.size()));
+	return true;
+}
+
+void BPlusTree::Load(span<const unsigned char> entries)
+{
+	auto head = GetHead();
+	m_Leaves->SeekHead();
+	m_Nodes->SeekHead();
+	head->FreeLeaves.clear();
+	head->FreeNodes.clear();
+	head->Height = 0;
+	head->RootBlockId = InvalidBlockId;
+	head->FirstLeafBlockId = InvalidBlockId;
+
+	auto entrySize = (size_t)m_EntrySchema->GetSize();
+	auto entriesCount = entries.size() / entrySize;
+	head->EntriesCount = entriesCount;
+
+	// Full leaves, in order, each one pointing to its neighbours
+	auto capacity = m_Leaf->GetCapacity();
+	auto leavesCount = (entriesCount + capacity - 1) / capacity;
+	vector<vector<unsigned char>> children;
+	for (unsigned long long leafId = 0; leafId < leavesCount; leafId++)
+	{
+		m_Leaf->Clear();
+		SetLeafLinks(m_Leaf.get(), leafId + 1 < leavesCount ? leafId + 1 : InvalidBlockId, leafId > 0 ? leafId - 1 : InvalidBlockId);
+		auto first = leafId * capacity;
+		auto last = min(first + capacity, (unsigned long long)entriesCount);
+		for (auto i = first; i < last; i++)
+		{
+			m_Leaf->Append(entries.subspan(i * entrySize, entrySize));
+		}
+		m_Leaves->AddBlock(m_Leaf.get());
+		m_WrittenBlocksCount++;
+
+		auto separator = entries.subspan(first * entrySize, entrySize);
+		children.push_back(MakeNodeEntry(leafId, GetEntryKey(separator), GetId(separator)));
+	}
+
+	// Levels of nodes up to a single root. The entries are spread evenly so no node starts below half full
+	auto nodeCapacity = m_Node->GetCapacity();
+	while (children.size() > 1)
+	{
+		auto nodesCount = (children.size() + nodeCapacity - 1) / nodeCapacity;
+		vector<vector<unsigned char>> parents;
+		for (size_t node = 0; node < nodesCount; node++)
+		{
+			auto first = node * children.size() / nodesCount;
+			auto last = (node + 1) * children.size() / nodesCount;
+			m_Node->Clear();
+			for (auto i = first; i < last; i++)
+			{
+				m_Node->Append(children[i]);
+			}
+			auto nodeId = (unsigned long long)m_NodesHead->GetBlocksCount();
+			m_Nodes->AddBlock(m_Node.get());
+			m_WrittenBlocksCount++;
+
+			auto separator = span<const unsigned char>(children[first]);
+			parents.push_back(MakeNodeEntry(nodeId, GetSeparatorKey(separator), GetSeparatorId(separator)));
+		}
+		children = move(parents);
+		head->Height++;
+	}
+
+	if (!children.empty())
+	{
+		head->RootBlockId = GetChild(children[0]);
+		head->FirstLeafBlockId = 0;
+	}
+	m_Leaves->Trim();
+	m_Nodes->Trim();
+}
+
+unique_ptr<RecordCursor> BPlusTree::OpenCursor(vector<unsigned char> min, vector<unsigned char> max, RecordCursor::FilterFunction filter)
+{
+	auto head = GetHead();
+	auto leafId = head->FirstLeafBlockId;
+	if (!min.empty() && head->RootBlockId != InvalidBlockId)
+	{
+		vector<PathStep> path;
+		leafId = Descend(min, 0, path);
+	}
+
+	auto nextBlock = [this, leafId, max](Block* buffer) mutable -> Block* {
+		if (leafId == InvalidBlockId)
+		{
+			return nullptr;
+		}
+		m_Leaves->GetBlock(leafId, buffer);
+		leafId = GetNextLeaf(buffer);
+		// Leaves are in order, past max there is nothing left
+		if (!max.empty() && buffer->GetRecordsCount() > 0)
+		{
+			auto first = GetRecord(buffer, 0);
+			if (Column::Compare(*m_KeyColumn, span<unsigned char>((unsigned char*)GetEntryKey(first).data(), m_KeyColumn->Length), max) > 0)
+			{
+				leafId = InvalidBlockId;
+				return nullptr;
+			}
+		}
+		return buffer;
+	};
+
+	// The first and last leaves also hold entries out of the range
+	auto keyColumnId = head->KeyColumnId;
+	auto bounds = !min.empty() && !max.empty() ? Predicate::Between(keyColumnId, min, max)
+		: !min.empty() ? Predicate::GreaterOrEqual(keyColumnId, min)
+		: Predicate::LessOrEqual(keyColumnId, max);
+	RecordCursor::FilterFunction boundsFilter = nullptr;
+	if (!min.empty() || !max.empty())
+	{
+		boundsFilter = bounds.ToFilter(m_EntrySchema.get());
+	}
+
+	RecordCursor::FilterFunction cursorFilter = filter;
+	if (boundsFilter != nullptr)
+	{
+		cursorFilter = boundsFilter;
+		if (filter != nullptr)
+		{
+			cursorFilter = [boundsFilter, filter](Block* block, SelectionBitmap& selection) {
+				boundsFilter(block, selection);
+				SelectionBitmap matches;
+				filter(block, matches);
+				selection.And(matches);
+			};
+		}
+	}
+	return make_unique<RecordCursor>(m_EntrySchema.get(), unique_ptr<Block>(m_Leaves->CreateBlock()), nextBlock, cursorFilter);
+}
+
+BPlusTreeFileHead* BPlusTree::GetHead()
+{
+	return m_Head.get();
+}
+
+int BPlusTree::Compare(span<const unsigned char> keyA, unsigned long long idA, span<const unsigned char> keyB, unsigned long long idB)
+{
+	auto compare = Column::Compare(*m_KeyColumn, span<unsigned char>((unsigned char*)keyA.data(), keyA.size()), span<unsigned char>((unsigned char*)keyB.data(), keyB.size()));
+	if (compare != 0)
+	{
+		return compare;
+	}
+	return idA < idB ? -1 : idA > idB ? 1 : 0;
+}
+
+span<const unsigned char> BPlusTree::GetEntryKey(span<const unsigned char> entry)
+{
+	return entry.subspan(m_KeyColumn->Offset, m_KeyColumn->Length);
+}
+
+span<const unsigned char> BPlusTree::GetSeparatorKey(span<const unsigned char> nodeEntry)
+{
+	return nodeEntry.subspan(sizeof(unsigned long long), m_KeyColumn->Length);
+}
+
+unsigned long long BPlusTree::GetSeparatorId(span<const unsigned char> nodeEntry)
+{
+	unsigned long long id;
+	memcpy(&id, nodeEntry.data() + sizeof(unsigned long long) + m_KeyColumn->Length, sizeof(id));
+	return id;
+}
+
+unsigned long long BPlusTree::GetChild(Block* node, unsigned int index)
+{
+	return GetId(GetRecord(node, index));
+}
+
+unsigned long long BPlusTree::GetChild(span<const unsigned char> nodeEntry)
+{
+	return GetId(nodeEntry);
+}
+
+void BPlusTree::SetSeparator(Block* node, unsigned int index, span<const unsigned char> key, unsigned long long id)
+{
+	auto nodeEntry = GetRecord(node, index);
+	memcpy(nodeEntry.data() + sizeof(unsigned long long), key.data(), m_KeyColumn->Length);
+	memcpy(nodeEntry.data() + sizeof(unsigned long long) + m_KeyColumn->Length, &id, sizeof(id));
+}
+
+vector<unsigned char> BPlusTree::MakeNodeEntry(unsigned long long childId, span<const unsigned char> key, unsigned long long id)
+{
+	auto nodeEntry = vector<unsigned char>(m_NodeSchema->GetSize());
+	memcpy(nodeEntry.data(), &childId, sizeof(childId));
+	memcpy(nodeEntry.data() + sizeof(unsigned long long), key.data(), m_KeyColumn->Length);
+	memcpy(nodeEntry.data() + sizeof(unsigned long long) + m_KeyColumn->Length, &id, sizeof(id));
+	return nodeEntry;
+}
+
+span<unsigned char> BPlusTree::GetRecord(Block* block, unsigned int index)
+{
+	span<unsigned char> record;
+	block->GetRecordSpan(index, &record);
+	return record;
+}
+
+unsigned long long BPlusTree::GetId(span<const unsigned char> record)
+{
+	unsigned long long id;
+	memcpy(&id, record.data(), sizeof(id));
+	return id;
+}
+
+void BPlusTree::MoveRecords(Block* source, Block* destination)
+{
+	auto recordsCount = source->GetRecordsCount();
+	for (unsigned int i = 0; i < recordsCount; i++)
+	{
+		destination->Append(GetRecord(source, i));
+	}
+	source->Truncate(0);
+}
+
+unsigned long long BPlusTree::GetNextLeaf(Block* leaf)
+{
+	unsigned long long nextId;
+	memcpy(&nextId, leaf->GetHeader().data(), sizeof(nextId));
+	return nextId;
+}
+
+unsigned long long BPlusTree::GetPrevLeaf(Block* leaf)
+{
+	unsigned long long prevId;
+	memcpy(&prevId, leaf->GetHeader().data() + sizeof(unsigned long long), sizeof(prevId));
+	return prevId;
+}
+
+void BPlusTree::SetLeafLinks(Block* leaf, unsigned long long nextId, unsigned long long prevId)
+{
+	auto header = leaf->GetHeader();
+	memcpy(header.data(), &nextId, sizeof(nextId));
+	memcpy(header.data() + sizeof(unsigned long long), &prevId, sizeof(prevId));
+}
+
+void BPlusTree::SetPrevLeaf(unsigned long long leafId, unsigned long long prevId)
+{
+	// Only the link changes, it is written in place in the cached block. The header is laid out as in SetLeafLinks
+	auto data = m_Leaves->PinBlock(leafId);
+	memcpy(data.data() + Block::GetHeaderOffset() + sizeof(unsigned long long), &prevId, sizeof(prevId));
+	m_Leaves->UnpinBlock(leafId, true);
+	m_ReadBlocksCount++;
+	m_WrittenBlocksCount++;
+}
+
+void BPlusTree::ReadLeaf(Block* leaf, unsigned long long leafId)
+{
+	m_Leaves->GetBlock(leafId, leaf);
+	m_ReadBlocksCount++;
+}
+
+void BPlusTree::WriteLeaf(Block* leaf, unsigned long long leafId)
+{
+	m_Leaves->WriteBlock(leaf, leafId);
+	m_WrittenBlocksCount++;
+}
+
+void BPlusTree::ReadNode(Block* node, unsigned long long nodeId)
+{
+	m_Nodes->GetBlock(nodeId, node);
+	m_ReadBlocksCount++;
+}
+
+void BPlusTree::WriteNode(Block* node, unsigned long long nodeId)
+{
+	m_Nodes->WriteBlock(node, nodeId);
+	m_WrittenBlocksCount++;
+}
+
+unsigned long long BPlusTree::AllocateLeaf()
+{
+	auto& freeLeaves = GetHead()->FreeLeaves;
+	if (!freeLeaves.empty())
+	{
+		auto leafId = freeLeaves.back();
+		freeLeaves.pop_back();
+		return leafId;
+	}
+	auto leafId = (unsigned long long)m_Head->GetBlocksCount();
+	m_Head->SetBlocksCount(leafId + 1);
+	return leafId;
+}
+
+unsigned long long BPlusTree::AllocateNode()
+{
+	auto& freeNodes = GetHead()->FreeNodes;
+	if (!freeNodes.empty())
+	{
+		auto nodeId = freeNodes.back();
+		freeNodes.pop_back();
+		return nodeId;
+	}
+	auto nodeId = (unsigned long long)m_NodesHead->GetBlocksCount();
+	m_NodesHead->SetBlocksCount(nodeId + 1);
+	return nodeId;
+}
+
+void BPlusTree::FreeLeaf(unsigned long long leafId)
+{
+	ClearPage(m_Leaves.get(), leafId);
+	GetHead()->FreeLeaves.push_back(leafId);
+}
+
+void BPlusTree::FreeNode(unsigned long long nodeId)
+{
+	ClearPage(m_Nodes.get(), nodeId);
+	GetHead()->FreeNodes.push_back(nodeId);
+}
+
+void BPlusTree::ClearPage(FileWrapper<BPlusTreeFileHead>* file, unsigned long long blockId)
+{
+	auto data = file->PinBlock(blockId);
+	memset(data.data(), 0, data.size());
+	file->UnpinBlock(blockId, true);
+	m_WrittenBlocksCount++;
+}
+
+unsigned long long BPlusTree::Descend(span<const unsigned char> key, unsigned long long id, vector<PathStep>& path)
+{
+	auto head = GetHead();
+	path.clear();
+	auto blockId = head->RootBlockId;
+	for (auto level = head->Height; level > 0; level--)
+	{
+		ReadNode(m_Node.get(), blockId);
+		auto childIndex = FindChild(m_Node.get(), key, id);
+		path.push_back({ blockId, childIndex });
+		blockId = GetChild(m_Node.get(), childIndex);
+	}
+	return blockId;
+}
+
+unsigned int BPlusTree::LowerBound(Block* leaf, span<const unsigned char> key, unsigned long long id)
+{
+	unsigned int first = 0;
+	unsigned int last = leaf->GetRecordsCount();
+	while (first < last)
+	{
+		auto middle = first + (last - first) / 2;
+		auto entry = GetRecord(leaf, middle);
+		if (Compare(GetEntryKey(entry), GetId(entry), key, id) < 0)
+		{
+			first = middle + 1;
+		}
+		else
+		{
+			last = middle;
+		}
+	}
+	return first;
+}
+
+unsigned int BPlusTree::FindChild(Block* node, span<const unsigned char> key, unsigned long long id)
+{
+	// Last child whose separator is not greater than (key, id), the first one has none
+	unsigned int first = 1;
+	unsigned int last = node->GetRecordsCount();
+	while (first < last)
+	{
+		auto middle = first + (last - first) / 2;
+		auto nodeEntry = GetRecord(node, middle);
+		if (Compare(GetSeparatorKey(nodeEntry), GetSeparatorId(nodeEntry), key, id) <= 0)
+		{
+			first = middle + 1;
+		}
+		else
+		{
+			last = middle;
+		}
+	}
+	return first - 1;
+}
+
+void BPlusTree::Split(Block* block, Block* sibling, unsigned int index, span<const unsigned char> record, unsigned int leftCount)
+{
+	auto recordSize = block->GetRecordSize();
+	auto recordsCount = block->GetRecordsCount();
+	auto records = vector<unsigned char>((size_t)(recordsCount + 1) * recordSize);
+	auto current = block->GetRecords();
+	memcpy(records.data(), current.data(), (size_t)index * recordSize);
+	memcpy(records.data() + (size_t)index * recordSize, record.data(), recordSize);
+	memcpy(records.data() + (size_t)(index + 1) * recordSize, current.data() + (size_t)index * recordSize, (size_t)(recordsCount - index) * recordSize);
+
+	block->Truncate(0);
+	auto all = span<const unsigned char>(records);
+	for (unsigned int i = 0; i <= recordsCount; i++)
+	{
+		(i < leftCount ? block : sibling)->Append(all.subspan((size_t)i * recordSize, recordSize));
+	}
+}
+
+void BPlusTree::InsertChild(vector<PathStep>& path, unsigned long long childId, vector<unsigned char> key, unsigned long long id)
+{
+	auto head = GetHead();
+	while (true)
+	{
+		if (path.empty())
+		{
+			// The root was split, a new one points to both halves
+			auto rootId = AllocateNode();
+			m_Node->Clear();
+			m_Node->Append(MakeNodeEntry(head->RootBlockId, key, 0));
+			m_Node->Append(MakeNodeEntry(childId, key, id));
+			WriteNode(m_Node.get(), rootId);
+			head->RootBlockId = rootId;
+			head->Height++;
+			return;
+		}
+
+		auto step = path.back();
+		path.pop_back();
+		ReadNode(m_Node.get(), step.BlockId);
+		auto nodeEntry = MakeNodeEntry(childId, key, id);
+		auto index = step.ChildIndex + 1;
+		if (m_Node->GetRecordsCount() < m_Node->GetCapacity())
+		{
+			m_Node->Insert(index, nodeEntry);
+			WriteNode(m_Node.get(), step.BlockId);
+			return;
+		}
+
+		auto capacity = m_Node->GetCapacity();
+		auto siblingId = AllocateNode();
+		m_SiblingNode->Clear();
+		Split(m_Node.get(), m_SiblingNode.get(), index, nodeEntry, (capacity + 1) / 2);
+		WriteNode(m_Node.get(), step.BlockId);
+		WriteNode(m_SiblingNode.get(), siblingId);
+
+		// The separator of the first child of the new node goes up, it is not used in the node itself
+		auto separator = GetRecord(m_SiblingNode.get(), 0);
+		auto separatorKey = GetSeparatorKey(separator);
+		key.assign(separatorKey.begin(), separatorKey.end());
+		id = GetSeparatorId(separator);
+		childId = siblingId;
+	}
+}
+
+void BPlusTree::RebalanceLeaf(vector<PathStep>& path, unsigned long long leafId)
+{
+	auto parent = path.back();
+	ReadNode(m_ParentNode.get(), parent.BlockId);
+
+	// The right sibling when there is one, the left one otherwise
+	auto leftIndex = parent.ChildIndex + 1 < m_ParentNode->GetRecordsCount() ? parent.ChildIndex : parent.ChildIndex - 1;
+	auto rightIndex = leftIndex + 1;
+	auto siblingIndex = leftIndex == parent.ChildIndex ? rightIndex : leftIndex;
+	auto siblingId = GetChild(m_ParentNode.get(), siblingIndex);
+	ReadLeaf(m_SiblingLeaf.get(), siblingId);
+
+	auto left = leftIndex == parent.ChildIndex ? m_Leaf.get() : m_SiblingLeaf.get();
+	auto right = left == m_Leaf.get() ? m_SiblingLeaf.get() : m_Leaf.get();
+	auto leftId = left == m_Leaf.get() ? leafId : siblingId;
+	auto rightId = left == m_Leaf.get() ? siblingId : leafId;
+
+	if (left->GetRecordsCount() + right->GetRecordsCount() <= left->GetCapacity())
+	{
+		// Both fit in the left leaf, the right one is unlinked and freed
+		auto nextId = GetNextLeaf(right);
+		MoveRecords(right, left);
+		SetLeafLinks(left, nextId, GetPrevLeaf(left));
+		if (nextId != InvalidBlockId)
+		{
+			SetPrevLeaf(nextId, leftId);
+		}
+		WriteLeaf(left, leftId);
+		FreeLeaf(rightId);
+		RemoveChild(path, rightIndex);
+		return;
+	}
+
+	// One entry from the sibling is enough, the sibling is at least half full
+	if (left->GetRecordsCount() < right->GetRecordsCount())
+	{
+		left->Append(GetRecord(right, 0));
+		right->Remove(0);
+	}
+	else
+	{
+		auto last = left->GetRecordsCount() - 1;
+		right->Insert(0, GetRecord(left, last));
+		left->Truncate(last);
+	}
+	WriteLeaf(left, leftId);
+	WriteLeaf(right, rightId);
+
+	auto separator = GetRecord(right, 0);
+	SetSeparator(m_ParentNode.get(), rightIndex, GetEntryKey(separator), GetId(separator));
+	WriteNode(m_ParentNode.get(), parent.BlockId);
+}
+
+void BPlusTree::RemoveChild(vector<PathStep>& path, unsigned int childIndex)
+{
+	auto head = GetHead();
+	while (true)
+	{
+		auto step = path.back();
+		path.pop_back();
+		ReadNode(m_Node.get(), step.BlockId);
+		m_Node->Remove(childIndex);
+
+		if (path.empty())
+		{
+			if (m_Node->GetRecordsCount() == 1)
+			{
+				// A root with a single child is not needed, the child becomes the root
+				head->RootBlockId = GetChild(m_Node.get(), 0);
+				head->Height--;
+				FreeNode(step.BlockId);
+				return;
+			}
+			WriteNode(m_Node.get(), step.BlockId);
+			return;
+		}
+
+		if (m_Node->GetRecordsCount() >= m_Node->GetCapacity() / 2)
+		{
+			WriteNode(m_Node.get(), step.BlockId);
+			return;
+		}
+
+		auto parent = path.back();
+		ReadNode(m_ParentNode.get(), parent.BlockId);
+		auto leftIndex = parent.ChildIndex + 1 < m_ParentNode->GetRecordsCount() ? parent.ChildIndex : parent.ChildIndex - 1;
+		auto rightIndex = leftIndex + 1;
+		auto siblingIndex = leftIndex == parent.ChildIndex ? rightIndex : leftIndex;
+		auto siblingId = GetChild(m_ParentNode.get(), siblingIndex);
+		ReadNode(m_SiblingNode.get(), siblingId);
+
+		auto left = leftIndex == parent.ChildIndex ? m_Node.get() : m_SiblingNode.get();
+		auto right = left == m_Node.get() ? m_SiblingNode.get() : m_Node.get();
+		auto leftId = left == m_Node.get() ? step.BlockId : siblingId;
+		auto rightId = left == m_Node.get() ? siblingId : step.BlockId;
+
+		// The separator of the first child of the right node is kept in the parent
+		auto parentSeparator = GetRecord(m_ParentNode.get(), rightIndex);
+		auto parentKey = GetSeparatorKey(parentSeparator);
+		auto separatorKey = vector<unsigned char>(parentKey.begin(), parentKey.end());
+		auto separatorId = GetSeparatorId(parentSeparator);
+
+		if (left->GetRecordsCount() + right->GetRecordsCount() <= left->GetCapacity())
+		{
+			SetSeparator(right, 0, separatorKey, separatorId);
+			MoveRecords(right, left);
+			WriteNode(left, leftId);
+			FreeNode(rightId);
+			childIndex = rightIndex;
+			continue;
+		}
+
+		if (left->GetRecordsCount() < right->GetRecordsCount())
+		{
+			SetSeparator(right, 0, separatorKey, separatorId);
+			left->Append(GetRecord(right, 0));
+			right->Remove(0);
+		}
+		else
+		{
+			auto last = left->GetRecordsCount() - 1;
+			SetSeparator(right, 0, separatorKey, separatorId);
+			right->Insert(0, GetRecord(left, last));
+			left->Truncate(last);
+		}
+		WriteNode(left, leftId);
+		WriteNode(right, rightId);
+
+		auto firstOfRight = GetRecord(right, 0);
+		SetSeparator(m_ParentNode.get(), rightIndex, GetSeparatorKey(firstOfRight), GetSeparatorId(firstOfRight));
+		WriteNode(m_ParentNode.get(), parent.BlockId);
+		return;
+	}
+}
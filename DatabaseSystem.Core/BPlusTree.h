@@ -0,0 +1,135 @@
+#pragma once
+#include "File.h"
+#include "BPlusTreeFileHead.h"
+#include "RecordCursor.h"
+
+/*
+	Disk B+Tree of fixed size entries (rows of an entry schema) kept in order of a key column and then of
+	the Id column, so entries with the same key value are still told apart.
+	The leaves hold the entries and are linked both ways for range scans. They are the blocks of the file
+	at path; the internal nodes are the blocks of path + ".nodes". A node entry is (child block id,
+	separator key, separator Id), the separator being a lower bound of the entries under the child (it is
+	not used for the first child of a node).
+	Inserts split full pages and removals merge a page that drops below half full with a sibling, or
+	borrow an entry from it, so the tree never needs a reorganization. Pages freed by merges are cleared
+	and used again before the files grow.
+*/
+class BPlusTree
+{
+public:
+	static constexpr unsigned long long InvalidBlockId = (unsigned long long)-1;
+	// Leaf header: next and previous leaves
+	static constexpr size_t LeafHeaderSize = 2 * sizeof(unsigned long long);
+
+	// Where Insert put an entry, and whether entries already in the tree changed place to make room for it
+	struct EntryPosition
+	{
+		unsigned long long LeafId;
+		unsigned int Index;
+		bool Moved;
+	};
+
+	BPlusTree(size_t blockSize, BufferPool* bufferPool);
+
+	// The tree keeps its own copy of the entry schema, whose first column must be the Id
+	void Create(string path, Schema* entrySchema, unsigned int keyColumnId);
+	void Open(string path);
+	void Close();
+	void Checkpoint();
+	// Same meaning as for the record files, before Create/Open
+	void SetFileAccessMode(FileAccessMode mode);
+	void SetWriteBack(bool enabled);
+
+	Schema* GetSchema();
+	unsigned int GetKeyColumnId();
+	unsigned long long GetEntriesCount();
+	// The file of the leaves, its blocks are the leaves (and the cleared free pages)
+	FileWrapper<BPlusTreeFileHead>* GetLeafFile();
+	// Blocks of both files read and written since the last ClearAccessCount
+	unsigned long long GetReadBlocksCount() const;
+	unsigned long long GetWrittenBlocksCount() const;
+	void ClearAccessCount();
+
+	// Returns false, leaving the tree as it was, when an entry with the same key and Id is already in it
+	bool Insert(span<const unsigned char> entry, EntryPosition* position = nullptr);
+	// Removes the entry with the given key and Id, returns false when there is none. moved tells whether other entries changed place
+	bool Remove(span<const unsigned char> key, unsigned long long id, bool* moved = nullptr);
+	// Copies the entry with the given key and Id into entry, returns false when there is none
+	bool Find(span<const unsigned char> key, unsigned long long id, span<unsigned char> entry);
+	// Replaces the content of the tree by entries (back to back, sorted by key and Id) with full pages
+	void Load(span<const unsigned char> entries);
+	// The entries with a key in [min, max] in order, an empty bound is open
+	unique_ptr<RecordCursor> OpenCursor(vector<unsigned char> min, vector<unsigned char> max, RecordCursor::FilterFunction filter = nullptr);
+
+private:
+	// Node visited on the way down and the child taken
+	struct PathStep
+	{
+		unsigned long long BlockId;
+		unsigned int ChildIndex;
+	};
+
+	unique_ptr<FileWrapper<BPlusTreeFileHead>> m_Leaves;
+	unique_ptr<FileWrapper<BPlusTreeFileHead>> m_Nodes;
+	// The head of the leaves file holds the state of the tree, the one of the nodes file only its blocks count
+	unique_ptr<BPlusTreeFileHead> m_Head;
+	unique_ptr<BPlusTreeFileHead> m_NodesHead;
+	unique_ptr<Schema> m_EntrySchema;
+	unique_ptr<Schema> m_NodeSchema;
+	const Column* m_KeyColumn;
+	unique_ptr<Block> m_Leaf;
+	unique_ptr<Block> m_SiblingLeaf;
+	unique_ptr<Block> m_Node;
+	unique_ptr<Block> m_SiblingNode;
+	unique_ptr<Block> m_ParentNode;
+	unsigned long long m_ReadBlocksCount;
+	unsigned long long m_WrittenBlocksCount;
+
+	void CreateBlocks();
+	BPlusTreeFileHead* GetHead();
+
+	int Compare(span<const unsigned char> keyA, unsigned long long idA, span<const unsigned char> keyB, unsigned long long idB);
+	span<const unsigned char> GetEntryKey(span<const unsigned char> entry);
+	span<const unsigned char> GetSeparatorKey(span<const unsigned char> nodeEntry);
+	unsigned long long GetSeparatorId(span<const unsigned char> nodeEntry);
+	unsigned long long GetChild(Block* node, unsigned int index);
+	unsigned long long GetChild(span<const unsigned char> nodeEntry);
+	void SetSeparator(Block* node, unsigned int index, span<const unsigned char> key, unsigned long long id);
+	vector<unsigned char> MakeNodeEntry(unsigned long long childId, span<const unsigned char> key, unsigned long long id);
+	span<unsigned char> GetRecord(Block* block, unsigned int index);
+	unsigned long long GetId(span<const unsigned char> record);
+	// Moves the records of source to the end of destination and empties source
+	void MoveRecords(Block* source, Block* destination);
+
+	unsigned long long GetNextLeaf(Block* leaf);
+	unsigned long long GetPrevLeaf(Block* leaf);
+	void SetLeafLinks(Block* leaf, unsigned long long nextId, unsigned long long prevId);
+	void SetPrevLeaf(unsigned long long leafId, unsigned long long prevId);
+
+	void ReadLeaf(Block* leaf, unsigned long long leafId);
+	void WriteLeaf(Block* leaf, unsigned long long leafId);
+	void ReadNode(Block* node, unsigned long long nodeId);
+	void WriteNode(Block* node, unsigned long long nodeId);
+	unsigned long long AllocateLeaf();
+	unsigned long long AllocateNode();
+	void FreeLeaf(unsigned long long leafId);
+	void FreeNode(unsigned long long nodeId);
+	// Zeroes a page given back to a free list
+	void ClearPage(FileWrapper<BPlusTreeFileHead>* file, unsigned long long blockId);
+
+	// Leaf where (key, id) is or would be, with the nodes visited
+	unsigned long long Descend(span<const unsigned char> key, unsigned long long id, vector<PathStep>& path);
+	// First entry of the leaf not smaller than (key, id)
+	unsigned int LowerBound(Block* leaf, span<const unsigned char> key, unsigned long long id);
+	// Child of the node whose entries can hold (key, id)
+	unsigned int FindChild(Block* node, span<const unsigned char> key, unsigned long long id);
+
+	// Splits block (full) into itself and sibling adding record at index, with at least one record on each side
+	void Split(Block* block, Block* sibling, unsigned int index, span<const unsigned char> record, unsigned int leftCount);
+	// Adds (childId, key, id) after the child taken in the last node of path, splitting the nodes up the path as needed
+	void InsertChild(vector<PathStep>& path, unsigned long long childId, vector<unsigned char> key, unsigned long long id);
+	// The leaf in m_Leaf went below half full: merged with or completed from a sibling
+	void RebalanceLeaf(vector<PathStep>& path, unsigned long long leafId);
+	// Removes the child at childIndex from the last node of path, merging or completing the nodes up the path as needed
+	void RemoveChild(vector<PathStep>& path, unsigned int childIndex);
+};
@@ -0,0 +1,36 @@
+#include "pch.h"
+#include "BPlusTreeFileHead.h"
+
+BPlusTreeFileHead::BPlusTreeFileHead(Schema* schema) :
+	KeyColumnId(0),
+	Height(0),
+	RootBlockId((unsigned long long)-1),
+	FirstLeafBlockId((unsigned long long)-1),
+	EntriesCount(0)
+{
+	m_Schema = schema;
+}
+
+void BPlusTreeFileHead::Serialize(iostream& dst)
+{
+	FileHead::Serialize(dst);
+	WriteField(dst, KeyColumnId);
+	WriteField(dst, Height);
+	WriteField(dst, RootBlockId);
+	WriteField(dst, FirstLeafBlockId);
+	WriteField(dst, EntriesCount);
+	WriteArray(dst, FreeLeaves);
+	WriteArray(dst, FreeNodes);
+}
+
+void BPlusTreeFileHead::Deserialize(iostream& src)
+{
+	FileHead::Deserialize(src);
+	ReadField(src, KeyColumnId);
+	ReadField(src, Height);
+	ReadField(src, RootBlockId);
+	ReadField(src, FirstLeafBlockId);
+	ReadField(src, EntriesCount);
+	ReadArray(src, FreeLeaves);
+	ReadArray(src, FreeNodes);
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "FileHead.h"
+
+class BPlusTreeFileHead : public FileHead
+{
+public:
+	BPlusTreeFileHead(Schema* schema);
+
+	unsigned int KeyColumnId;
+	// Levels of internal nodes above the leaves, 0 when the root is a leaf
+	unsigned int Height;
+	unsigned long long RootBlockId;
+	unsigned long long FirstLeafBlockId;
+	unsigned long long EntriesCount;
+	// Pages emptied by merges, used again before the files grow
+	vector<unsigned long long> FreeLeaves;
+	vector<unsigned long long> FreeNodes;
+
+	// Inherited via FileHead
+	virtual void Serialize(iostream& dst) override;
+	virtual void Deserialize(iostream& src) override;
+};
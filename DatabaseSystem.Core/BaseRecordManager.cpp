@@ -1,21 +1,40 @@
 
 #include "pch.h"
 #include "BaseRecordManager.h"
-
-BaseRecordManager::BaseRecordManager() :
+#include <unordered_set>
+#include <atomic>
+#include <future>
+#include <map>
+#include <mutex>
+#include <thread>
+
+BaseRecordManager::BaseRecordManager(size_t blockSize, BufferPool* bufferPool) :
 	m_ReadBlock(nullptr),
 	m_WriteBlock(nullptr),
+	m_BufferPool(bufferPool),
 	m_RecordsPerBlock(0),
+	m_NextReadBlockNumber(0),
 	m_LastQueryBlockReadAccessCount(0),
 	m_LastQueryBlockWriteAccessCount(0),
-	m_NextReadBlockNumber(0)
+	m_ScanThreadsCount(max(1u, thread::hardware_concurrency())),
+	m_IndexesOutdated(false)
 {
+	if (m_BufferPool == nullptr)
+	{
+		// No shared pool given, all the files of this manager share a private one
+		m_OwnedBufferPool = make_unique<BufferPool>(BufferPool::DefaultFramesCount, blockSize);
+		m_BufferPool = m_OwnedBufferPool.get();
+	}
 }
 
 void BaseRecordManager::Create(string path, Schema* schema)
 {
 	GetFile()->NewFile(path, CreateNewFileHead(schema));
+	InitializeCreatedFile(path);
+}
 
+void BaseRecordManager::InitializeCreatedFile(string path)
+{
 	auto schemaSize = GetSchema()->GetSize();
 	auto blockLength = GetFile()->GetBlockSize();
 	auto blockContentLength = GetFile()->GetBlockSize() - sizeof(unsigned int) - GetFile()->GetBlockHeaderSize();
@@ -23,19 +42,29 @@ void BaseRecordManager::Create(string path, Schema* schema)
 
 	m_ReadBlock = GetFile()->CreateBlock();
 	m_WriteBlock = GetFile()->CreateBlock();
+
+	// Indexes left by an older file of the same path would be opened with it
+	m_Indexes.clear();
+	m_IndexesOutdated = false;
+	for (unsigned int columnId = 0; columnId < GetSchema()->GetColumnsCount(); columnId++)
+	{
+		SecondaryIndex::RemoveFiles(path, columnId);
+	}
 }
 
 void BaseRecordManager::Open(string path)
 {
 	GetFile()->Open(path, CreateNewFileHead(nullptr));
+	InitializeOpenedFile(path);
+}
 
-	auto schemaSize = GetSchema()->GetSize();
-	auto blockLength = GetFile()->GetBlockSize();
-	auto blockContentLength = GetFile()->GetBlockSize() - sizeof(unsigned int);
-	m_RecordsPerBlock = floor(blockContentLength / schemaSize);
-
+void BaseRecordManager::InitializeOpenedFile(string path)
+{
 	m_ReadBlock = GetFile()->CreateBlock();
 	m_WriteBlock = GetFile()->CreateBlock();
+	// Same layout as on Create, including the block header
+	m_RecordsPerBlock = m_ReadBlock->GetCapacity();
+	OpenIndexes(path);
 }
 
 void BaseRecordManager::Close()
@@ -45,6 +74,7 @@ void BaseRecordManager::Close()
 	{
 		AddBlock(m_WriteBlock);
 	}
+	CloseIndexes();
 	GetFile()->Close();
 }
 
@@ -53,6 +83,45 @@ Schema* BaseRecordManager::GetSchema()
 	return GetFile()->GetHead()->GetSchema();
 }
 
+BufferPool* BaseRecordManager::GetBufferPool()
+{
+	return m_BufferPool;
+}
+
+void BaseRecordManager::SetFileAccessMode(FileAccessMode mode)
+{
+	GetFile()->SetAccessMode(mode);
+}
+
+void BaseRecordManager::SetWriteBack(bool enabled)
+{
+	GetFile()->SetWriteBack(enabled);
+}
+
+void BaseRecordManager::Checkpoint()
+{
+	GetFile()->Checkpoint();
+	if (m_IndexesOutdated)
+	{
+		// Inserts made meanwhile are not in them
+		RebuildIndexes();
+	}
+	for (auto& index : m_Indexes)
+	{
+		index->Checkpoint();
+	}
+}
+
+void BaseRecordManager::SetScanThreadsCount(size_t threadsCount)
+{
+	m_ScanThreadsCount = max(threadsCount, (size_t)1);
+}
+
+size_t BaseRecordManager::GetScanThreadsCount() const
+{
+	return m_ScanThreadsCount;
+}
+
 unsigned long long BaseRecordManager::GetSize()
 {
 	auto writtenBlocks = GetFile()->GetBlockSize() * GetBlocksCount();
@@ -79,13 +148,32 @@ bool BaseRecordManager::MoveNext(Record* record, unsigned long long& accessedBlo
 	return MoveNext(record, accessedBlocks, blockId, recordNumberInBlock);
 }
 
-void BaseRecordManager::InsertMany(vector<Record> records)
+void BaseRecordManager::InsertMany(const vector<Record>& records)
+{
+	// Packed back to back the records take the bulk path of the organization
+	auto recordSize = (size_t)GetSchema()->GetSize();
+	auto packedRecords = vector<unsigned char>(records.size() * recordSize);
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		memcpy(packedRecords.data() + i * recordSize, records[i].GetData()->data(), recordSize);
+	}
+
+	BeginBulkInsert();
+	InsertMany(span<const unsigned char>(packedRecords));
+	EndBulkInsert();
+}
+
+void BaseRecordManager::InsertMany(span<const unsigned char> records)
 {
 	ClearAccessCount();
 	unsigned long long readAccessedBlocks = 0;
 	unsigned long long writeAccessedBlocks = 0;
-	for (auto &record : records) 
+
+	auto recordSize = (size_t)GetSchema()->GetSize();
+	auto record = Record(GetSchema());
+	for (size_t offset = 0; offset + recordSize <= records.size(); offset += recordSize)
 	{
+		memcpy(record.GetData()->data(), records.data() + offset, recordSize);
 		Insert(record);
 
 		readAccessedBlocks += m_LastQueryBlockReadAccessCount;
@@ -95,6 +183,34 @@ void BaseRecordManager::InsertMany(vector<Record> records)
 	m_LastQueryBlockWriteAccessCount = writeAccessedBlocks;
 }
 
+unsigned long long BaseRecordManager::InsertFromCsv(string path, unsigned long long lines)
+{
+	unsigned long long readAccessedBlocks = 0;
+	unsigned long long writeAccessedBlocks = 0;
+
+	BeginBulkInsert();
+	auto loader = CsvLoader(GetSchema());
+	auto loaded = loader.Load(path, [&](span<const unsigned char> records)
+	{
+		InsertMany(records);
+		readAccessedBlocks += m_LastQueryBlockReadAccessCount;
+		writeAccessedBlocks += m_LastQueryBlockWriteAccessCount;
+	}, lines);
+
+	m_LastQueryBlockReadAccessCount = readAccessedBlocks;
+	m_LastQueryBlockWriteAccessCount = writeAccessedBlocks;
+	EndBulkInsert();
+	return loaded;
+}
+
+void BaseRecordManager::BeginBulkInsert()
+{
+}
+
+void BaseRecordManager::EndBulkInsert()
+{
+}
+
 Record* BaseRecordManager::Select(unsigned long long id)
 {
 	ClearAccessCount();
@@ -115,77 +231,96 @@ Record* BaseRecordManager::Select(unsigned long long id)
 	return nullptr;
 }
 
-vector<Record*> BaseRecordManager::Select(vector<unsigned long long> ids)
+ResultSet BaseRecordManager::Select(vector<unsigned long long> ids)
 {
 	ClearAccessCount();
-	unsigned long long readAccessedBlocks = 0;
-	unsigned long long writeAccessedBlocks = 0;
 
-	auto records = vector<Record*>();
-	for (auto id : ids)
-	{
-		auto found = Select(id);
-		readAccessedBlocks += m_LastQueryBlockReadAccessCount;
-		writeAccessedBlocks += m_LastQueryBlockWriteAccessCount;
+	// A single scan probing the ids, instead of one scan per id
+	auto wanted = unordered_set<unsigned long long>(ids.begin(), ids.end());
+	auto cursor = OpenScanCursor([&wanted](Block* block, SelectionBitmap& selection) {
+		auto records = block->GetRecords();
+		auto recordSize = block->GetRecordSize();
+		selection.Reset(block->GetRecordsCount());
+		for (size_t i = 0; i < selection.GetSize(); i++)
+		{
+			if (wanted.contains(*(unsigned long long*)(records.data() + i * recordSize)))
+			{
+				selection.Set(i);
+			}
+		}
+	});
 
-		if (found == nullptr) continue;
-		records.push_back(found);
+	auto records = ResultSet(GetSchema());
+	// Ids are unique, stop as soon as all of them were found
+	while (records.size() < wanted.size() && cursor->MoveNext())
+	{
+		cursor->CopyCurrent(records.Append());
 	}
-	m_LastQueryBlockReadAccessCount = readAccessedBlocks;
-	m_LastQueryBlockWriteAccessCount = writeAccessedBlocks;
+	m_LastQueryBlockReadAccessCount = cursor->GetReadBlocksCount();
 	return records;
 }
 
-vector<Record*> BaseRecordManager::SelectWhereBetween(unsigned int columnId, span<unsigned char> min, span<unsigned char> max)
+ResultSet BaseRecordManager::SelectWhereBetween(unsigned int columnId, span<unsigned char> min, span<unsigned char> max, const Projection* projection)
 {
-	ClearAccessCount();
-	unsigned long long accessedBlocks = 0;
-
-	auto records = vector<Record*>();
-	auto schema = GetSchema();
-	auto column = schema->GetColumn(columnId);
+	return SelectWhere(Predicate::Between(columnId, min, max), projection);
+}
 
-	auto currentRecord = Record(schema);
+ResultSet BaseRecordManager::SelectWhereEquals(unsigned int columnId, span<unsigned char> data, const Projection* projection)
+{
+	return SelectWhere(Predicate::Equals(columnId, data), projection);
+}
 
-	MoveToStart();
-	while (MoveNext(&currentRecord, accessedBlocks))
+ResultSet BaseRecordManager::SelectWhere(const Predicate& predicate, const Projection* projection)
+{
+	ClearAccessCount();
+	vector<IndexMatch> matches;
+	if (FindWithIndex(predicate, matches))
 	{
-		auto value = schema->GetValue(currentRecord.GetData(), columnId);
-
-		if (Column::Compare(column, value, min) >= 0 && Column::Compare(column, value, max) <= 0)
+		auto records = ResultSet(projection != nullptr ? projection->GetSchema() : GetSchema());
+		for (auto& match : matches)
 		{
-			auto newRecord = new Record(schema);
-			memcpy(newRecord->GetData()->data(), currentRecord.GetData()->data(), schema->GetSize());
-			records.push_back(newRecord);
+			if (projection != nullptr)
+			{
+				projection->Copy(match.Record, records.Append());
+				continue;
+			}
+			records.Append(match.Record);
 		}
+		return records;
 	}
-	return records;
+	return ParallelSelect(predicate.ToFilter(GetSchema()), projection);
 }
 
-vector<Record*> BaseRecordManager::SelectWhereEquals(unsigned int columnId, span<unsigned char> data)
+ResultSet BaseRecordManager::Aggregate(const Aggregation& aggregation, const Predicate* predicate)
 {
 	ClearAccessCount();
-	unsigned long long accessedBlocks = 0;
+	auto cursor = predicate != nullptr ? OpenCursorWhere(*predicate) : OpenCursor();
+	// Blocks read to open the cursor (the search of an ordered file) are not returned by it
+	auto openReadsCount = m_LastQueryBlockReadAccessCount;
+	auto result = aggregation.Run(*cursor);
+	m_LastQueryBlockReadAccessCount = openReadsCount + cursor->GetReadBlocksCount();
+	return result;
+}
 
-	auto records = vector<Record*>();
-	auto schema = GetSchema();
-	auto column = schema->GetColumn(columnId);
+unique_ptr<RecordCursor> BaseRecordManager::OpenCursor()
+{
+	return OpenScanCursor(nullptr);
+}
 
-	auto currentRecord = Record(schema);
+unique_ptr<RecordCursor> BaseRecordManager::OpenCursorWhereBetween(unsigned int columnId, span<unsigned char> min, span<unsigned char> max)
+{
+	return OpenCursorWhere(Predicate::Between(columnId, min, max));
+}
 
-	MoveToStart();
-	while (MoveNext(&currentRecord, accessedBlocks))
-	{
-		auto value = schema->GetValue(currentRecord.GetData(), columnId);
+unique_ptr<RecordCursor> BaseRecordManager::OpenCursorWhereEquals(unsigned int columnId, span<unsigned char> data)
+{
+	return OpenCursorWhere(Predicate::Equals(columnId, data));
+}
 
-		if (Column::Equals(column, value, data))
-		{
-			auto newRecord = new Record(schema);
-			memcpy(newRecord->GetData()->data(), currentRecord.GetData()->data(), schema->GetSize());
-			records.push_back(newRecord);
-		}
-	}
-	return records;
+unique_ptr<RecordCursor> BaseRecordManager::OpenCursorWhere(const Predicate& predicate)
+{
+	// The predicate runs over a whole block at a time
+	return OpenScanCursor(predicate.ToFilter(GetSchema()));
 }
 
 void BaseRecordManager::Delete(unsigned long long recordId)
@@ -206,6 +341,7 @@ void BaseRecordManager::Delete(unsigned long long recordId)
 	{
 		if (currentRecord.getId() == recordId)
 		{
+			RemoveFromIndexes(*currentRecord.GetData());
 			DeleteInternal(recordId, blockId, recordNumberInBlock);
 			break;
 		}
@@ -214,26 +350,81 @@ void BaseRecordManager::Delete(unsigned long long recordId)
 }
 
 int BaseRecordManager::DeleteWhereEquals(unsigned int columnId, span<unsigned char> data)
+{
+	return DeleteWhere(Predicate::Equals(columnId, data));
+}
+
+int BaseRecordManager::DeleteWhere(const Predicate& predicate)
 {
 	ClearAccessCount();
 
-	int removedCount = 0;
-	unsigned long long accessedBlocks = 0;
+	vector<IndexMatch> indexMatches;
+	if (FindWithIndex(predicate, indexMatches))
+	{
+		// From the end, removing a record of the write block moves its last record
+		for (auto match = indexMatches.rbegin(); match != indexMatches.rend(); match++)
+		{
+			RemoveFromIndexes(match->Record);
+			DeleteInternal(*(unsigned long long*)match->Record.data(), match->BlockId, match->RecordNumberInBlock);
+		}
+		Reorganize();
+		return (int)indexMatches.size();
+	}
 
-	auto schema = GetSchema();
-	auto column = schema->GetColumn(columnId);
-	auto currentRecord = Record(schema);
+	auto filter = predicate.ToFilter(GetSchema());
+	// The records are copied only when the indexes need their values to remove them
+	auto keepRecords = !m_Indexes.empty();
 
-	unsigned long long blockId;
-	unsigned long long recordNumberInBlock;
+	struct Match
+	{
+		unsigned long long RecordId;
+		unsigned long long BlockId;
+		unsigned long long RecordNumberInBlock;
+		vector<unsigned char> Record;
+	};
+	auto copyRecord = [keepRecords](RecordCursor& cursor) {
+		auto record = vector<unsigned char>();
+		if (keepRecords)
+		{
+			auto data = cursor.GetCurrent().GetData();
+			record.assign(data.begin(), data.end());
+		}
+		return record;
+	};
 
-	MoveToStart();
-	while (MoveNext(&currentRecord, accessedBlocks, blockId, recordNumberInBlock))
+	// The write block records are reported as being in the block after the last one (see MoveNext).
+	// Removing one of them moves the last record of the block into its place, so they go from the end
+	vector<Match> writeBlockMatches;
+	auto blocksCount = GetBlocksCount();
+	auto writeBlockCursor = OpenWriteBlockCursor(filter);
+	while (writeBlockCursor->MoveNext())
+	{
+		writeBlockMatches.push_back({ writeBlockCursor->GetCurrent().getId(), blocksCount, writeBlockCursor->GetRecordNumber(), copyRecord(*writeBlockCursor) });
+	}
+
+	// The file is searched in parallel, the records are removed afterwards on this thread
+	auto morsels = vector<vector<Match>>(GetMorselsCount());
+	ParallelScan(filter, [&morsels, &copyRecord](size_t morsel, unsigned long long firstBlockId, RecordCursor& cursor) {
+		while (cursor.MoveNext())
+		{
+			auto blockId = firstBlockId + cursor.GetReadBlocksCount() - 1;
+			morsels[morsel].push_back({ cursor.GetCurrent().getId(), blockId, cursor.GetRecordNumber(), copyRecord(cursor) });
+		}
+	});
+
+	int removedCount = 0;
+	for (auto match = writeBlockMatches.rbegin(); match != writeBlockMatches.rend(); match++)
+	{
+		RemoveFromIndexes(match->Record);
+		DeleteInternal(match->RecordId, match->BlockId, match->RecordNumberInBlock);
+		removedCount++;
+	}
+	for (auto& matches : morsels)
 	{
-		auto value = schema->GetValue(currentRecord.GetData(), columnId);
-		if (Column::Equals(column, value, data))
+		for (auto& match : matches)
 		{
-			DeleteInternal(currentRecord.getId(), blockId, recordNumberInBlock);
+			RemoveFromIndexes(match.Record);
+			DeleteInternal(match.RecordId, match.BlockId, match.RecordNumberInBlock);
 			removedCount++;
 		}
 	}
@@ -244,6 +435,7 @@ int BaseRecordManager::DeleteWhereEquals(unsigned int columnId, span<unsigned ch
 void BaseRecordManager::MoveToStart()
 {
 	m_NextReadBlockNumber = 0;
+	m_WriteBlock->MoveToStart();
 }
 
 bool BaseRecordManager::MoveNext(Record* record, unsigned long long& accessedBlocks, unsigned long long& blockId, unsigned long long& recordNumberInBlock)
@@ -259,9 +451,16 @@ bool BaseRecordManager::MoveNext(Record* record, unsigned long long& accessedBlo
 		}
 	}
 
+	// The write block records come first, they are reported as being in the block after the last one
+	auto inWriteBlock = m_WriteBlock->GetPosition() < (int)m_WriteBlock->GetRecordsCount();
 	bool returnVal = TryGetNextValidRecord(record);
 
-	if (returnVal)
+	if (returnVal && inWriteBlock)
+	{
+		recordNumberInBlock = m_WriteBlock->GetPosition() - 1;
+		blockId = blocksCount;
+	}
+	else if (returnVal)
 	{
 		recordNumberInBlock = m_ReadBlock->GetPosition() - 1;
 		blockId = m_NextReadBlockNumber - 1;
@@ -276,6 +475,237 @@ void BaseRecordManager::ClearAccessCount()
 	m_LastQueryBlockWriteAccessCount = 0;
 }
 
+void BaseRecordManager::CreateIndex(unsigned int columnId)
+{
+	if (HasIndex(columnId))
+	{
+		return;
+	}
+
+	auto index = CreateIndexObject();
+	index->Create(GetFile()->GetPath(), GetSchema(), columnId);
+	m_Indexes.push_back(move(index));
+	// A single scan fills the new index (and the others, if they were outdated)
+	RebuildIndexes();
+}
+
+void BaseRecordManager::DropIndex(unsigned int columnId)
+{
+	for (auto index = m_Indexes.begin(); index != m_Indexes.end(); index++)
+	{
+		if ((*index)->GetColumnId() == columnId)
+		{
+			(*index)->Close();
+			m_Indexes.erase(index);
+			SecondaryIndex::RemoveFiles(GetFile()->GetPath(), columnId);
+			return;
+		}
+	}
+}
+
+bool BaseRecordManager::HasIndex(unsigned int columnId)
+{
+	for (auto& index : m_Indexes)
+	{
+		if (index->GetColumnId() == columnId)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void BaseRecordManager::AddToIndexes(span<const unsigned char> record, unsigned long long blockId, unsigned long long recordNumberInBlock)
+{
+	if (m_IndexesOutdated)
+	{
+		return;
+	}
+	for (auto& index : m_Indexes)
+	{
+		index->Insert(record, blockId, recordNumberInBlock);
+	}
+}
+
+void BaseRecordManager::AddToIndexes(Block* block, unsigned long long blockId, unsigned long long recordNumberInBlock)
+{
+	span<unsigned char> record;
+	if (m_Indexes.empty() || !block->GetRecordSpan(recordNumberInBlock, &record))
+	{
+		return;
+	}
+	AddToIndexes(record, blockId, recordNumberInBlock);
+}
+
+void BaseRecordManager::RemoveFromIndexes(span<const unsigned char> record)
+{
+	if (m_IndexesOutdated)
+	{
+		return;
+	}
+	for (auto& index : m_Indexes)
+	{
+		index->Remove(record);
+	}
+}
+
+void BaseRecordManager::InvalidateIndexes()
+{
+	// Built again when used, until then the inserts and deletes leave them alone
+	m_IndexesOutdated = !m_Indexes.empty();
+}
+
+void BaseRecordManager::CloseIndexes()
+{
+	if (m_IndexesOutdated)
+	{
+		RebuildIndexes();
+	}
+	for (auto& index : m_Indexes)
+	{
+		index->Close();
+	}
+	m_Indexes.clear();
+}
+
+void BaseRecordManager::OpenIndexes(string path)
+{
+	m_Indexes.clear();
+	m_IndexesOutdated = false;
+	for (unsigned int columnId = 0; columnId < GetSchema()->GetColumnsCount(); columnId++)
+	{
+		if (!filesystem::exists(SecondaryIndex::GetPath(path, columnId)))
+		{
+			continue;
+		}
+		auto index = CreateIndexObject();
+		index->Open(path, GetSchema(), columnId);
+		m_Indexes.push_back(move(index));
+	}
+}
+
+unique_ptr<SecondaryIndex> BaseRecordManager::CreateIndexObject()
+{
+	// The indexes follow the settings of the records file
+	auto index = make_unique<SecondaryIndex>(GetFile()->GetBlockSize(), m_BufferPool);
+	index->SetFileAccessMode(GetFile()->GetAccessMode());
+	index->SetWriteBack(GetFile()->IsWriteBack());
+	return index;
+}
+
+void BaseRecordManager::RebuildIndexes()
+{
+	auto entries = vector<vector<unsigned char>>(m_Indexes.size());
+	auto blocksCount = GetBlocksCount();
+	auto inWriteBlock = m_WriteBlock->GetRecordsCount() > 0;
+	auto cursor = OpenScanCursor(nullptr);
+	while (cursor->MoveNext())
+	{
+		// The write block comes first, as the block after the last one
+		auto readBlocksCount = cursor->GetReadBlocksCount();
+		auto blockId = !inWriteBlock ? readBlocksCount - 1 : readBlocksCount == 1 ? blocksCount : readBlocksCount - 2;
+		auto record = cursor->GetCurrent().GetData();
+		for (size_t i = 0; i < m_Indexes.size(); i++)
+		{
+			m_Indexes[i]->AppendEntry(entries[i], record, blockId, cursor->GetRecordNumber());
+		}
+	}
+
+	for (size_t i = 0; i < m_Indexes.size(); i++)
+	{
+		m_Indexes[i]->Load(entries[i]);
+	}
+	m_IndexesOutdated = false;
+}
+
+bool BaseRecordManager::FindWithIndex(const Predicate& predicate, vector<IndexMatch>& matches)
+{
+	if (m_Indexes.empty())
+	{
+		return false;
+	}
+
+	auto schema = GetSchema();
+	// Each entry may cost a read of its own, past a quarter of the blocks a scan reads less
+	auto blocksCount = GetBlocksCount();
+	auto limit = blocksCount / 4 + 1;
+	for (auto attempt = 0; attempt < 2; attempt++)
+	{
+		if (m_IndexesOutdated)
+		{
+			RebuildIndexes();
+		}
+
+		auto found = false;
+		vector<SecondaryIndex::Entry> entries;
+		for (auto& index : m_Indexes)
+		{
+			found = index->Find(predicate, schema, limit, entries);
+			m_LastQueryBlockReadAccessCount += index->GetReadBlocksCount();
+			if (found)
+			{
+				break;
+			}
+		}
+		if (!found)
+		{
+			return false;
+		}
+
+		sort(entries.begin(), entries.end(), [](const SecondaryIndex::Entry& a, const SecondaryIndex::Entry& b) {
+			return a.BlockId < b.BlockId || (a.BlockId == b.BlockId && a.RecordNumberInBlock < b.RecordNumberInBlock);
+		});
+
+		// Each block is read once and the whole predicate is evaluated on it, the entries only tell where to look.
+		// A position that does not hold the record of the entry means records moved since the index was written
+		matches.clear();
+		auto outdated = false;
+		SelectionBitmap selection;
+		size_t next = 0;
+		while (next < entries.size() && !outdated)
+		{
+			auto blockId = entries[next].BlockId;
+			auto block = m_WriteBlock;
+			if (blockId > blocksCount)
+			{
+				outdated = true;
+				break;
+			}
+			if (blockId < blocksCount)
+			{
+				ReadBlock(m_ReadBlock, blockId);
+				block = m_ReadBlock;
+			}
+			else
+			{
+				m_LastQueryBlockReadAccessCount++;
+			}
+			predicate.Evaluate(schema, block, selection);
+
+			for (; next < entries.size() && entries[next].BlockId == blockId; next++)
+			{
+				auto& entry = entries[next];
+				span<unsigned char> record;
+				if (!block->GetRecordSpan(entry.RecordNumberInBlock, &record) || *(unsigned long long*)record.data() != entry.RecordId)
+				{
+					outdated = true;
+					break;
+				}
+				if (selection.Test(entry.RecordNumberInBlock))
+				{
+					matches.push_back({ blockId, entry.RecordNumberInBlock, vector<unsigned char>(record.begin(), record.end()) });
+				}
+			}
+		}
+		if (!outdated)
+		{
+			return true;
+		}
+		InvalidateIndexes();
+	}
+	return false;
+}
+
 unsigned long long BaseRecordManager::GetBlocksCount()
 {
 	return GetFile()->GetHead()->GetBlocksCount();
@@ -283,7 +713,8 @@ unsigned long long BaseRecordManager::GetBlocksCount()
 
 bool BaseRecordManager::ReadNextBlock()
 {
-	auto r = ReadBlock(m_ReadBlock, m_NextReadBlockNumber);
+	// Scans read each block once, keep them out of the buffer pool
+	auto r = ReadBlock(m_ReadBlock, m_NextReadBlockNumber, false);
 	m_NextReadBlockNumber++;
 	return r;
 }
@@ -300,10 +731,17 @@ void BaseRecordManager::AddBlock(Block* block)
 	m_LastQueryBlockWriteAccessCount++;
 }
 
-bool BaseRecordManager::ReadBlock(Block* block, unsigned long long blockId)
+void BaseRecordManager::AppendRecord(Block* block, span<const unsigned char> record, unsigned long long id)
 {
-	block->Clear();
-	auto r = GetFile()->GetBlock(blockId, block);
+	block->Append(record);
+	span<unsigned char> appended;
+	block->GetRecordSpan(block->GetRecordsCount() - 1, &appended);
+	memcpy(appended.data(), &id, sizeof(id));
+}
+
+bool BaseRecordManager::ReadBlock(Block* block, unsigned long long blockId, bool keepInPool)
+{
+	auto r = GetFile()->GetBlock(blockId, block, keepInPool);
 	block->MoveToStart();
 	m_LastQueryBlockReadAccessCount++;
 	return r;
@@ -339,7 +777,7 @@ bool BaseRecordManager::TryGetNextValidRecord(Record* record)
 	}
 
 	auto blocksInFile = GetBlocksCount();
-	while (blocksInFile > 0 && m_NextReadBlockNumber < blocksInFile - 1)
+	while (blocksInFile > 0)
 	{
 		while (m_ReadBlock->GetRecord(recordData))
 		{
@@ -349,7 +787,178 @@ bool BaseRecordManager::TryGetNextValidRecord(Record* record)
 				return true;
 			}
 		}
+		if (m_NextReadBlockNumber >= blocksInFile)
+		{
+			break;
+		}
 		ReadNextBlock();
 	}
 	return false;
+}
+
+unique_ptr<RecordCursor> BaseRecordManager::OpenScanCursor(RecordCursor::FilterFunction filter)
+{
+	auto blocksCount = GetBlocksCount();
+	unsigned long long nextBlockId = 0;
+	auto writeBlockVisited = false;
+
+	auto nextBlock = [this, blocksCount, nextBlockId, writeBlockVisited](Block* buffer) mutable -> Block* {
+		if (!writeBlockVisited)
+		{
+			writeBlockVisited = true;
+			if (m_WriteBlock->GetRecordsCount() > 0)
+			{
+				m_LastQueryBlockReadAccessCount++;
+				return m_WriteBlock;
+			}
+		}
+		if (nextBlockId >= blocksCount)
+		{
+			return nullptr;
+		}
+		// Scans read each block once, keep them out of the buffer pool
+		ReadBlock(buffer, nextBlockId++, false);
+		return buffer;
+	};
+	return make_unique<RecordCursor>(GetSchema(), unique_ptr<Block>(GetFile()->CreateBlock()), nextBlock, filter);
+}
+
+unique_ptr<RecordCursor> BaseRecordManager::OpenWriteBlockCursor(RecordCursor::FilterFunction filter)
+{
+	auto visited = false;
+	auto nextBlock = [this, visited](Block*) mutable -> Block* {
+		if (visited)
+		{
+			return nullptr;
+		}
+		visited = true;
+		return m_WriteBlock;
+	};
+	return make_unique<RecordCursor>(GetSchema(), nullptr, nextBlock, filter);
+}
+
+ResultSet BaseRecordManager::Materialize(RecordCursor& cursor, const Projection* projection)
+{
+	auto records = ResultSet(projection != nullptr ? projection->GetSchema() : GetSchema());
+	while (cursor.MoveNext())
+	{
+		cursor.CopyCurrent(records.Append(), projection);
+	}
+	m_LastQueryBlockReadAccessCount = cursor.GetReadBlocksCount();
+	return records;
+}
+
+void BaseRecordManager::ReadBlocks(unsigned long long firstBlockId, size_t count, span<unsigned char> destination)
+{
+	GetFile()->ReadBlocks(firstBlockId, count, destination);
+}
+
+size_t BaseRecordManager::GetMorselsCount()
+{
+	return (size_t)((GetBlocksCount() + MorselBlocks - 1) / MorselBlocks);
+}
+
+void BaseRecordManager::ParallelScan(RecordCursor::FilterFunction filter, MorselFunction visit)
+{
+	auto schema = GetSchema();
+	auto blocksCount = GetBlocksCount();
+	auto morselsCount = GetMorselsCount();
+	auto blockSize = GetFile()->GetBlockSize();
+	atomic<size_t> nextMorsel = 0;
+
+	auto scan = [&](Block* block) {
+		// One morsel is read with a single call into a buffer of the thread, its blocks are visited in place
+		auto buffer = vector<unsigned char>(MorselBlocks * blockSize);
+		for (auto morsel = nextMorsel++; morsel < morselsCount; morsel = nextMorsel++)
+		{
+			auto firstBlockId = morsel * MorselBlocks;
+			auto count = (size_t)min(MorselBlocks, blocksCount - firstBlockId);
+			ReadBlocks(firstBlockId, count, buffer);
+
+			size_t nextBlock = 0;
+			RecordCursor cursor(schema, nullptr, [&](Block*) -> Block* {
+				if (nextBlock == count)
+				{
+					return nullptr;
+				}
+				block->Attach(span<unsigned char>(buffer).subspan(nextBlock++ * blockSize, blockSize));
+				return block;
+			}, filter);
+			visit(morsel, firstBlockId, cursor);
+		}
+	};
+
+	auto threadsCount = min(m_ScanThreadsCount, morselsCount);
+	vector<unique_ptr<Block>> blocks;
+	for (size_t i = 0; i < max(threadsCount, (size_t)1); i++)
+	{
+		blocks.push_back(unique_ptr<Block>(GetFile()->CreateBlock()));
+	}
+
+	// The calling thread scans too
+	vector<future<void>> workers;
+	for (size_t i = 1; i < threadsCount; i++)
+	{
+		workers.push_back(async(launch::async, scan, blocks[i].get()));
+	}
+	scan(blocks[0].get());
+	for (auto& worker : workers)
+	{
+		worker.get();
+	}
+	m_LastQueryBlockReadAccessCount += blocksCount;
+}
+
+ResultSet BaseRecordManager::ParallelSelect(RecordCursor::FilterFunction filter, const Projection* projection)
+{
+	auto schema = projection != nullptr ? projection->GetSchema() : GetSchema();
+	auto records = ResultSet(schema);
+
+	// The write block comes first, as in OpenScanCursor
+	if (m_WriteBlock->GetRecordsCount() > 0)
+	{
+		auto cursor = OpenWriteBlockCursor(filter);
+		while (cursor->MoveNext())
+		{
+			cursor->CopyCurrent(records.Append(), projection);
+		}
+		m_LastQueryBlockReadAccessCount++;
+	}
+
+	// Morsels reach the result in block order. The thread scanning the first morsel not appended yet
+	// writes straight into the result, the others keep their records apart until their turn comes
+	mutex appendMutex;
+	size_t nextMorsel = 0;
+	map<size_t, ResultSet> pending;
+	ParallelScan(filter, [&](size_t morsel, unsigned long long, RecordCursor& cursor) {
+		bool inTurn;
+		{
+			lock_guard<mutex> lock(appendMutex);
+			inTurn = morsel == nextMorsel;
+		}
+
+		auto morselRecords = ResultSet(schema);
+		auto& target = inTurn ? records : morselRecords;
+		while (cursor.MoveNext())
+		{
+			cursor.CopyCurrent(target.Append(), projection);
+		}
+
+		lock_guard<mutex> lock(appendMutex);
+		if (inTurn)
+		{
+			nextMorsel++;
+		}
+		else
+		{
+			pending.emplace(morsel, move(morselRecords));
+		}
+		for (auto entry = pending.find(nextMorsel); entry != pending.end(); entry = pending.find(nextMorsel))
+		{
+			records.Append(move(entry->second));
+			pending.erase(entry);
+			nextMorsel++;
+		}
+	});
+	return records;
 }
\ No newline at end of file
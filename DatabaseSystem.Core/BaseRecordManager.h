@@ -4,15 +4,33 @@
 #include "Record.h"
 #include "File.h"
 #include "FileHead.h"
+#include "BufferPool.h"
+#include "PredicateKernels.h"
+#include "Predicate.h"
+#include "Aggregation.h"
+#include "RecordCursor.h"
+#include "ResultSet.h"
+#include "CsvLoader.h"
+#include "SecondaryIndex.h"
 
 class BaseRecordManager
 {
 public:
-	BaseRecordManager();
+	BaseRecordManager(size_t blockSize, BufferPool* bufferPool);
 	virtual void Create(string path, Schema* schema);
 	virtual void Open(string path);
 	virtual void Close();
 	Schema* GetSchema();
+	BufferPool* GetBufferPool();
+	// Selects positional I/O or memory mapping for the files of this manager, before Create/Open
+	virtual void SetFileAccessMode(FileAccessMode mode);
+	// Keeps written blocks dirty in the buffer pool until Checkpoint/Close (see FileWrapper::SetWriteBack)
+	virtual void SetWriteBack(bool enabled);
+	// Writes the dirty blocks and the file head of every file of this manager to disk
+	virtual void Checkpoint();
+	// Threads of the parallel scans run by the non-key selects and deletes, one per core by default
+	void SetScanThreadsCount(size_t threadsCount);
+	size_t GetScanThreadsCount() const;
 	unsigned long long GetSize();
 	unsigned long long GetLastQueryBlockReadAccessCount() const;
 	unsigned long long GetLastQueryBlockWriteAccessCount() const;
@@ -25,7 +43,17 @@ public:
 	/*
 	* Insero de um conjunto de registros.
 	*/
-	virtual void InsertMany(vector<Record> records);
+	virtual void InsertMany(const vector<Record>& records);
+	// Inserts records packed back to back (schema size bytes each), without building a Record per row
+	virtual void InsertMany(span<const unsigned char> records);
+	/*
+	* A bulk load gives its records to InsertMany in batches between these two calls, so an organization
+	* can leave work to the end of the load (the ordered file merges its sorted runs only once).
+	*/
+	virtual void BeginBulkInsert();
+	virtual void EndBulkInsert();
+	// Streams a CSV file into the manager through CsvLoader, returns the number of records inserted
+	unsigned long long InsertFromCsv(string path, unsigned long long lines = (unsigned long long)-1);
 	// ---------------------------------------------- </INSERT> --------------------------------------------------------------------------
 
 
@@ -43,21 +71,46 @@ public:
 	* em um conjunto de valores no necessariamente sequenciais.
 	*	Por exemplo, selecionar todos os registros dos ALUNOS cuja lista de DRE esto inscritos na TURMA de cdigo 1020.
 	*/
-	virtual vector<Record*> Select(vector<unsigned long long> ids);
+	virtual ResultSet Select(vector<unsigned long long> ids);
 	/*
 	* Seleo de um conjunto de registros (FindAll) cujas chave primria (ou campo UNIQUE) estejam contidas
 	* em uma faixa de valores dado como parmetro.
 	*	Por exemplo, todos os ALUNOS cujo DRE esteja na faixa entre "119nnnnnn" e "120nnnnnn"
 	*	(onde "n"  qualquer dgito de 0 a 9, ou em SQL: ... where DRE between 119000000 and 120999999
 	*/
-	virtual vector<Record*> SelectWhereBetween(unsigned int columnId, span<unsigned char> min, span<unsigned char> max);
+	virtual ResultSet SelectWhereBetween(unsigned int columnId, span<unsigned char> min, span<unsigned char> max, const Projection* projection = nullptr);
 	/*
 	* Seleo de todos os registros (FindAll) cujos valores de um campo no chave sejam iguais a um dado parmetro fornecido.
 	*	Ou seja, seleo por um campo que permite repetio de valores entre registros.
 	*	Por exemplo, recuperar todos os registros das PESSOAS cujo campo CIDADE seja igual a "Rio de Janeiro".
 	*/
-	virtual vector<Record*> SelectWhereEquals(unsigned int columnId, span<unsigned char> data);
+	virtual ResultSet SelectWhereEquals(unsigned int columnId, span<unsigned char> data, const Projection* projection = nullptr);
+	/*
+	* Selection of the records that satisfy a condition on any of the columns, such as "City = X AND Age > 30"
+	* (see Predicate). The whole condition is evaluated during a single scan.
+	* 
+	* These selects take an optional projection: only its columns are copied out of the blocks, and the
+	* result set has the projected schema (see Projection).
+	*/
+	virtual ResultSet SelectWhere(const Predicate& predicate, const Projection* projection = nullptr);
+	/*
+	* Aggregates (COUNT, SUM, MIN, MAX, AVG, with GROUP BY) of the records that satisfy the predicate, or of all
+	* of them, computed during the scan without copying any record (see Aggregation).
+	*/
+	ResultSet Aggregate(const Aggregation& aggregation, const Predicate* predicate = nullptr);
 	// ---------------------------------------------- </SELECT> --------------------------------------------------------------------------
+
+
+	// ---------------------------------------------- <CURSOR> --------------------------------------------------------------------------
+	/*
+	* Streaming versions of the selects: the records are read one block at a time as the cursor moves,
+	* and are seen through views into the block instead of being copied (see RecordCursor).
+	*/
+	virtual unique_ptr<RecordCursor> OpenCursor();
+	virtual unique_ptr<RecordCursor> OpenCursorWhereBetween(unsigned int columnId, span<unsigned char> min, span<unsigned char> max);
+	virtual unique_ptr<RecordCursor> OpenCursorWhereEquals(unsigned int columnId, span<unsigned char> data);
+	virtual unique_ptr<RecordCursor> OpenCursorWhere(const Predicate& predicate);
+	// ---------------------------------------------- </CURSOR> --------------------------------------------------------------------------
 	
 	
 	// ---------------------------------------------- <DELETE> --------------------------------------------------------------------------
@@ -71,8 +124,22 @@ public:
 	*	Por exemplo, remover todos os ALUNOS da tabela INSCRITOS cuja turma seja a de NUMERO=1023.
 	*/
 	virtual int DeleteWhereEquals(unsigned int columnId, span<unsigned char> data);
+	// Removal of the records that satisfy a condition on any of the columns (see Predicate)
+	virtual int DeleteWhere(const Predicate& predicate);
 	// ---------------------------------------------- </DELETE> --------------------------------------------------------------------------
 
+
+	// ---------------------------------------------- <INDEX> --------------------------------------------------------------------------
+	/*
+	* Secondary indexes (see SecondaryIndex) on any column, kept up to date by the inserts and deletes and
+	* reopened with the file. The selects with a condition on an indexed column (=, IN or a range) read the
+	* blocks of the matching records only, when they are few enough for that to beat a scan.
+	*/
+	void CreateIndex(unsigned int columnId);
+	void DropIndex(unsigned int columnId);
+	bool HasIndex(unsigned int columnId);
+	// ---------------------------------------------- </INDEX> --------------------------------------------------------------------------
+
 protected:
 	struct BaseRecord
 	{
@@ -81,26 +148,88 @@ protected:
 
 	Block* m_ReadBlock;
 	Block* m_WriteBlock;
+	BufferPool* m_BufferPool;
+	unique_ptr<BufferPool> m_OwnedBufferPool;
 	unsigned long long m_RecordsPerBlock;
 	unsigned long long m_NextReadBlockNumber;
 	unsigned long long m_LastQueryBlockReadAccessCount;
 	unsigned long long m_LastQueryBlockWriteAccessCount;
+	size_t m_ScanThreadsCount;
+	vector<unique_ptr<SecondaryIndex>> m_Indexes;
+	// Set when records were moved (reorganizations), the indexes are built again before their next use
+	bool m_IndexesOutdated;
+
+	// Consecutive blocks a scan thread takes at a time
+	static constexpr unsigned long long MorselBlocks = 64;
+	// Called from a scan thread with a cursor over the records of one morsel that pass the filter
+	using MorselFunction = function<void(size_t morsel, unsigned long long firstBlockId, RecordCursor& cursor)>;
 
 	virtual unsigned long long GetBlocksCount();
 	virtual bool ReadNextBlock();
-	virtual bool ReadBlock(Block* block, unsigned long long blockId);
+	virtual bool ReadBlock(Block* block, unsigned long long blockId, bool keepInPool = true);
 	virtual void WriteBlock(Block* block, unsigned long long blockId);
 	virtual void AddBlock(Block* block);
+	// Appends a copy of record to block with the given id
+	void AppendRecord(Block* block, span<const unsigned char> record, unsigned long long id);
 	
+	// Cursor over the write block (records not written yet) and then every block of the file, in order
+	unique_ptr<RecordCursor> OpenScanCursor(RecordCursor::FilterFunction filter);
+	// Cursor over the records of the write block alone
+	unique_ptr<RecordCursor> OpenWriteBlockCursor(RecordCursor::FilterFunction filter);
+	// Copies every record of the cursor (or its projected columns) into new records, the read blocks become the query access count
+	ResultSet Materialize(RecordCursor& cursor, const Projection* projection = nullptr);
+	// Copies count consecutive blocks of the file into destination, called from several threads at once
+	virtual void ReadBlocks(unsigned long long firstBlockId, size_t count, span<unsigned char> destination);
+	size_t GetMorselsCount();
+	/*
+	* Splits the blocks of the file (not the write block) in morsels of MorselBlocks blocks and scans them
+	* on the scan threads, each thread taking the next morsel left until there is none. visit runs on the
+	* thread that read the morsel and gets its index, so results can be kept per morsel and merged in block order.
+	* Every block is read once and added to the query access count.
+	*/
+	void ParallelScan(RecordCursor::FilterFunction filter, MorselFunction visit);
+	// Same records, in the same order, as Materialize(*OpenScanCursor(filter)), with the file scanned by ParallelScan
+	ResultSet ParallelSelect(RecordCursor::FilterFunction filter, const Projection* projection = nullptr);
 	bool TryGetNextValidRecord(Record* record);
 	void MoveToStart();
 	bool MoveNext(Record* record, unsigned long long& accessedBlocks);
 	bool MoveNext(Record* record, unsigned long long& accessedBlocks, unsigned long long& blockId, unsigned long long& recordNumberInBlock);
 	
 	void ClearAccessCount();
+
+	// Called by the organizations with the position a record is written to and before a record is removed
+	void AddToIndexes(span<const unsigned char> record, unsigned long long blockId, unsigned long long recordNumberInBlock);
+	void AddToIndexes(Block* block, unsigned long long blockId, unsigned long long recordNumberInBlock);
+	void RemoveFromIndexes(span<const unsigned char> record);
+	// The records moved, the positions kept by the indexes are no longer valid
+	void InvalidateIndexes();
+	// For the organizations that close their files themselves, while the files are still open
+	void CloseIndexes();
+	// What Create and Open do once the file is there, for the organizations that create and open their files themselves
+	void InitializeCreatedFile(string path);
+	void InitializeOpenedFile(string path);
+
 	virtual FileHead* CreateNewFileHead(Schema* schema) = 0;
 	virtual FileWrapper<FileHead>* GetFile() = 0;
 	virtual void DeleteInternal(unsigned long long recordId, unsigned long long blockNumber, unsigned long long recordNumberInBlock) = 0;
 	virtual void Reorganize() = 0;
+
+private:
+	// A record found through an index, with a copy of it
+	struct IndexMatch
+	{
+		unsigned long long BlockId;
+		unsigned long long RecordNumberInBlock;
+		vector<unsigned char> Record;
+	};
+
+	void OpenIndexes(string path);
+	unique_ptr<SecondaryIndex> CreateIndexObject();
+	void RebuildIndexes();
+	/*
+	* The records that satisfy the predicate, found through an index on one of its columns, in block order.
+	* Returns false when no index applies or too many records would be read one block at a time.
+	*/
+	bool FindWithIndex(const Predicate& predicate, vector<IndexMatch>& matches);
 };
 
@@ -1,93 +1,147 @@
 #include "pch.h"
 #include "Block.h"
 
-Block::Block(unsigned int blockSize, unsigned int recordSize, unsigned int headerSize) : m_RecordSize(recordSize), m_HeaderSize(headerSize)
+Block::Block(unsigned int blockSize, unsigned int recordSize, unsigned int headerSize) :
+	m_RecordSize(recordSize),
+	m_HeaderSize(headerSize),
+	m_Capacity(0),
+	m_BlockData(blockSize),
+	m_Data(nullptr),
+	m_RecordsCount(0),
+	m_Position(0)
 {
-	m_CurrentLengthInBytes = sizeof(unsigned int) + headerSize;
-	m_BlockData.resize(blockSize);
+	if (recordSize == 0 || blockSize < sizeof(unsigned int) + headerSize)
+	{
+		throw runtime_error("Invalid block layout");
+	}
+	m_Capacity = (unsigned int)((blockSize - sizeof(unsigned int) - headerSize) / recordSize);
+	m_Data = m_BlockData.data();
 }
 
 void Block::Load(span<unsigned char> data)
 {
-	Clear();
-	memcpy(&m_BlockData[0], &data[0], data.size());
-
-	auto recordsCount = ((unsigned int*)data.data())[0];
-	data = span(m_BlockData).subspan(sizeof(recordsCount) + m_HeaderSize);
+	m_Data = m_BlockData.data();
+	memcpy(m_Data, data.data(), data.size());
+	Load();
+}
 
-	for (int i = 0; i < recordsCount; i++)
-	{
-		auto recordData = new span<unsigned char>(data.subspan(i * m_RecordSize, m_RecordSize));
-		m_Records.Insert(recordData);
-		m_CurrentLengthInBytes += m_RecordSize;
-		m_Records.Advance();
-	}
+void Block::Attach(span<unsigned char> data)
+{
+	m_Data = data.data();
+	Load();
 }
 
 void Block::Flush(span<unsigned char> data)
 {
-	auto recordsCount = GetRecordsCount();
-	((unsigned int*)m_BlockData.data())[0] = recordsCount;
-	memcpy(data.data(), m_BlockData.data(), m_BlockData.size());
+	Flush();
+	memcpy(data.data(), m_Data, m_BlockData.size());
 }
 
-void Block::Clear()
+span<unsigned char> Block::GetData()
 {
-	m_Records.MoveToStart();
-	while (m_Records.RightLength() > 0)
-	{
-		m_Records.Remove();
-	}
-	m_CurrentLengthInBytes = sizeof(unsigned int) + m_HeaderSize;
-	memset(m_BlockData.data(), 0, m_BlockData.size());
+	Detach();
+	return m_BlockData.GetSpan();
 }
 
-void Block::Append(span<unsigned char> data)
+void Block::Load()
 {
-	memcpy(&m_BlockData[m_CurrentLengthInBytes], &data[0], data.size());
+	// Nothing to build, records are addressed by offset.
+	// Clamp the count so a torn or zeroed block never yields slots past the end
+	auto recordsCount = ((unsigned int*)m_Data)[0];
+	m_RecordsCount = min(recordsCount, m_Capacity);
+	m_Position = 0;
+}
 
-	auto recordData = new span<unsigned char>(&m_BlockData[m_CurrentLengthInBytes], m_RecordSize);
+void Block::Flush()
+{
+	Detach();
+	((unsigned int*)m_Data)[0] = m_RecordsCount;
+}
+
+void Block::Clear()
+{
+	m_RecordsCount = 0;
+	m_Position = 0;
+	m_Data = m_BlockData.data();
+	memset(m_Data, 0, m_BlockData.size());
+}
+
+void Block::Append(span<const unsigned char> data)
+{
+	if (m_RecordsCount == m_Capacity)
+	{
+		throw runtime_error("Block is full");
+	}
+	Detach();
 
-	m_Records.MoveToFinish();
-	m_Records.Insert(recordData);
-	m_CurrentLengthInBytes += m_RecordSize;
+	memcpy(GetRecordPointer(m_RecordsCount), data.data(), min((size_t)m_RecordSize, data.size()));
+	m_Position = m_RecordsCount;
+	m_RecordsCount++;
 }
 
 void Block::MoveToStart()
 {
-	m_Records.MoveToStart();
+	m_Position = 0;
 }
 
 void Block::MoveToEnd()
 {
-	m_Records.MoveToFinish();
+	m_Position = m_RecordsCount;
 }
 
 void Block::Retreat()
 {
-	m_Records.Retreat();
+	m_Position--;
 }
 
 void Block::Advance()
 {
-	m_Records.Advance();
+	m_Position++;
 }
 
 void Block::Remove()
 {
-	m_Records.Remove();
+	if (!IsPositionValid())
+	{
+		return;
+	}
+
+	// Keep the order of the remaining records
+	Detach();
+	auto next = m_Position + 1;
+	if (next < (int)m_RecordsCount)
+	{
+		memmove(GetRecordPointer(m_Position), GetRecordPointer(next), (size_t)(m_RecordsCount - next) * m_RecordSize);
+	}
+	m_RecordsCount--;
+	memset(GetRecordPointer(m_RecordsCount), 0, m_RecordSize);
 }
 
 unsigned int Block::GetRecordsCount()
 {
-	return (unsigned int)(m_Records.LeftLength() + m_Records.RightLength());
+	return m_RecordsCount;
+}
+
+unsigned int Block::GetCapacity()
+{
+	return m_Capacity;
+}
+
+unsigned int Block::GetRecordSize()
+{
+	return m_RecordSize;
+}
+
+span<const unsigned char> Block::GetRecords()
+{
+	return span<const unsigned char>(GetRecordPointer(0), (size_t)m_RecordsCount * m_RecordSize);
 }
 
 bool Block::GetRecord(vector<unsigned char>* record)
 {
-	if (m_Records.RightLength() > 0) {
-		memcpy(record->data(), m_Records.Current(0)->data(), record->size());
-		m_Records.Advance();
+	if (IsPositionValid()) {
+		memcpy(record->data(), GetRecordPointer(m_Position), record->size());
+		m_Position++;
 		return true;
 	}
 	return false;
@@ -95,7 +149,7 @@ bool Block::GetRecord(vector<unsigned char>* record)
 
 int Block::GetPosition()
 {
-	return m_Records.LeftLength();
+	return m_Position;
 }
 
 bool Block::GetRecordSpan(unsigned long long recordNumberInBlock, span<unsigned char>* record)
@@ -105,19 +159,17 @@ bool Block::GetRecordSpan(unsigned long long recordNumberInBlock, span<unsigned
 		return false;
 	}
 
-	m_Records.MoveToStart();
-	//auto currentPosition = m_Records.LeftLength();
-	//auto peekPosition = recordNumberInBlock - currentPosition;
-	*record = *m_Records.Current(recordNumberInBlock);
+	Detach();
+	*record = span<unsigned char>(GetRecordPointer(recordNumberInBlock), m_RecordSize);
 	return true;
 }
 
 bool Block::GetRecordBack(vector<unsigned char>* record)
 {
-	if (m_Records.LeftLength() >= 0 && m_Records.LeftLength() < GetRecordsCount())
+	if (IsPositionValid())
 	{
-		memcpy(record->data(), m_Records.Current(0)->data(), record->size());
-		m_Records.Retreat();
+		memcpy(record->data(), GetRecordPointer(m_Position), record->size());
+		m_Position--;
 		return true;
 	}
 	return false;
@@ -125,12 +177,13 @@ bool Block::GetRecordBack(vector<unsigned char>* record)
 
 bool Block::GetCurrentSpan(span<unsigned char>* record)
 {
-	if (GetRecordsCount() == 0)
+	if (!IsPositionValid())
 	{
 		return false;
 	}
 
-	*record = *m_Records.Current(0);
+	Detach();
+	*record = span<unsigned char>(GetRecordPointer(m_Position), m_RecordSize);
 	return true;
 }
 
@@ -141,46 +194,114 @@ bool Block::RemoveRecordAt(unsigned long long recordNumber)
 		return false;
 	}
 
-	m_Records.MoveToStart();
-	//auto currentPosition = m_Records.LeftLength();
-	//auto peekPosition = recordNumber - currentPosition;
-	auto record = m_Records.Current(recordNumber);
-
-	if (recordNumber == GetRecordsCount() - 1)
-	{
-		// Last record in block
-		// Clear (maybe not needed)
-		memset(record->data(), 0, record->size());
-		m_Records.MoveToFinish();
-		m_Records.Remove();
-	}
-	else
+	Detach();
+	auto last = m_RecordsCount - 1;
+	if (recordNumber != last)
 	{
 		// Not the last one
 		// Swap the last with the one to remove
-		m_Records.MoveToFinish();
-		auto last = m_Records.Current(0);
-		memcpy(record->data(), last->data(), record->size());
-		m_Records.Remove();
+		memcpy(GetRecordPointer(recordNumber), GetRecordPointer(last), m_RecordSize);
+	}
+	memset(GetRecordPointer(last), 0, m_RecordSize);
+	m_RecordsCount--;
+
+	if (m_Position > (int)m_RecordsCount)
+	{
+		m_Position = m_RecordsCount;
 	}
 	return true;
 }
 
+void Block::Insert(unsigned int recordNumber, span<const unsigned char> data)
+{
+	if (m_RecordsCount == m_Capacity)
+	{
+		throw runtime_error("Block is full");
+	}
+	if (recordNumber > m_RecordsCount)
+	{
+		throw runtime_error("Invalid record number");
+	}
+
+	Detach();
+	memmove(GetRecordPointer(recordNumber + 1), GetRecordPointer(recordNumber), (size_t)(m_RecordsCount - recordNumber) * m_RecordSize);
+	memcpy(GetRecordPointer(recordNumber), data.data(), min((size_t)m_RecordSize, data.size()));
+	m_RecordsCount++;
+}
+
+void Block::Remove(unsigned int recordNumber)
+{
+	if (recordNumber >= m_RecordsCount)
+	{
+		return;
+	}
+
+	Detach();
+	memmove(GetRecordPointer(recordNumber), GetRecordPointer(recordNumber + 1), (size_t)(m_RecordsCount - recordNumber - 1) * m_RecordSize);
+	m_RecordsCount--;
+	memset(GetRecordPointer(m_RecordsCount), 0, m_RecordSize);
+}
+
+void Block::Truncate(unsigned int recordsCount)
+{
+	if (recordsCount >= m_RecordsCount)
+	{
+		return;
+	}
+
+	Detach();
+	memset(GetRecordPointer(recordsCount), 0, (size_t)(m_RecordsCount - recordsCount) * m_RecordSize);
+	m_RecordsCount = recordsCount;
+	if (m_Position > (int)m_RecordsCount)
+	{
+		m_Position = m_RecordsCount;
+	}
+}
+
 bool Block::MoveToAndGetRecord(unsigned int recordNumberInBlock, vector<unsigned char>* record)
 {
-	MoveToStart();
-	auto size = m_Records.LeftLength() + m_Records.RightLength();
-	if (recordNumberInBlock <= GetRecordsCount())
+	if (recordNumberInBlock < GetRecordsCount())
 	{
-		for (int i = 0; i < recordNumberInBlock; i++) {
-			m_Records.Advance();
-		}
-		memcpy(record->data(), m_Records.Current(0)->data(), record->size());
+		m_Position = recordNumberInBlock;
+		memcpy(record->data(), GetRecordPointer(m_Position), record->size());
 		return true;
 	}
+	MoveToStart();
 	return false;
 }
 
 span<unsigned char> Block::GetHeader() {
-	return span(m_BlockData).subspan(sizeof(unsigned int), m_HeaderSize);
-}
\ No newline at end of file
+	Detach();
+	return m_BlockData.GetSpan().subspan(GetHeaderOffset(), m_HeaderSize);
+}
+
+size_t Block::GetHeaderOffset()
+{
+	// The records count comes first
+	return sizeof(unsigned int);
+}
+
+size_t Block::GetRecordOffset(unsigned long long recordNumber)
+{
+	return GetHeaderOffset() + m_HeaderSize + recordNumber * m_RecordSize;
+}
+
+unsigned char* Block::GetRecordPointer(unsigned long long recordNumber)
+{
+	return m_Data + GetRecordOffset(recordNumber);
+}
+
+bool Block::IsPositionValid()
+{
+	return m_Position >= 0 && m_Position < (int)m_RecordsCount;
+}
+
+void Block::Detach()
+{
+	if (m_Data == m_BlockData.data())
+	{
+		return;
+	}
+	memcpy(m_BlockData.data(), m_Data, m_BlockData.size());
+	m_Data = m_BlockData.data();
+}
@@ -1,17 +1,34 @@
 #pragma once
 
-#include "DoubleList.h"
+#include "AlignedBuffer.h"
 
+/*
+	Block layout: [records count (unsigned int)][header (m_HeaderSize bytes)][record 0][record 1]...
+	Records are fixed size, so record n lives at GetRecordOffset(n) and every slot access is O(1).
+	The block keeps a cursor (m_Position) used by the sequential Get/Advance/Retreat operations.
+	A block can also be attached to bytes it does not own (a memory mapped file). Reads go straight to
+	those bytes; the first change copies them into the block's own buffer, so the file is only ever
+	modified through FileWrapper::WriteBlock.
+*/
 class Block
 {
 public:
 	Block(unsigned int blockSize, unsigned int recordSize, unsigned int headerSize);
 
 	void Load(span<unsigned char> data);
+	// Reads the records in place from data, that must outlive the attachment
+	void Attach(span<unsigned char> data);
 	void Flush(span<unsigned char> data);
 
+	// Raw block bytes, so the file can read into / write from them without an intermediate buffer
+	span<unsigned char> GetData();
+	// Rebuilds the records from bytes already read into GetData()
+	void Load();
+	// Stores the records count into GetData() so it can be written as is
+	void Flush();
+
 	void Clear();
-	void Append(span<unsigned char> data);
+	void Append(span<const unsigned char> data);
 
 	void MoveToStart();
 	void MoveToEnd();
@@ -22,18 +39,38 @@ public:
 	bool MoveToAndGetRecord(unsigned int recordNumberInBlock, vector<unsigned char> *record);
 
 	unsigned int GetRecordsCount();
+	unsigned int GetCapacity();
+	unsigned int GetRecordSize();
+	// The bytes of all the records, back to back, for the predicate kernels. Read only, the block is not detached
+	span<const unsigned char> GetRecords();
 	bool GetRecord(vector<unsigned char>* record);
 
 	span<unsigned char> GetHeader();
+	// Where the header starts in the bytes of a block, for the callers that change it in place in a cached page
+	static size_t GetHeaderOffset();
 
 	bool GetRecordSpan(unsigned long long recordNumberInBlock, span<unsigned char>* record);
 	bool GetCurrentSpan(span<unsigned char>* record);
 	int GetPosition();
 	bool RemoveRecordAt(unsigned long long recordNumber);
+	// Sorted blocks: these keep the order of the records, shifting the ones after recordNumber
+	void Insert(unsigned int recordNumber, span<const unsigned char> data);
+	void Remove(unsigned int recordNumber);
+	// Drops the records from recordsCount on
+	void Truncate(unsigned int recordsCount);
 private:
 	unsigned int m_RecordSize;
 	unsigned int m_HeaderSize;
-	vector<unsigned char> m_BlockData;
-	DoubleList<span<unsigned char>> m_Records;
-	size_t m_CurrentLengthInBytes;
+	unsigned int m_Capacity;
+	AlignedBuffer m_BlockData;
+	// Either m_BlockData or the attached bytes
+	unsigned char* m_Data;
+	unsigned int m_RecordsCount;
+	int m_Position;
+
+	size_t GetRecordOffset(unsigned long long recordNumber);
+	unsigned char* GetRecordPointer(unsigned long long recordNumber);
+	bool IsPositionValid();
+	// Copies attached bytes into m_BlockData before they are changed
+	void Detach();
 };
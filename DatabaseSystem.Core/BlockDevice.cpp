@@ -0,0 +1,357 @@
+#include "pch.h"
+#include "BlockDevice.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <winioctl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <climits>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+
+BlockDevice::BlockDevice() : m_Handle(INVALID_HANDLE_VALUE)
+{
+}
+
+BlockDevice::~BlockDevice()
+{
+	Close();
+}
+
+void BlockDevice::Open(string path, bool truncate)
+{
+	Close();
+	auto handle = CreateFileA(path.c_str(),
+		GENERIC_READ | GENERIC_WRITE,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr,
+		truncate ? CREATE_ALWAYS : OPEN_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL,
+		nullptr);
+	if (handle == INVALID_HANDLE_VALUE)
+	{
+		throw runtime_error("Could not open " + path);
+	}
+	m_Handle = handle;
+}
+
+void BlockDevice::Close()
+{
+	if (m_Handle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_Handle);
+		m_Handle = INVALID_HANDLE_VALUE;
+	}
+}
+
+bool BlockDevice::IsOpen() const
+{
+	return m_Handle != INVALID_HANDLE_VALUE;
+}
+
+size_t BlockDevice::ReadAt(unsigned long long offset, span<unsigned char> data)
+{
+	size_t total = 0;
+	while (total < data.size())
+	{
+		OVERLAPPED overlapped = {};
+		auto position = offset + total;
+		overlapped.Offset = (DWORD)(position & 0xFFFFFFFF);
+		overlapped.OffsetHigh = (DWORD)(position >> 32);
+
+		DWORD read = 0;
+		if (!ReadFile(m_Handle, data.data() + total, (DWORD)(data.size() - total), &read, &overlapped))
+		{
+			if (GetLastError() == ERROR_HANDLE_EOF)
+			{
+				break;
+			}
+			throw runtime_error("Block read failed");
+		}
+		if (read == 0)
+		{
+			break;
+		}
+		total += read;
+	}
+	return total;
+}
+
+void BlockDevice::WriteAt(unsigned long long offset, span<const unsigned char> data)
+{
+	size_t total = 0;
+	while (total < data.size())
+	{
+		OVERLAPPED overlapped = {};
+		auto position = offset + total;
+		overlapped.Offset = (DWORD)(position & 0xFFFFFFFF);
+		overlapped.OffsetHigh = (DWORD)(position >> 32);
+
+		DWORD written = 0;
+		if (!WriteFile(m_Handle, data.data() + total, (DWORD)(data.size() - total), &written, &overlapped))
+		{
+			throw runtime_error("Block write failed");
+		}
+		total += written;
+	}
+}
+
+void BlockDevice::WriteAt(unsigned long long offset, const vector<span<const unsigned char>>& buffers)
+{
+	// WriteFileGather only takes page sized buffers of an unbuffered handle,
+	// so stage the run in one contiguous buffer and issue a single write
+	size_t size = 0;
+	for (auto& buffer : buffers)
+	{
+		size += buffer.size();
+	}
+
+	vector<unsigned char> staging(size);
+	size_t position = 0;
+	for (auto& buffer : buffers)
+	{
+		memcpy(staging.data() + position, buffer.data(), buffer.size());
+		position += buffer.size();
+	}
+	WriteAt(offset, span<const unsigned char>(staging));
+}
+
+void BlockDevice::Sync()
+{
+	if (!FlushFileBuffers(m_Handle))
+	{
+		throw runtime_error("Sync failed");
+	}
+}
+
+void BlockDevice::AdviseSequential(bool sequential)
+{
+	// Windows only takes the hint (FILE_FLAG_SEQUENTIAL_SCAN) when the file is opened,
+	// the large reads issued by the scans already do the work
+}
+
+unsigned long long BlockDevice::GetSize() const
+{
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_Handle, &size))
+	{
+		throw runtime_error("Could not get the file size");
+	}
+	return size.QuadPart;
+}
+
+unsigned long long BlockDevice::GetAllocatedSize() const
+{
+	FILE_STANDARD_INFO info;
+	if (!GetFileInformationByHandleEx(m_Handle, FileStandardInfo, &info, sizeof(info)))
+	{
+		throw runtime_error("Could not get the file size");
+	}
+	return info.AllocationSize.QuadPart;
+}
+
+void BlockDevice::Truncate(unsigned long long size)
+{
+	FILE_END_OF_FILE_INFO info;
+	info.EndOfFile.QuadPart = size;
+	if (!SetFileInformationByHandle(m_Handle, FileEndOfFileInfo, &info, sizeof(info)))
+	{
+		throw runtime_error("Could not truncate the file");
+	}
+}
+
+bool BlockDevice::PunchHole(unsigned long long offset, unsigned long long length)
+{
+	// Zeroing a range only deallocates it once the file is marked sparse
+	DWORD returned = 0;
+	if (!DeviceIoControl(m_Handle, FSCTL_SET_SPARSE, nullptr, 0, nullptr, 0, &returned, nullptr))
+	{
+		return false;
+	}
+
+	FILE_ZERO_DATA_INFORMATION range;
+	range.FileOffset.QuadPart = offset;
+	range.BeyondFinalZero.QuadPart = offset + length;
+	return DeviceIoControl(m_Handle, FSCTL_SET_ZERO_DATA, &range, sizeof(range), nullptr, 0, &returned, nullptr) != 0;
+}
+
+#else
+
+BlockDevice::BlockDevice() : m_Descriptor(-1)
+{
+}
+
+BlockDevice::~BlockDevice()
+{
+	Close();
+}
+
+void BlockDevice::Open(string path, bool truncate)
+{
+	Close();
+	auto flags = O_RDWR | O_CREAT | (truncate ? O_TRUNC : 0);
+	auto descriptor = open(path.c_str(), flags, 0644);
+	if (descriptor < 0)
+	{
+		throw runtime_error("Could not open " + path);
+	}
+	m_Descriptor = descriptor;
+}
+
+void BlockDevice::Close()
+{
+	if (m_Descriptor >= 0)
+	{
+		close(m_Descriptor);
+		m_Descriptor = -1;
+	}
+}
+
+bool BlockDevice::IsOpen() const
+{
+	return m_Descriptor >= 0;
+}
+
+size_t BlockDevice::ReadAt(unsigned long long offset, span<unsigned char> data)
+{
+	size_t total = 0;
+	while (total < data.size())
+	{
+		auto read = pread(m_Descriptor, data.data() + total, data.size() - total, (off_t)(offset + total));
+		if (read < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			throw runtime_error("Block read failed");
+		}
+		if (read == 0)
+		{
+			break;
+		}
+		total += read;
+	}
+	return total;
+}
+
+void BlockDevice::WriteAt(unsigned long long offset, span<const unsigned char> data)
+{
+	size_t total = 0;
+	while (total < data.size())
+	{
+		auto written = pwrite(m_Descriptor, data.data() + total, data.size() - total, (off_t)(offset + total));
+		if (written < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			throw runtime_error("Block write failed");
+		}
+		total += written;
+	}
+}
+
+void BlockDevice::WriteAt(unsigned long long offset, const vector<span<const unsigned char>>& buffers)
+{
+	size_t current = 0;
+	size_t currentOffset = 0;
+	while (current < buffers.size())
+	{
+		vector<iovec> vectors;
+		for (auto i = current; i < buffers.size() && vectors.size() < IOV_MAX; i++)
+		{
+			auto skip = i == current ? currentOffset : 0;
+			vectors.push_back(iovec{ (void*)(buffers[i].data() + skip), buffers[i].size() - skip });
+		}
+
+		auto written = pwritev(m_Descriptor, vectors.data(), (int)vectors.size(), (off_t)offset);
+		if (written < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			throw runtime_error("Block write failed");
+		}
+		offset += written;
+
+		// Skip what was written, a short write can stop in the middle of a buffer
+		auto remaining = (size_t)written;
+		while (current < buffers.size() && remaining >= buffers[current].size() - currentOffset)
+		{
+			remaining -= buffers[current].size() - currentOffset;
+			currentOffset = 0;
+			current++;
+		}
+		currentOffset += remaining;
+	}
+}
+
+void BlockDevice::Sync()
+{
+	if (fsync(m_Descriptor) != 0)
+	{
+		throw runtime_error("Sync failed");
+	}
+}
+
+void BlockDevice::AdviseSequential(bool sequential)
+{
+#ifdef POSIX_FADV_SEQUENTIAL
+	// Only a hint, failures are ignored
+	posix_fadvise(m_Descriptor, 0, 0, sequential ? POSIX_FADV_SEQUENTIAL : POSIX_FADV_NORMAL);
+#endif
+}
+
+unsigned long long BlockDevice::GetSize() const
+{
+	struct stat status;
+	if (fstat(m_Descriptor, &status) != 0)
+	{
+		throw runtime_error("Could not get the file size");
+	}
+	return status.st_size;
+}
+
+unsigned long long BlockDevice::GetAllocatedSize() const
+{
+	struct stat status;
+	if (fstat(m_Descriptor, &status) != 0)
+	{
+		throw runtime_error("Could not get the file size");
+	}
+	// st_blocks is always counted in 512 bytes units
+	return (unsigned long long)status.st_blocks * 512;
+}
+
+void BlockDevice::Truncate(unsigned long long size)
+{
+	while (ftruncate(m_Descriptor, (off_t)size) != 0)
+	{
+		if (errno != EINTR)
+		{
+			throw runtime_error("Could not truncate the file");
+		}
+	}
+}
+
+bool BlockDevice::PunchHole(unsigned long long offset, unsigned long long length)
+{
+#ifdef FALLOC_FL_PUNCH_HOLE
+	// Keep the size, only the blocks of the range are freed
+	return fallocate(m_Descriptor, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t)offset, (off_t)length) == 0;
+#else
+	return false;
+#endif
+}
+
+#endif
@@ -0,0 +1,46 @@
+#pragma once
+
+/*
+	Thin wrapper over the OS file handle doing positional reads and writes
+	(pread/pwrite, or ReadFile/WriteFile with an offset on Windows).
+	There is no user space buffering: the bytes go straight to and from the caller memory.
+*/
+class BlockDevice
+{
+public:
+	BlockDevice();
+	~BlockDevice();
+
+	BlockDevice(const BlockDevice&) = delete;
+	BlockDevice& operator=(const BlockDevice&) = delete;
+
+	void Open(string path, bool truncate = false);
+	void Close();
+	bool IsOpen() const;
+
+	// Returns the number of bytes read, less than data.size() when reading past the end of the file
+	size_t ReadAt(unsigned long long offset, span<unsigned char> data);
+	void WriteAt(unsigned long long offset, span<const unsigned char> data);
+	// Writes the buffers back to back starting at offset with as few calls as possible
+	void WriteAt(unsigned long long offset, const vector<span<const unsigned char>>& buffers);
+	// Forces the written bytes to stable storage
+	void Sync();
+	// Tells the OS whether the file is being read sequentially, so it can adjust its own read-ahead
+	void AdviseSequential(bool sequential);
+
+	unsigned long long GetSize() const;
+	// Bytes the file really takes on disk, less than GetSize() when it has holes
+	unsigned long long GetAllocatedSize() const;
+	// Cuts (or extends with zeros) the file to size bytes
+	void Truncate(unsigned long long size);
+	// Gives the disk space of the range back to the file system, the range then reads as zeros.
+	// Returns false when the file system does not support it, the bytes are left untouched then
+	bool PunchHole(unsigned long long offset, unsigned long long length);
+
+private:
+#ifdef _WIN32
+	void* m_Handle;
+#else
+	int m_Descriptor;
+#endif
+};
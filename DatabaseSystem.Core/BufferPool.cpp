@@ -0,0 +1,347 @@
+#include "pch.h"
+#include "BufferPool.h"
+
+BufferPool::BufferPool(size_t framesCount, size_t frameSize) :
+	m_FrameSize(frameSize),
+	m_FramesData(framesCount * frameSize),
+	m_NextFileId(0),
+	m_ClockHand(0),
+	m_DirtyFramesCount(0),
+	m_DirtyFramesThreshold(max(framesCount / 2, (size_t)1)),
+	m_HitsCount(0),
+	m_MissesCount(0)
+{
+	if (framesCount == 0)
+	{
+		throw runtime_error("Buffer pool needs at least one frame");
+	}
+
+	m_Frames.resize(framesCount);
+	for (auto& frame : m_Frames)
+	{
+		frame.PinCount = 0;
+		frame.Dirty = false;
+		frame.Referenced = false;
+		frame.Valid = false;
+	}
+}
+
+unsigned int BufferPool::RegisterFile(WriteBackFunction writeBack)
+{
+	lock_guard<recursive_mutex> lock(m_Mutex);
+	unsigned int fileId;
+	if (!m_FreeFileIds.empty())
+	{
+		fileId = m_FreeFileIds.back();
+		m_FreeFileIds.pop_back();
+	}
+	else if (m_NextFileId < MaxFilesCount)
+	{
+		fileId = m_NextFileId++;
+	}
+	else
+	{
+		throw runtime_error("Buffer pool has no file id left");
+	}
+	m_Files[fileId] = writeBack;
+	return fileId;
+}
+
+void BufferPool::UnregisterFile(unsigned int fileId)
+{
+	lock_guard<recursive_mutex> lock(m_Mutex);
+	Flush(fileId);
+	Discard(fileId);
+	// Its frames are gone, the id can be given to the next file
+	if (m_Files.erase(fileId) > 0)
+	{
+		m_FreeFileIds.push_back(fileId);
+	}
+}
+
+span<unsigned char> BufferPool::Pin(unsigned int fileId, unsigned long long blockId, const ReadFunction& read)
+{
+	lock_guard<recursive_mutex> lock(m_Mutex);
+	return PinInternal(fileId, blockId, &read);
+}
+
+span<unsigned char> BufferPool::PinForOverwrite(unsigned int fileId, unsigned long long blockId)
+{
+	lock_guard<recursive_mutex> lock(m_Mutex);
+	return PinInternal(fileId, blockId, nullptr);
+}
+
+bool BufferPool::TryPin(unsigned int fileId, unsigned long long blockId, span<unsigned char>* data)
+{
+	lock_guard<recursive_mutex> lock(m_Mutex);
+	auto entry = m_PageTable.find(MakeKey(fileId, blockId));
+	if (entry == m_PageTable.end())
+	{
+		return false;
+	}
+
+	m_HitsCount++;
+	auto& frame = m_Frames[entry->second];
+	frame.PinCount++;
+	frame.Referenced = true;
+	*data = GetFrameData(entry->second);
+	return true;
+}
+
+void BufferPool::Unpin(unsigned int fileId, unsigned long long blockId, bool dirty)
+{
+	lock_guard<recursive_mutex> lock(m_Mutex);
+	auto entry = m_PageTable.find(MakeKey(fileId, blockId));
+	if (entry == m_PageTable.end())
+	{
+		throw runtime_error("Unpin of a block that is not in the buffer pool");
+	}
+
+	auto& frame = m_Frames[entry->second];
+	if (frame.PinCount == 0)
+	{
+		throw runtime_error("Unpin of a block that is not pinned");
+	}
+	frame.PinCount--;
+	if (dirty && !frame.Dirty)
+	{
+		frame.Dirty = true;
+		m_DirtyFramesCount++;
+		if (m_DirtyFramesCount >= m_DirtyFramesThreshold)
+		{
+			FlushAll();
+		}
+	}
+}
+
+void BufferPool::Flush(unsigned int fileId)
+{
+	lock_guard<recursive_mutex> lock(m_Mutex);
+	vector<size_t> dirtyFrames;
+	for (size_t i = 0; i < m_Frames.size(); i++)
+	{
+		auto& frame = m_Frames[i];
+		if (frame.Valid && frame.Dirty && frame.FileId == fileId)
+		{
+			dirtyFrames.push_back(i);
+		}
+	}
+	if (dirtyFrames.empty())
+	{
+		return;
+	}
+
+	auto file = m_Files.find(fileId);
+	if (file == m_Files.end())
+	{
+		throw runtime_error("Dirty block of an unregistered file");
+	}
+
+	sort(dirtyFrames.begin(), dirtyFrames.end(), [this](size_t a, size_t b) {
+		return m_Frames[a].BlockId < m_Frames[b].BlockId;
+	});
+
+	// Write each run of adjacent blocks at once
+	size_t runStart = 0;
+	while (runStart < dirtyFrames.size())
+	{
+		auto firstBlockId = m_Frames[dirtyFrames[runStart]].BlockId;
+		vector<span<const unsigned char>> run;
+		auto runEnd = runStart;
+		while (runEnd < dirtyFrames.size() && m_Frames[dirtyFrames[runEnd]].BlockId == firstBlockId + (runEnd - runStart))
+		{
+			run.push_back(GetFrameData(dirtyFrames[runEnd]));
+			runEnd++;
+		}
+
+		file->second(firstBlockId, run);
+		for (auto i = runStart; i < runEnd; i++)
+		{
+			MarkClean(m_Frames[dirtyFrames[i]]);
+		}
+		runStart = runEnd;
+	}
+}
+
+void BufferPool::FlushAll()
+{
+	lock_guard<recursive_mutex> lock(m_Mutex);
+	for (auto& file : m_Files)
+	{
+		Flush(file.first);
+	}
+}
+
+void BufferPool::SetDirtyFramesThreshold(size_t threshold)
+{
+	lock_guard<recursive_mutex> lock(m_Mutex);
+	m_DirtyFramesThreshold = max(threshold, (size_t)1);
+}
+
+size_t BufferPool::GetDirtyFramesThreshold() const
+{
+	return m_DirtyFramesThreshold;
+}
+
+size_t BufferPool::GetDirtyFramesCount() const
+{
+	lock_guard<recursive_mutex> lock(m_Mutex);
+	return m_DirtyFramesCount;
+}
+
+void BufferPool::Discard(unsigned int fileId, unsigned long long firstBlockId)
+{
+	lock_guard<recursive_mutex> lock(m_Mutex);
+	for (auto& frame : m_Frames)
+	{
+		if (!frame.Valid || frame.FileId != fileId || frame.BlockId < firstBlockId)
+		{
+			continue;
+		}
+
+		if (frame.PinCount > 0)
+		{
+			throw runtime_error("Discard of a pinned block");
+		}
+		m_PageTable.erase(MakeKey(frame.FileId, frame.BlockId));
+		MarkClean(frame);
+		frame.Valid = false;
+		frame.Referenced = false;
+	}
+}
+
+void BufferPool::DiscardBlock(unsigned int fileId, unsigned long long blockId)
+{
+	lock_guard<recursive_mutex> lock(m_Mutex);
+	auto entry = m_PageTable.find(MakeKey(fileId, blockId));
+	if (entry == m_PageTable.end())
+	{
+		return;
+	}
+
+	auto& frame = m_Frames[entry->second];
+	if (frame.PinCount > 0)
+	{
+		throw runtime_error("Discard of a pinned block");
+	}
+	m_PageTable.erase(entry);
+	MarkClean(frame);
+	frame.Valid = false;
+	frame.Referenced = false;
+}
+
+size_t BufferPool::GetFramesCount() const
+{
+	return m_Frames.size();
+}
+
+size_t BufferPool::GetFrameSize() const
+{
+	return m_FrameSize;
+}
+
+unsigned long long BufferPool::GetHitsCount() const
+{
+	lock_guard<recursive_mutex> lock(m_Mutex);
+	return m_HitsCount;
+}
+
+unsigned long long BufferPool::GetMissesCount() const
+{
+	lock_guard<recursive_mutex> lock(m_Mutex);
+	return m_MissesCount;
+}
+
+unsigned long long BufferPool::MakeKey(unsigned int fileId, unsigned long long blockId)
+{
+	// 16 bits for the file and 48 bits for the block, RegisterFile never gives an id past MaxFilesCount
+	return ((unsigned long long)fileId << 48) | (blockId & 0xFFFFFFFFFFFFull);
+}
+
+span<unsigned char> BufferPool::GetFrameData(size_t frameIndex)
+{
+	return m_FramesData.GetSpan().subspan(frameIndex * m_FrameSize, m_FrameSize);
+}
+
+size_t BufferPool::FindVictim()
+{
+	// CLOCK: sweep the frames giving a second chance to the referenced ones.
+	// Two full sweeps are enough to clear every reference bit, so if nothing
+	// was found by then all frames are pinned.
+	for (size_t step = 0; step < 2 * m_Frames.size(); step++)
+	{
+		auto frameIndex = m_ClockHand;
+		m_ClockHand = (m_ClockHand + 1) % m_Frames.size();
+
+		auto& frame = m_Frames[frameIndex];
+		if (!frame.Valid)
+		{
+			return frameIndex;
+		}
+		if (frame.PinCount > 0)
+		{
+			continue;
+		}
+		if (frame.Referenced)
+		{
+			frame.Referenced = false;
+			continue;
+		}
+		return frameIndex;
+	}
+	throw runtime_error("All buffer pool frames are pinned");
+}
+
+void BufferPool::MarkClean(Frame& frame)
+{
+	if (frame.Dirty)
+	{
+		frame.Dirty = false;
+		m_DirtyFramesCount--;
+	}
+}
+
+span<unsigned char> BufferPool::PinInternal(unsigned int fileId, unsigned long long blockId, const ReadFunction* read)
+{
+	span<unsigned char> cached;
+	if (TryPin(fileId, blockId, &cached))
+	{
+		return cached;
+	}
+
+	m_MissesCount++;
+	auto frameIndex = FindVictim();
+	auto& frame = m_Frames[frameIndex];
+	if (frame.Valid)
+	{
+		if (frame.Dirty)
+		{
+			// Take the neighbours along, they would be written one by one otherwise
+			Flush(frame.FileId);
+		}
+		m_PageTable.erase(MakeKey(frame.FileId, frame.BlockId));
+	}
+
+	auto data = GetFrameData(frameIndex);
+	if (read != nullptr)
+	{
+		try
+		{
+			(*read)(blockId, data);
+		}
+		catch (...)
+		{
+			frame.Valid = false;
+			throw;
+		}
+	}
+
+	frame.FileId = fileId;
+	frame.BlockId = blockId;
+	frame.PinCount = 1;
+	frame.Dirty = false;
+	frame.Referenced = true;
+	frame.Valid = true;
+	m_PageTable[MakeKey(fileId, blockId)] = frameIndex;
+	return data;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <functional>
+#include <algorithm>
+#include <unordered_map>
+#include <mutex>
+#include "AlignedBuffer.h"
+
+/*
+	Shared pool of in-memory block frames.
+	Every FileWrapper registers itself and routes its block traffic through the pool, so
+	blocks that are accessed again (bucket heads, binary search pivots, ...) are served from RAM.
+	Frames are replaced with the CLOCK (second chance) algorithm; pinned frames are never evicted
+	and dirty frames are written back through the owning file before being reused.
+	Dirty blocks of a file are always written back together, sorted and grouped in runs of
+	adjacent blocks, so a run reaches the disk in a single call. That happens on Flush, when a
+	dirty frame has to be evicted, or when the number of dirty frames reaches the threshold.
+	The pool can be used from several threads at once, every call holds the pool lock.
+*/
+class BufferPool
+{
+public:
+	typedef function<void(unsigned long long blockId, span<unsigned char> data)> ReadFunction;
+	// Writes blocks firstBlockId, firstBlockId + 1, ... from the given frames
+	typedef function<void(unsigned long long firstBlockId, const vector<span<const unsigned char>>& blocks)> WriteBackFunction;
+
+	static constexpr size_t DefaultFramesCount = 256;
+	// Id of a file that is not registered, never given by RegisterFile
+	static constexpr unsigned int InvalidFileId = (unsigned int)-1;
+
+	BufferPool(size_t framesCount, size_t frameSize);
+
+	unsigned int RegisterFile(WriteBackFunction writeBack);
+	void UnregisterFile(unsigned int fileId);
+
+	// Pins the frame holding the block, reading it through `read` on a miss
+	span<unsigned char> Pin(unsigned int fileId, unsigned long long blockId, const ReadFunction& read);
+	// Pins a frame for a block that is going to be fully overwritten, no read is done on a miss
+	span<unsigned char> PinForOverwrite(unsigned int fileId, unsigned long long blockId);
+	// Pins the block only if it is already cached
+	bool TryPin(unsigned int fileId, unsigned long long blockId, span<unsigned char>* data);
+	void Unpin(unsigned int fileId, unsigned long long blockId, bool dirty);
+
+	void Flush(unsigned int fileId);
+	void FlushAll();
+	// Number of dirty frames that triggers a FlushAll, half of the frames by default
+	void SetDirtyFramesThreshold(size_t threshold);
+	size_t GetDirtyFramesThreshold() const;
+	size_t GetDirtyFramesCount() const;
+	// Drops (without writing back) every cached block of the file with id >= firstBlockId
+	void Discard(unsigned int fileId, unsigned long long firstBlockId = 0);
+	// Drops one unpinned block without writing it back, if it is cached
+	void DiscardBlock(unsigned int fileId, unsigned long long blockId);
+
+	size_t GetFramesCount() const;
+	size_t GetFrameSize() const;
+	unsigned long long GetHitsCount() const;
+	unsigned long long GetMissesCount() const;
+
+private:
+	struct Frame
+	{
+		unsigned int FileId;
+		unsigned long long BlockId;
+		unsigned int PinCount;
+		bool Dirty;
+		bool Referenced;
+		bool Valid;
+	};
+
+	size_t m_FrameSize;
+	vector<Frame> m_Frames;
+	AlignedBuffer m_FramesData;
+	unordered_map<unsigned long long, size_t> m_PageTable;
+	unordered_map<unsigned int, WriteBackFunction> m_Files;
+	unsigned int m_NextFileId;
+	// Ids of unregistered files, given again before m_NextFileId moves on
+	vector<unsigned int> m_FreeFileIds;
+	size_t m_ClockHand;
+	size_t m_DirtyFramesCount;
+	size_t m_DirtyFramesThreshold;
+	unsigned long long m_HitsCount;
+	unsigned long long m_MissesCount;
+	// Recursive, a write back may evict or flush through the pool again
+	mutable recursive_mutex m_Mutex;
+
+	// The file id takes the top 16 bits of a page table key
+	static constexpr unsigned int MaxFilesCount = 1u << 16;
+
+	static unsigned long long MakeKey(unsigned int fileId, unsigned long long blockId);
+	span<unsigned char> GetFrameData(size_t frameIndex);
+	size_t FindVictim();
+	void MarkClean(Frame& frame);
+	span<unsigned char> PinInternal(unsigned int fileId, unsigned long long blockId, const ReadFunction* read);
+};
@@ -1,24 +1,68 @@
 #include "pch.h"
 #include "Column.h"
+#include <charconv>
 
-Column::Column(string name, ColumnType type, unsigned int arraySize) : Name(name), Type(type), ArraySize(arraySize)
+namespace
+{
+	// from_chars does not allocate nor depend on the locale, unlike the sto* family it replaces.
+	// Surrounding blanks and a leading '+' are still accepted, an empty value is parsed as zero
+	template <typename T>
+	void ParseNumber(const Column& column, span<unsigned char> destination, string_view str)
+	{
+		while (!str.empty() && (str.front() == ' ' || str.front() == '\t'))
+		{
+			str.remove_prefix(1);
+		}
+		while (!str.empty() && (str.back() == ' ' || str.back() == '\t' || str.back() == '\r'))
+		{
+			str.remove_suffix(1);
+		}
+		if (!str.empty() && str.front() == '+')
+		{
+			str.remove_prefix(1);
+		}
+
+		T value = 0;
+		if (!str.empty())
+		{
+			auto result = from_chars(str.data(), str.data() + str.size(), value);
+			if (result.ec != errc() || result.ptr != str.data() + str.size())
+			{
+				throw runtime_error("Invalid value '" + string(str) + "' for column " + column.Name);
+			}
+		}
+		memcpy(destination.data(), &value, sizeof(T));
+	}
+}
+
+Column::Column(string name, ColumnType type, unsigned int arraySize) :
+	Name(name),
+	Type(type),
+	ArraySize(arraySize),
+	Offset(0),
+	Length(GetLength(type, arraySize))
 {
 }
 
 unsigned int Column::GetLength() const
 {
-	switch (Type)
+	return Length;
+}
+
+unsigned int Column::GetLength(ColumnType type, unsigned int arraySize)
+{
+	switch (type)
 	{
 	case ColumnType::INT32:
 	case ColumnType::FLOAT:
-		return sizeof(int) * ArraySize;
+		return sizeof(int) * arraySize;
 
 	case ColumnType::INT64:
 	case ColumnType::DOUBLE:
-		return sizeof(long long) * ArraySize;
+		return sizeof(long long) * arraySize;
 
 	case ColumnType::CHAR:
-		return sizeof(char) * ArraySize;
+		return sizeof(char) * arraySize;
 
 	default:
 		return 0;
@@ -28,7 +72,7 @@ unsigned int Column::GetLength() const
 
 int Column::Compare(const Column& column, span<unsigned char> a, span<unsigned char> b)
 {
-	if (a.size() != b.size() || b.size() != column.GetLength())
+	if (a.size() != b.size() || b.size() != column.Length)
 	{
 		throw runtime_error("a.size() != b.size()");
 	}
@@ -74,7 +118,7 @@ int Column::Compare(const Column& column, span<unsigned char> a, span<unsigned c
 
 bool Column::Equals(const Column& column, span<unsigned char> a, span<unsigned char> b)
 {
-	if (a.size() != b.size() || b.size() != column.GetLength())
+	if (a.size() != b.size() || b.size() != column.Length)
 	{
 		throw runtime_error("a.size() != b.size()");
 	}
@@ -83,7 +127,7 @@ bool Column::Equals(const Column& column, span<unsigned char> a, span<unsigned c
 }
 
 
-void Column::Parse(const Column& column, span<unsigned char> destination, string str)
+void Column::Parse(const Column& column, span<unsigned char> destination, string_view str)
 {
 	if (destination.size() != column.GetLength())
 	{
@@ -94,37 +138,32 @@ void Column::Parse(const Column& column, span<unsigned char> destination, string
 	{
 		case ColumnType::INT32:
 		{
-			auto value = stoi(str);
-			memcpy(destination.data(), &value, sizeof(int));
+			ParseNumber<int>(column, destination, str);
 			break;
 		}
 
 		case ColumnType::INT64: 
 		{
-			auto value = stoll(str);
-			memcpy(destination.data(), &value, sizeof(long long));
+			ParseNumber<long long>(column, destination, str);
 			break;
 		}
 
 		case ColumnType::DOUBLE:
 		{
-			auto value = stod(str);
-			memcpy(destination.data(), &value, sizeof(double));
+			ParseNumber<double>(column, destination, str);
 			break;
 		}
 
 		case ColumnType::FLOAT:
 		{
-			auto value = stof(str);
-			memcpy(destination.data(), &value, sizeof(float));
+			ParseNumber<float>(column, destination, str);
 			break;
 		}
 
 		case ColumnType::CHAR:
 		{
-			auto value = str.c_str();
 			auto length = min(str.length(), destination.size());
-			memcpy(destination.data(), value, length);
+			memcpy(destination.data(), str.data(), length);
 			break;
 		}
 
@@ -7,13 +7,17 @@ public:
 	string Name;
 	ColumnType Type;
 	unsigned int ArraySize;
+	// Position of the value in the record, set by the schema
+	unsigned int Offset;
+	unsigned int Length;
 
 	Column(string name, ColumnType type, unsigned int arraySize);
 	unsigned int GetLength() const;
+	static unsigned int GetLength(ColumnType type, unsigned int arraySize);
 
 
 	static int Compare(const Column& column, span<unsigned char> a, span<unsigned char> b);
 	static bool Equals(const Column& column, span<unsigned char> a, span<unsigned char> b);
-	static void Parse(const Column& column, span<unsigned char> destination, string str);
+	static void Parse(const Column& column, span<unsigned char> destination, string_view str);
 	static void WriteValue(ostream& out, const Column& column, span<unsigned char> destination);
 };
\ No newline at end of file
@@ -0,0 +1,160 @@
+#include "pch.h"
+#include "CsvLoader.h"
+
+CsvLoader::CsvLoader(Schema* schema, size_t threadsCount, size_t chunkSize) :
+	m_Schema(schema),
+	m_ThreadsCount(threadsCount),
+	m_ChunkSize(chunkSize)
+{
+	if (m_ThreadsCount == 0)
+	{
+		m_ThreadsCount = max(1u, thread::hardware_concurrency());
+	}
+	if (m_ChunkSize == 0)
+	{
+		throw runtime_error("Invalid chunk size");
+	}
+}
+
+unsigned long long CsvLoader::Load(string path, SinkFunction sink, unsigned long long lines)
+{
+	auto file = MappedFile();
+	file.Open(path, true);
+	auto data = file.GetData();
+	auto size = (size_t)file.GetSize();
+	if (data == nullptr || lines == 0)
+	{
+		return 0;
+	}
+
+	// Skip the header
+	auto newLine = (const unsigned char*)memchr(data, '\n', size);
+	if (newLine == nullptr)
+	{
+		return 0;
+	}
+	auto start = (size_t)(newLine - data) + 1;
+
+	auto recordSize = (size_t)m_Schema->GetSize();
+	unsigned long long loaded = 0;
+	auto pending = async(launch::async, &CsvLoader::ParseWindow, this, data, size, start);
+	while (pending.valid())
+	{
+		auto window = pending.get();
+		if (window.End < size)
+		{
+			// Parse the next window while this one is inserted
+			pending = async(launch::async, &CsvLoader::ParseWindow, this, data, size, window.End);
+		}
+
+		for (auto& chunk : window.Chunks)
+		{
+			auto count = (size_t)min((unsigned long long)chunk.RecordsCount, lines - loaded);
+			if (count > 0)
+			{
+				sink(span<const unsigned char>(chunk.Records.data(), count * recordSize));
+				loaded += count;
+			}
+			if (loaded == lines)
+			{
+				return loaded;
+			}
+		}
+	}
+	return loaded;
+}
+
+CsvLoader::Window CsvLoader::ParseWindow(const unsigned char* data, size_t size, size_t start)
+{
+	auto window = Window();
+
+	// Cut the window into chunks that end right after a line break
+	auto bounds = vector<pair<size_t, size_t>>();
+	auto position = start;
+	while (position < size && bounds.size() < m_ThreadsCount)
+	{
+		auto end = min(size, position + m_ChunkSize);
+		if (end < size)
+		{
+			auto newLine = (const unsigned char*)memchr(data + end, '\n', size - end);
+			end = newLine == nullptr ? size : (size_t)(newLine - data) + 1;
+		}
+		bounds.push_back({ position, end });
+		position = end;
+	}
+	window.End = position;
+	window.Chunks.resize(bounds.size());
+
+	auto workers = vector<future<void>>();
+	for (size_t i = 1; i < bounds.size(); i++)
+	{
+		workers.push_back(async(launch::async, [this, data, &bounds, &window, i]()
+		{
+			ParseChunk((const char*)data + bounds[i].first, (const char*)data + bounds[i].second, window.Chunks[i]);
+		}));
+	}
+	if (!bounds.empty())
+	{
+		ParseChunk((const char*)data + bounds[0].first, (const char*)data + bounds[0].second, window.Chunks[0]);
+	}
+	for (auto& worker : workers)
+	{
+		// Rethrows parse errors
+		worker.get();
+	}
+	return window;
+}
+
+void CsvLoader::ParseChunk(const char* begin, const char* end, Chunk& chunk)
+{
+	auto recordSize = (size_t)m_Schema->GetSize();
+	chunk.RecordsCount = 0;
+	// Rough guess of the rows in the chunk, the buffer still grows if it is short
+	chunk.Records.reserve(((end - begin) / 32 + 1) * recordSize);
+
+	while (begin < end)
+	{
+		auto lineEnd = (const char*)memchr(begin, '\n', end - begin);
+		if (lineEnd == nullptr)
+		{
+			lineEnd = end;
+		}
+		auto line = string_view(begin, lineEnd - begin);
+		begin = lineEnd + 1;
+
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.remove_suffix(1);
+		}
+		if (line.empty())
+		{
+			continue;
+		}
+
+		// New bytes are zeroed, the text columns shorter than the column stay padded
+		chunk.Records.resize((chunk.RecordsCount + 1) * recordSize);
+		ParseLine(line, span<unsigned char>(chunk.Records.data() + chunk.RecordsCount * recordSize, recordSize));
+		chunk.RecordsCount++;
+	}
+}
+
+void CsvLoader::ParseLine(string_view line, span<unsigned char> record)
+{
+	auto columnsCount = m_Schema->GetColumnsCount();
+	unsigned int columnId = 1;
+	while (columnId < columnsCount)
+	{
+		auto separator = line.find(',');
+		auto cell = line.substr(0, separator);
+
+		auto& column = m_Schema->GetColumn(columnId);
+		Column::Parse(column, record.subspan(column.Offset, column.Length), cell);
+		columnId++;
+
+		if (separator == string_view::npos)
+		{
+			break;
+		}
+		line.remove_prefix(separator + 1);
+	}
+}
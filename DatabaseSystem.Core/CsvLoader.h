@@ -0,0 +1,48 @@
+#pragma once
+#include <thread>
+#include <future>
+#include "Schema.h"
+#include "MappedFile.h"
+
+/*
+	Bulk loader for comma separated files with a header line and one column per schema column,
+	the Id excluded (it is assigned on insertion).
+	The file is memory mapped and read a window at a time: the window is cut into chunks at line
+	boundaries, the chunks are parsed in parallel (from_chars, no per line allocation) and the rows
+	are handed to the sink packed back to back, in file order, while the next window is parsed.
+	Only the rows of two windows are in memory at once, so files larger than RAM can be loaded.
+*/
+class CsvLoader
+{
+public:
+	// Receives records packed back to back, schema size bytes each, in file order
+	using SinkFunction = function<void(span<const unsigned char> records)>;
+
+	static constexpr size_t DefaultChunkSize = 4 * 1024 * 1024;
+
+	CsvLoader(Schema* schema, size_t threadsCount = 0, size_t chunkSize = DefaultChunkSize);
+
+	// Returns the number of records given to the sink, at most lines
+	unsigned long long Load(string path, SinkFunction sink, unsigned long long lines = (unsigned long long)-1);
+
+private:
+	struct Chunk
+	{
+		vector<unsigned char> Records;
+		size_t RecordsCount;
+	};
+
+	struct Window
+	{
+		vector<Chunk> Chunks;
+		size_t End;
+	};
+
+	Schema* m_Schema;
+	size_t m_ThreadsCount;
+	size_t m_ChunkSize;
+
+	Window ParseWindow(const unsigned char* data, size_t size, size_t start);
+	void ParseChunk(const char* begin, const char* end, Chunk& chunk);
+	void ParseLine(string_view line, span<unsigned char> record);
+};
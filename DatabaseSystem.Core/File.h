@@ -1,79 +1,383 @@
 #pragma once
 #include "Block.h"
+#include "BufferPool.h"
+#include "BlockDevice.h"
+#include "MappedFile.h"
+#include "FileAccessMode.h"
+#include "AsyncBlockIO.h"
+#include <sstream>
 
+// Bytes read at once by sequential scans (see FileWrapper::SetReadAheadBlocks)
+static constexpr size_t DefaultReadAheadSize = 128 * 1024;
+
+/*
+	Every file starts with a head region of HeadPagesCount blocks. The first one begins with the
+	preamble below, followed by the binary head (FileHead::Serialize), which continues on the
+	next blocks of the region when it does not fit (e.g. a large bucket directory).
+	Data blocks start right after the region, at a block aligned offset.
+*/
+static const char FileMagic[8] = { 'C', 'O', 'S', '4', '8', '0', 'D', 'B' };
+
+struct FileHeadPreamble
+{
+	static constexpr unsigned int CurrentVersion = 1;
+
+	char Magic[8];
+	unsigned int Version;
+	unsigned int BlockSize;
+	unsigned long long HeadPagesCount;
+	unsigned long long HeadSize;
+};
 
 //template<derived_from<FileHead> TFileHead>
 template<typename TFileHead>
 class FileWrapper
 {
 public:
-	FileWrapper(size_t blockSize, size_t blockHeaderSize = 0) :
-		m_FileHead(nullptr), 
+	FileWrapper(size_t blockSize, size_t blockHeaderSize = 0, BufferPool* bufferPool = nullptr) :
 		m_BlockSize(blockSize),
-		m_BlockHeaderSize(blockHeaderSize)
+		m_BlockHeaderSize(blockHeaderSize),
+		m_FileHead(nullptr),
+		m_FirstBlockPos(0),
+		m_HeadPagesCount(0),
+		m_BufferPool(bufferPool),
+		m_FileId(BufferPool::InvalidFileId),
+		m_Registered(false),
+		m_AccessMode(FileAccessMode::POSITIONAL),
+		m_WriteBack(false),
+		m_ReadAheadBlocks(max(DefaultReadAheadSize / blockSize, (size_t)1)),
+		m_ReadAheadFirstBlockId(0),
+		m_ReadAheadBlocksCount(0),
+		m_LastScannedBlockId((unsigned long long)-1),
+		m_SequentialScan(false),
+		m_AsyncIO(&AsyncBlockIO::GetDefault())
+	{
+		if (m_BufferPool == nullptr)
+		{
+			m_OwnedBufferPool = make_unique<BufferPool>(BufferPool::DefaultFramesCount, blockSize);
+			m_BufferPool = m_OwnedBufferPool.get();
+		}
+
+		if (m_BufferPool->GetFrameSize() != blockSize)
+		{
+			throw runtime_error("Buffer pool frame size does not match the block size");
+		}
+	}
+
+	~FileWrapper()
 	{
+		UnregisterFromPool();
 	}
 
 	void Open(string path, TFileHead* head)
 	{
+		CloseBlocks();
 		m_FilePath = path;
-		m_Stream.open(path);
-		m_Stream.seekg(0, ios::beg);
-		m_Stream.seekp(0, ios::beg);
 		m_FileHead = head;
-		head->Deserialize(m_Stream);
-		m_FirstBlockPos = (streamoff)m_Stream.tellg() - 1;
+		m_Device.Open(path);
+
+		auto headData = ReadHeadRegion();
+		stringstream headStream(headData, ios::in | ios::out | ios::binary);
+		head->Deserialize(headStream);
+		OpenBlocks();
 	}
 
+	// Opens the file at path keeping the given head, only the layout is read from the file
 	void UpdatePath(string path, TFileHead* head)
 	{
+		CloseBlocks();
 		m_FilePath = path;
-		m_Stream.open(path);
-		m_Stream.seekg(0, ios::beg);
-		m_Stream.seekp(0, ios::beg);
 		m_FileHead = head;
-		m_FirstBlockPos = (streamoff)m_Stream.tellg() - 1;
+		m_Device.Open(path);
+		ReadHeadRegion();
+		OpenBlocks();
 	}
 
 	void Close()
 	{
-		m_Stream.seekp(0, ios::beg);
-		m_FileHead->Serialize(m_Stream);
-		m_Stream.flush();
-		m_Stream.close();
+		WriteHead();
+		CloseBlocks();
+		m_Device.Close();
+	}
+
+	/*
+	* Writes every dirty block and the file head and forces them to stable storage.
+	* After a checkpoint the file on disk is complete even if the process dies before Close.
+	*/
+	void Checkpoint()
+	{
+		if (m_AccessMode == +FileAccessMode::MEMORY_MAPPED)
+		{
+			m_Mapping.Flush();
+		}
+		else
+		{
+			m_BufferPool->Flush(m_FileId);
+		}
+		WriteHead();
+		m_Device.Sync();
 	}
 
 	void SeekHead()
 	{
-		m_Stream.seekg(0, ios::beg);
-		m_Stream.seekp(0, ios::beg);
 		m_FileHead->SetBlocksCount(0);
+		// A memory mapped file is not in the pool, its id belongs to no file
+		if (m_Registered)
+		{
+			m_BufferPool->Discard(m_FileId);
+		}
+		ResetReadAhead();
 	}
 
 	void NewFile(string path, TFileHead* head)
 	{
+		CloseBlocks();
 		m_FilePath = path;
 		m_FileHead = head;
-		m_Stream.open(path, ios::trunc | ios::in | ios::out | ios::binary);
-		m_Stream.seekg(0, ios::beg);
-		m_Stream.seekp(0, ios::beg);
-		head->Serialize(m_Stream);
-		m_Stream.flush();
-		m_FirstBlockPos = m_Stream.tellp();
+		m_Device.Open(path, true);
+		m_HeadPagesCount = 0;
+		m_FirstBlockPos = 0;
+		// Sizes the head region for the head as it is now
+		WriteHead();
+		OpenBlocks();
 	}
 
-	bool GetBlock(unsigned int blockId, Block* destination)
+	/*
+	* Selects how the blocks are reached. Must be called before Open/NewFile.
+	* MEMORY_MAPPED maps the whole file and bypasses the buffer pool, since the OS page cache already
+	* plays that role: scans attach the block to the mapping (no copy, no syscall) and random reads
+	* copy it straight from the mapping.
+	*/
+	void SetAccessMode(FileAccessMode mode)
 	{
-		vector<unsigned char> tempBuffer(m_BlockSize);
+		m_AccessMode = mode;
+	}
 
-		m_Stream.clear();
-		m_Stream.seekg(m_FirstBlockPos + streamoff(m_BlockSize * blockId), ios::beg);
+	FileAccessMode GetAccessMode()
+	{
+		return m_AccessMode;
+	}
 
-		m_Stream.read((char*)tempBuffer.data(), m_BlockSize);
-		destination->Load(tempBuffer);
+	/*
+	* In write-back mode WriteBlock only updates the block in the buffer pool and marks it dirty.
+	* Dirty blocks reach the disk in runs of adjacent blocks on Checkpoint/Close, when they are
+	* evicted, or when the pool dirty frames threshold is reached.
+	*/
+	void SetWriteBack(bool enabled)
+	{
+		if (m_WriteBack && !enabled && m_Registered)
+		{
+			m_BufferPool->Flush(m_FileId);
+		}
+		m_WriteBack = enabled;
+	}
+
+	bool IsWriteBack()
+	{
+		return m_WriteBack;
+	}
+
+	// Blocks read at once by sequential scans, 1 disables the read-ahead
+	void SetReadAheadBlocks(size_t blocksCount)
+	{
+		m_ReadAheadBlocks = max(blocksCount, (size_t)1);
+		m_ReadAhead.reset();
+		ResetReadAhead();
+	}
+
+	size_t GetReadAheadBlocks()
+	{
+		return m_ReadAheadBlocks;
+	}
+
+	/*
+	* Reads the block into destination.
+	* With keepInPool = false (sequential scans) a block that is not cached is read straight
+	* into the destination memory and is not admitted into the pool.
+	*/
+	bool GetBlock(unsigned long long blockId, Block* destination, bool keepInPool = true)
+	{
+		if (m_AccessMode == +FileAccessMode::MEMORY_MAPPED)
+		{
+			if (GetBlockEnd(blockId) > m_Mapping.GetSize())
+			{
+				// Past the end of the file, same as a short positional read
+				destination->Clear();
+				return true;
+			}
+			if (keepInPool)
+			{
+				// Random reads are usually followed by a write back, take a private copy so the block
+				// does not see writes other blocks make to the same page in the meantime
+				destination->Load(GetMappedBlock(blockId));
+				return true;
+			}
+			destination->Attach(GetMappedBlock(blockId));
+			return true;
+		}
+
+		if (!keepInPool)
+		{
+			// The pool holds the latest version of the block (it may be dirty), so it comes first
+			span<unsigned char> cached;
+			if (!m_BufferPool->TryPin(m_FileId, blockId, &cached))
+			{
+				ReadSequential(blockId, destination);
+				return true;
+			}
+			destination->Load(cached);
+			m_BufferPool->Unpin(m_FileId, blockId, false);
+			return true;
+		}
+
+		auto data = m_BufferPool->Pin(m_FileId, blockId, [this](unsigned long long id, span<unsigned char> frame) {
+			ReadFromDiskOrReadAhead(id, frame);
+		});
+		destination->Load(data);
+		m_BufferPool->Unpin(m_FileId, blockId, false);
 		return true;
 	}
 
+	/*
+	* Copies count consecutive blocks into destination, reading them from the disk with a single call.
+	* Blocks cached in the buffer pool (possibly dirty, so newer than the disk) replace what was read.
+	* The read-ahead window is left alone: several threads can read different ranges at once,
+	* as long as nobody changes the file meanwhile.
+	*/
+	void ReadBlocks(unsigned long long firstBlockId, size_t count, span<unsigned char> destination)
+	{
+		auto data = destination.subspan(0, count * m_BlockSize);
+		if (m_AccessMode == +FileAccessMode::MEMORY_MAPPED)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				auto block = data.subspan(i * m_BlockSize, m_BlockSize);
+				if (GetBlockEnd(firstBlockId + i) > m_Mapping.GetSize())
+				{
+					memset(block.data(), 0, block.size());
+					continue;
+				}
+				memcpy(block.data(), GetMappedBlock(firstBlockId + i).data(), block.size());
+			}
+			return;
+		}
+
+		auto readBytes = m_Device.ReadAt(m_FirstBlockPos + m_BlockSize * firstBlockId, data);
+		if (readBytes < data.size())
+		{
+			memset(data.data() + readBytes, 0, data.size() - readBytes);
+		}
+		for (size_t i = 0; i < count; i++)
+		{
+			span<unsigned char> cached;
+			if (m_BufferPool->TryPin(m_FileId, firstBlockId + i, &cached))
+			{
+				memcpy(data.data() + i * m_BlockSize, cached.data(), m_BlockSize);
+				m_BufferPool->Unpin(m_FileId, firstBlockId + i, false);
+			}
+		}
+	}
+
+	/*
+	* Loads the given blocks into the buffer pool keeping all their reads in flight at once,
+	* so the GetBlock calls that follow are served from memory.
+	* Blocks already cached are skipped; at most half of the pool is filled per batch.
+	*/
+	void PrefetchBlocks(const vector<unsigned long long>& blockIds)
+	{
+		if (m_AccessMode == +FileAccessMode::MEMORY_MAPPED)
+		{
+			// The pages are brought in by the OS on access
+			return;
+		}
+
+		auto batchSize = max(m_BufferPool->GetFramesCount() / 2, (size_t)1);
+		size_t next = 0;
+		while (next < blockIds.size())
+		{
+			vector<pair<unsigned long long, span<unsigned char>>> frames;
+			vector<AsyncBlockIO::RequestId> requests;
+			for (; next < blockIds.size() && frames.size() < batchSize; next++)
+			{
+				auto blockId = blockIds[next];
+				span<unsigned char> cached;
+				if (m_BufferPool->TryPin(m_FileId, blockId, &cached))
+				{
+					m_BufferPool->Unpin(m_FileId, blockId, false);
+					continue;
+				}
+
+				auto frame = m_BufferPool->PinForOverwrite(m_FileId, blockId);
+				frames.push_back({ blockId, frame });
+				requests.push_back(m_AsyncIO->SubmitRead(&m_Device, m_FirstBlockPos + m_BlockSize * blockId, frame));
+			}
+
+			exception_ptr error = nullptr;
+			for (size_t i = 0; i < frames.size(); i++)
+			{
+				auto blockId = frames[i].first;
+				auto frame = frames[i].second;
+				try
+				{
+					auto readBytes = m_AsyncIO->Wait(requests[i]);
+					if (readBytes < frame.size())
+					{
+						memset(frame.data() + readBytes, 0, frame.size() - readBytes);
+					}
+					m_BufferPool->Unpin(m_FileId, blockId, false);
+				}
+				catch (...)
+				{
+					// Wait for the other reads before giving the frames back
+					error = current_exception();
+					m_BufferPool->Unpin(m_FileId, blockId, false);
+					m_BufferPool->DiscardBlock(m_FileId, blockId);
+				}
+			}
+			if (error != nullptr)
+			{
+				rethrow_exception(error);
+			}
+		}
+	}
+
+	// Engine used by PrefetchBlocks, the shared default one unless set
+	void SetAsyncIO(AsyncBlockIO* asyncIO)
+	{
+		m_AsyncIO = asyncIO == nullptr ? &AsyncBlockIO::GetDefault() : asyncIO;
+	}
+
+	AsyncBlockIO* GetAsyncIO()
+	{
+		return m_AsyncIO;
+	}
+
+	/*
+	* Gives direct access to the block bytes kept in the buffer pool.
+	* Every call must be matched by an UnpinBlock, passing dirty = true if the bytes were changed.
+	*/
+	span<unsigned char> PinBlock(unsigned long long blockId)
+	{
+		if (m_AccessMode == +FileAccessMode::MEMORY_MAPPED)
+		{
+			// The mapping is the cache: changes are in the file as soon as they are made
+			m_Mapping.Reserve(GetBlockEnd(blockId));
+			return GetMappedBlock(blockId);
+		}
+		return m_BufferPool->Pin(m_FileId, blockId, [this](unsigned long long id, span<unsigned char> frame) {
+			ReadFromDiskOrReadAhead(id, frame);
+		});
+	}
+
+	void UnpinBlock(unsigned long long blockId, bool dirty)
+	{
+		if (m_AccessMode == +FileAccessMode::MEMORY_MAPPED)
+		{
+			return;
+		}
+		m_BufferPool->Unpin(m_FileId, blockId, dirty);
+	}
+
 
 	void AddBlock(Block* block)
 	{
@@ -86,14 +390,33 @@ public:
 	{
 		//Assert(blockNumber < m_FileHead->GetBlocksCount(), "Invalid block");
 
-		vector<unsigned char> tempBuffer(m_BlockSize);
-		block->Flush(tempBuffer);
+		block->Flush();
+		if (m_AccessMode == +FileAccessMode::MEMORY_MAPPED)
+		{
+			m_Mapping.Reserve(GetBlockEnd(blockId));
+			memcpy(GetMappedBlock(blockId).data(), block->GetData().data(), m_BlockSize);
+			return;
+		}
+
+		if (m_WriteBack)
+		{
+			auto frame = m_BufferPool->PinForOverwrite(m_FileId, blockId);
+			memcpy(frame.data(), block->GetData().data(), frame.size());
+			m_BufferPool->Unpin(m_FileId, blockId, true);
+			return;
+		}
 
-		m_Stream.clear();
-		m_Stream.seekp(m_FirstBlockPos + streamoff(m_BlockSize * blockId), ios::beg);
+		// Write-through: the block goes straight from its own memory to disk
+		// and the cached copy, if there is one, is refreshed
+		WriteToDisk(blockId, block->GetData());
+		InvalidateReadAhead(blockId, 1);
 
-		m_Stream.write((const char*)tempBuffer.data(), m_BlockSize);
-		m_Stream.flush();
+		span<unsigned char> cached;
+		if (m_BufferPool->TryPin(m_FileId, blockId, &cached))
+		{
+			memcpy(cached.data(), block->GetData().data(), cached.size());
+			m_BufferPool->Unpin(m_FileId, blockId, false);
+		}
 	}
 
 	Block* CreateBlock()
@@ -116,28 +439,76 @@ public:
 		return m_BlockHeaderSize;
 	}
 
-	void Trim()
+	BufferPool* GetBufferPool()
 	{
-		//fstream trimmedFile;
-		//trimmedFile.open("temp.db", ios::trunc | ios::in | ios::out | ios::binary);
-		//m_FileHead->Serialize(trimmedFile);
+		return m_BufferPool;
+	}
 
-		//unsigned long long blockNumber;
-		//while (blockNumber < m_FileHead->GetBlocksCount())
-		//{
-		//	vector<unsigned char> tempBuffer(m_BlockSize);
+	/*
+	* Cuts the file right after the last block in use (BlocksCount), dropping the cached copies of
+	* the blocks past it. Returns the bytes of disk space given back.
+	* Blocks attached to a memory mapped file must be read again after a Trim.
+	*/
+	unsigned long long Trim()
+	{
+		auto allocatedSize = m_Device.GetAllocatedSize();
+		auto blocksCount = m_FileHead->GetBlocksCount();
+		auto finalSize = m_FirstBlockPos + m_BlockSize * blocksCount;
 
-		//	m_Stream.clear();
-		//	m_Stream.seekg(m_FirstBlockPos + streamoff(m_BlockSize * blockNumber), ios::beg);
+		if (m_AccessMode == +FileAccessMode::MEMORY_MAPPED)
+		{
+			// The file can not shrink under a live mapping, map it again once cut
+			m_Mapping.Close(finalSize);
+			m_Mapping.Open(m_FilePath);
+		}
+		else
+		{
+			// Dirty copies of the removed blocks would grow the file again when written back
+			m_BufferPool->Discard(m_FileId, blocksCount);
+			if (m_Device.GetSize() > finalSize)
+			{
+				m_Device.Truncate(finalSize);
+			}
+		}
+		ResetReadAhead();
 
-		//	m_Stream.read((char*)tempBuffer.data(), m_BlockSize);
+		auto trimmedSize = m_Device.GetAllocatedSize();
+		return allocatedSize > trimmedSize ? allocatedSize - trimmedSize : 0;
+	}
+
+	/*
+	* Frees the disk space of blocks no longer in use in the middle of the file (hole punching).
+	* The blocks keep their ids and read as empty blocks afterwards.
+	* Returns the bytes of disk space given back, 0 when the file system does not support it.
+	*/
+	unsigned long long ReleaseBlocks(unsigned long long firstBlockId, unsigned long long blocksCount)
+	{
+		if (blocksCount == 0)
+		{
+			return 0;
+		}
+
+		if (m_AccessMode == +FileAccessMode::MEMORY_MAPPED)
+		{
+			// Pending changes to the pages would be written over the hole
+			m_Mapping.Flush();
+		}
+		else
+		{
+			for (auto blockId = firstBlockId; blockId < firstBlockId + blocksCount; blockId++)
+			{
+				m_BufferPool->DiscardBlock(m_FileId, blockId);
+			}
+		}
+		InvalidateReadAhead(firstBlockId, blocksCount);
 
-		//	trimmedFile.write((const char*)tempBuffer.data(), m_BlockSize);
-		//	blockNumber++;
-		//}
-		//m_Stream.close();
-		//filesystem::copy_file("temp.db", m_FilePath);
-		//m_Stream = trimmedFile;
+		auto allocatedSize = m_Device.GetAllocatedSize();
+		if (!m_Device.PunchHole(m_FirstBlockPos + m_BlockSize * firstBlockId, m_BlockSize * blocksCount))
+		{
+			return 0;
+		}
+		auto releasedSize = m_Device.GetAllocatedSize();
+		return allocatedSize > releasedSize ? allocatedSize - releasedSize : 0;
 	}
 
 	string GetPath()
@@ -149,7 +520,293 @@ protected:
 	string m_FilePath;
 	size_t m_BlockSize;
 	size_t m_BlockHeaderSize;
-	fstream m_Stream;
+	BlockDevice m_Device;
 	TFileHead* m_FileHead;
-	streamoff m_FirstBlockPos;
+	unsigned long long m_FirstBlockPos;
+	unsigned long long m_HeadPagesCount;
+	BufferPool* m_BufferPool;
+	unique_ptr<BufferPool> m_OwnedBufferPool;
+	unsigned int m_FileId;
+	bool m_Registered;
+	FileAccessMode m_AccessMode;
+	bool m_WriteBack;
+	// Read-ahead window of consecutive blocks filled by sequential scans
+	unique_ptr<AlignedBuffer> m_ReadAhead;
+	size_t m_ReadAheadBlocks;
+	unsigned long long m_ReadAheadFirstBlockId;
+	size_t m_ReadAheadBlocksCount;
+	unsigned long long m_LastScannedBlockId;
+	bool m_SequentialScan;
+	AsyncBlockIO* m_AsyncIO;
+	MappedFile m_Mapping;
+
+	/*
+	* Scan reads of consecutive blocks switch to read-ahead: a miss reads the next
+	* m_ReadAheadBlocks blocks with a single call and the following ones are served from memory.
+	*/
+	void ReadSequential(unsigned long long blockId, Block* destination)
+	{
+		auto sequential = blockId == m_LastScannedBlockId + 1;
+		m_LastScannedBlockId = blockId;
+		if (sequential != m_SequentialScan)
+		{
+			m_SequentialScan = sequential;
+			m_Device.AdviseSequential(sequential);
+		}
+
+		if (!IsInReadAhead(blockId))
+		{
+			if (!sequential || m_ReadAheadBlocks <= 1)
+			{
+				ReadFromDisk(blockId, destination->GetData());
+				destination->Load();
+				return;
+			}
+			FillReadAhead(blockId);
+		}
+		destination->Load(GetReadAheadBlock(blockId));
+	}
+
+	void FillReadAhead(unsigned long long firstBlockId)
+	{
+		if (m_ReadAhead == nullptr)
+		{
+			m_ReadAhead = make_unique<AlignedBuffer>(m_ReadAheadBlocks * m_BlockSize);
+		}
+
+		// Do not read past the last block, a block past the end is read alone (as zeros)
+		auto blocksCount = m_FileHead->GetBlocksCount();
+		size_t count = 1;
+		if (firstBlockId < blocksCount)
+		{
+			count = (size_t)min((unsigned long long)m_ReadAheadBlocks, blocksCount - firstBlockId);
+		}
+
+		auto window = m_ReadAhead->GetSpan().subspan(0, count * m_BlockSize);
+		auto readBytes = m_Device.ReadAt(m_FirstBlockPos + m_BlockSize * firstBlockId, window);
+		if (readBytes < window.size())
+		{
+			memset(window.data() + readBytes, 0, window.size() - readBytes);
+		}
+		m_ReadAheadFirstBlockId = firstBlockId;
+		m_ReadAheadBlocksCount = count;
+	}
+
+	bool IsInReadAhead(unsigned long long blockId)
+	{
+		return m_ReadAheadBlocksCount > 0 && blockId >= m_ReadAheadFirstBlockId && blockId - m_ReadAheadFirstBlockId < m_ReadAheadBlocksCount;
+	}
+
+	span<unsigned char> GetReadAheadBlock(unsigned long long blockId)
+	{
+		return m_ReadAhead->GetSpan().subspan((blockId - m_ReadAheadFirstBlockId) * m_BlockSize, m_BlockSize);
+	}
+
+	void ReadFromDiskOrReadAhead(unsigned long long blockId, span<unsigned char> data)
+	{
+		if (IsInReadAhead(blockId))
+		{
+			memcpy(data.data(), GetReadAheadBlock(blockId).data(), data.size());
+			return;
+		}
+		ReadFromDisk(blockId, data);
+	}
+
+	// Drops the window if any of the blocks written is in it
+	void InvalidateReadAhead(unsigned long long firstBlockId, size_t count)
+	{
+		if (m_ReadAheadBlocksCount == 0)
+		{
+			return;
+		}
+		auto windowEnd = m_ReadAheadFirstBlockId + m_ReadAheadBlocksCount;
+		if (firstBlockId < windowEnd && m_ReadAheadFirstBlockId < firstBlockId + count)
+		{
+			m_ReadAheadBlocksCount = 0;
+		}
+	}
+
+	void ResetReadAhead()
+	{
+		m_ReadAheadBlocksCount = 0;
+		m_LastScannedBlockId = (unsigned long long)-1;
+	}
+
+	/*
+	* Lets go of the blocks of the file opened so far. Must run before the device moves to another file,
+	* the dirty blocks are written back through the old device and layout.
+	*/
+	void CloseBlocks()
+	{
+		// Unregistering writes back every dirty block of the file
+		UnregisterFromPool();
+		if (m_Mapping.IsOpen())
+		{
+			// The mapping grows ahead of the data, cut the file back to the blocks in use
+			m_Mapping.Close(m_FirstBlockPos + m_BlockSize * m_FileHead->GetBlocksCount());
+		}
+	}
+
+	void OpenBlocks()
+	{
+		ResetReadAhead();
+		if (m_AccessMode == +FileAccessMode::MEMORY_MAPPED)
+		{
+			m_Mapping.Open(m_FilePath);
+			return;
+		}
+		RegisterInPool();
+	}
+
+	// Reads the head region in (at most) two reads and returns the serialized head
+	string ReadHeadRegion()
+	{
+		AlignedBuffer firstPage(m_BlockSize);
+		auto readBytes = m_Device.ReadAt(0, firstPage.GetSpan());
+
+		FileHeadPreamble preamble;
+		memcpy(&preamble, firstPage.data(), sizeof(FileHeadPreamble));
+		if (readBytes < sizeof(FileHeadPreamble) || memcmp(preamble.Magic, FileMagic, sizeof(preamble.Magic)) != 0)
+		{
+			throw runtime_error("Not a database file: " + m_FilePath);
+		}
+		if (preamble.Version != FileHeadPreamble::CurrentVersion)
+		{
+			throw runtime_error("Unsupported file version " + to_string(preamble.Version));
+		}
+		if (preamble.BlockSize != m_BlockSize)
+		{
+			throw runtime_error("File block size " + to_string(preamble.BlockSize) + " does not match " + to_string(m_BlockSize));
+		}
+		if (sizeof(FileHeadPreamble) + preamble.HeadSize > preamble.HeadPagesCount * m_BlockSize)
+		{
+			throw runtime_error("Corrupted file head");
+		}
+
+		m_HeadPagesCount = preamble.HeadPagesCount;
+		m_FirstBlockPos = m_HeadPagesCount * m_BlockSize;
+
+		string headData(preamble.HeadSize, '\0');
+		auto inFirstPage = min((size_t)preamble.HeadSize, m_BlockSize - sizeof(FileHeadPreamble));
+		memcpy(headData.data(), firstPage.data() + sizeof(FileHeadPreamble), inFirstPage);
+		if (inFirstPage < headData.size())
+		{
+			// Overflow pages follow the first one
+			auto overflow = span<unsigned char>((unsigned char*)headData.data() + inFirstPage, headData.size() - inFirstPage);
+			if (m_Device.ReadAt(m_BlockSize, overflow) < overflow.size())
+			{
+				throw runtime_error("Corrupted file head");
+			}
+		}
+		return headData;
+	}
+
+	void WriteHead()
+	{
+		stringstream headStream(ios::in | ios::out | ios::binary);
+		m_FileHead->Serialize(headStream);
+		auto headData = headStream.str();
+
+		auto headSize = sizeof(FileHeadPreamble) + headData.size();
+		auto pagesCount = (headSize + m_BlockSize - 1) / m_BlockSize;
+		if (pagesCount > m_HeadPagesCount)
+		{
+			// Leave room to grow so a head that keeps growing does not move the data every time
+			auto newPagesCount = m_HeadPagesCount == 0 ? pagesCount : max((unsigned long long)pagesCount, m_HeadPagesCount * 2);
+			MoveBlocks(newPagesCount);
+		}
+
+		FileHeadPreamble preamble = {};
+		memcpy(preamble.Magic, FileMagic, sizeof(preamble.Magic));
+		preamble.Version = FileHeadPreamble::CurrentVersion;
+		preamble.BlockSize = (unsigned int)m_BlockSize;
+		preamble.HeadPagesCount = m_HeadPagesCount;
+		preamble.HeadSize = headData.size();
+
+		AlignedBuffer region(m_HeadPagesCount * m_BlockSize);
+		memcpy(region.data(), &preamble, sizeof(FileHeadPreamble));
+		memcpy(region.data() + sizeof(FileHeadPreamble), headData.data(), headData.size());
+		m_Device.WriteAt(0, region.GetSpan());
+	}
+
+	// Grows the head region to pagesCount blocks, moving the data blocks after it
+	void MoveBlocks(unsigned long long pagesCount)
+	{
+		auto newFirstBlockPos = pagesCount * m_BlockSize;
+		auto blocksCount = m_FileHead->GetBlocksCount();
+		if (blocksCount > 0)
+		{
+			if (m_AccessMode == +FileAccessMode::MEMORY_MAPPED)
+			{
+				m_Mapping.Reserve(newFirstBlockPos + m_BlockSize * blocksCount);
+				memmove(m_Mapping.GetData() + newFirstBlockPos, m_Mapping.GetData() + m_FirstBlockPos, m_BlockSize * blocksCount);
+			}
+			else
+			{
+				// Cached blocks keep their ids, only the dirty ones must reach the old place first
+				m_BufferPool->Flush(m_FileId);
+				AlignedBuffer block(m_BlockSize);
+				for (auto blockId = blocksCount; blockId-- > 0;)
+				{
+					ReadFromDisk(blockId, block.GetSpan());
+					m_Device.WriteAt(newFirstBlockPos + m_BlockSize * blockId, block.GetSpan());
+				}
+			}
+		}
+		m_HeadPagesCount = pagesCount;
+		m_FirstBlockPos = newFirstBlockPos;
+		ResetReadAhead();
+	}
+
+	unsigned long long GetBlockEnd(unsigned long long blockId)
+	{
+		return m_FirstBlockPos + m_BlockSize * (blockId + 1);
+	}
+
+	span<unsigned char> GetMappedBlock(unsigned long long blockId)
+	{
+		return span<unsigned char>(m_Mapping.GetData() + m_FirstBlockPos + m_BlockSize * blockId, m_BlockSize);
+	}
+
+	void RegisterInPool()
+	{
+		UnregisterFromPool();
+		m_FileId = m_BufferPool->RegisterFile([this](unsigned long long firstBlockId, const vector<span<const unsigned char>>& blocks) {
+			InvalidateReadAhead(firstBlockId, blocks.size());
+			if (blocks.size() == 1)
+			{
+				m_Device.WriteAt(m_FirstBlockPos + m_BlockSize * firstBlockId, blocks[0]);
+				return;
+			}
+			m_Device.WriteAt(m_FirstBlockPos + m_BlockSize * firstBlockId, blocks);
+		});
+		m_Registered = true;
+	}
+
+	void UnregisterFromPool()
+	{
+		if (!m_Registered)
+		{
+			return;
+		}
+		m_BufferPool->UnregisterFile(m_FileId);
+		m_FileId = BufferPool::InvalidFileId;
+		m_Registered = false;
+	}
+
+	void ReadFromDisk(unsigned long long blockId, span<unsigned char> data)
+	{
+		auto readBytes = m_Device.ReadAt(m_FirstBlockPos + m_BlockSize * blockId, data);
+
+		// Blocks past the end of the file read as zeros, not as whatever the buffer held before
+		if (readBytes < data.size())
+		{
+			memset(data.data() + readBytes, 0, data.size() - readBytes);
+		}
+	}
+
+	void WriteToDisk(unsigned long long blockId, span<unsigned char> data)
+	{
+		m_Device.WriteAt(m_FirstBlockPos + m_BlockSize * blockId, data);
+	}
 };
\ No newline at end of file
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "BetterEnums.h"
+
+// How a FileWrapper reaches the blocks on disk: positional reads/writes through the buffer pool, or a memory mapping
+BETTER_ENUM(FileAccessMode, int, POSITIONAL, MEMORY_MAPPED)
@@ -9,13 +9,18 @@ Schema* FileHead::GetSchema()
 void FileHead::Serialize(iostream& dst)
 {
 	m_Schema->Serialize(dst);
-	dst << m_BlocksCount << endl;
-	dst << NextId << endl;
+	WriteField(dst, m_BlocksCount);
+	WriteField(dst, NextId);
 }
 
 void FileHead::Deserialize(iostream& src)
 {
+	if (m_Schema == nullptr)
+	{
+		// Heads created to open a file have no schema yet, it comes from the file
+		m_Schema = new Schema();
+	}
 	m_Schema->Deserialize(src);
-	src >> m_BlocksCount;
-	src >> NextId;
+	ReadField(src, m_BlocksCount);
+	ReadField(src, NextId);
 }
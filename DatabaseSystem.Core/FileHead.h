@@ -5,6 +5,8 @@
 class FileHead : public Serializable
 {
 public:
+	FileHead() : NextId(0), m_Schema(nullptr), m_BlocksCount(0) {}
+
 	unsigned long long NextId;
 	Schema* GetSchema();
 
@@ -0,0 +1,262 @@
+#include "pch.h"
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile() :
+	m_Data(nullptr),
+	m_Size(0),
+	m_ReadOnly(false),
+	m_Handle(INVALID_HANDLE_VALUE),
+	m_Mapping(nullptr)
+{
+}
+
+void MappedFile::Open(string path, bool readOnly)
+{
+	Close();
+	m_ReadOnly = readOnly;
+	auto handle = CreateFileA(path.c_str(),
+		readOnly ? GENERIC_READ : GENERIC_READ | GENERIC_WRITE,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr,
+		readOnly ? OPEN_EXISTING : OPEN_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL,
+		nullptr);
+	if (handle == INVALID_HANDLE_VALUE)
+	{
+		throw runtime_error("Could not open " + path);
+	}
+	m_Handle = handle;
+
+	LARGE_INTEGER size;
+	GetFileSizeEx(m_Handle, &size);
+	if (size.QuadPart > 0)
+	{
+		Map(size.QuadPart);
+	}
+}
+
+void MappedFile::Close(unsigned long long finalSize)
+{
+	if (m_Handle == INVALID_HANDLE_VALUE)
+	{
+		return;
+	}
+
+	Flush();
+	for (auto& view : m_RetiredViews)
+	{
+		Unmap(view);
+	}
+	m_RetiredViews.clear();
+	if (m_Data != nullptr)
+	{
+		Unmap(View{ m_Data, m_Size, m_Mapping });
+	}
+	m_Data = nullptr;
+	m_Mapping = nullptr;
+	m_Size = 0;
+
+	if (!m_ReadOnly && finalSize != (unsigned long long) - 1)
+	{
+		LARGE_INTEGER position;
+		position.QuadPart = finalSize;
+		SetFilePointerEx(m_Handle, position, nullptr, FILE_BEGIN);
+		SetEndOfFile(m_Handle);
+	}
+	CloseHandle(m_Handle);
+	m_Handle = INVALID_HANDLE_VALUE;
+}
+
+bool MappedFile::IsOpen() const
+{
+	return m_Handle != INVALID_HANDLE_VALUE;
+}
+
+void MappedFile::Flush()
+{
+	if (m_Data != nullptr && !m_ReadOnly)
+	{
+		FlushViewOfFile(m_Data, 0);
+	}
+}
+
+void MappedFile::Map(unsigned long long size)
+{
+	// CreateFileMapping grows the file on disk to the requested size
+	auto mapping = CreateFileMappingA(m_Handle, nullptr,
+		m_ReadOnly ? PAGE_READONLY : PAGE_READWRITE,
+		(DWORD)(size >> 32), (DWORD)(size & 0xFFFFFFFF), nullptr);
+	if (mapping == nullptr)
+	{
+		throw runtime_error("Could not map the file");
+	}
+
+	auto data = MapViewOfFile(mapping, m_ReadOnly ? FILE_MAP_READ : FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)size);
+	if (data == nullptr)
+	{
+		CloseHandle(mapping);
+		throw runtime_error("Could not map the file");
+	}
+
+	if (m_Data != nullptr)
+	{
+		m_RetiredViews.push_back(View{ m_Data, m_Size, m_Mapping });
+	}
+	m_Data = (unsigned char*)data;
+	m_Mapping = mapping;
+	m_Size = size;
+}
+
+void MappedFile::Unmap(View view)
+{
+	UnmapViewOfFile(view.Data);
+	CloseHandle(view.Mapping);
+}
+
+#else
+
+MappedFile::MappedFile() :
+	m_Data(nullptr),
+	m_Size(0),
+	m_ReadOnly(false),
+	m_Descriptor(-1)
+{
+}
+
+void MappedFile::Open(string path, bool readOnly)
+{
+	Close();
+	m_ReadOnly = readOnly;
+	auto descriptor = open(path.c_str(), readOnly ? O_RDONLY : O_RDWR | O_CREAT, 0644);
+	if (descriptor < 0)
+	{
+		throw runtime_error("Could not open " + path);
+	}
+	m_Descriptor = descriptor;
+
+	struct stat status;
+	fstat(m_Descriptor, &status);
+	if (status.st_size > 0)
+	{
+		Map(status.st_size);
+	}
+}
+
+void MappedFile::Close(unsigned long long finalSize)
+{
+	if (m_Descriptor < 0)
+	{
+		return;
+	}
+
+	Flush();
+	for (auto& view : m_RetiredViews)
+	{
+		Unmap(view);
+	}
+	m_RetiredViews.clear();
+	if (m_Data != nullptr)
+	{
+		Unmap(View{ m_Data, m_Size, nullptr });
+	}
+	m_Data = nullptr;
+	m_Size = 0;
+
+	if (!m_ReadOnly && finalSize != (unsigned long long) - 1)
+	{
+		if (ftruncate(m_Descriptor, (off_t)finalSize) != 0)
+		{
+			throw runtime_error("Could not truncate the mapped file");
+		}
+	}
+	close(m_Descriptor);
+	m_Descriptor = -1;
+}
+
+bool MappedFile::IsOpen() const
+{
+	return m_Descriptor >= 0;
+}
+
+void MappedFile::Flush()
+{
+	if (m_Data != nullptr && !m_ReadOnly)
+	{
+		msync(m_Data, m_Size, MS_SYNC);
+	}
+}
+
+void MappedFile::Map(unsigned long long size)
+{
+	struct stat status;
+	fstat(m_Descriptor, &status);
+	if (!m_ReadOnly && (unsigned long long)status.st_size < size)
+	{
+		if (ftruncate(m_Descriptor, (off_t)size) != 0)
+		{
+			throw runtime_error("Could not grow the mapped file");
+		}
+	}
+
+	auto data = mmap(nullptr, size, m_ReadOnly ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, m_Descriptor, 0);
+	if (data == MAP_FAILED)
+	{
+		throw runtime_error("Could not map the file");
+	}
+
+	if (m_Data != nullptr)
+	{
+		m_RetiredViews.push_back(View{ m_Data, m_Size, nullptr });
+	}
+	m_Data = (unsigned char*)data;
+	m_Size = size;
+}
+
+void MappedFile::Unmap(View view)
+{
+	munmap(view.Data, view.Size);
+}
+
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+void MappedFile::Reserve(unsigned long long size)
+{
+	if (size <= m_Size)
+	{
+		return;
+	}
+	if (m_ReadOnly)
+	{
+		throw runtime_error("Can not grow a read only mapping");
+	}
+
+	// Grow geometrically so appending blocks does not remap every time
+	Map(max(size, m_Size * 2));
+}
+
+unsigned char* MappedFile::GetData() const
+{
+	return m_Data;
+}
+
+unsigned long long MappedFile::GetSize() const
+{
+	return m_Size;
+}
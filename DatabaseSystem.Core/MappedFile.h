@@ -0,0 +1,50 @@
+#pragma once
+
+/*
+	Read/write memory mapping of a whole file (mmap, or CreateFileMapping/MapViewOfFile on Windows).
+	The mapping grows geometrically on Reserve. Views replaced by a bigger one are only unmapped on
+	Close, so spans handed out before the growth stay valid while the file is open.
+*/
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	void Open(string path, bool readOnly = false);
+	// Unmaps the file and, when finalSize is given, cuts it to the bytes really in use
+	void Close(unsigned long long finalSize = (unsigned long long)-1);
+	bool IsOpen() const;
+
+	// Grows the file and the mapping so at least size bytes are addressable
+	void Reserve(unsigned long long size);
+	void Flush();
+
+	unsigned char* GetData() const;
+	unsigned long long GetSize() const;
+
+private:
+	struct View
+	{
+		unsigned char* Data;
+		unsigned long long Size;
+		void* Mapping;
+	};
+
+	unsigned char* m_Data;
+	unsigned long long m_Size;
+	bool m_ReadOnly;
+	vector<View> m_RetiredViews;
+#ifdef _WIN32
+	void* m_Handle;
+	void* m_Mapping;
+#else
+	int m_Descriptor;
+#endif
+
+	void Map(unsigned long long size);
+	void Unmap(View view);
+};
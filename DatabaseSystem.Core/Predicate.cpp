@@ -0,0 +1,295 @@
+#include "pch.h"
+#include "Predicate.h"
+#include "PredicateKernels.h"
+
+Predicate::Predicate(shared_ptr<const Node> root) :
+	m_Root(root)
+{
+}
+
+Predicate Predicate::Equals(unsigned int columnId, span<const unsigned char> value)
+{
+	return Compare(Operator::EQUALS, columnId, { vector<unsigned char>(value.begin(), value.end()) });
+}
+
+Predicate Predicate::Less(unsigned int columnId, span<const unsigned char> value)
+{
+	return Compare(Operator::LESS, columnId, { vector<unsigned char>(value.begin(), value.end()) });
+}
+
+Predicate Predicate::LessOrEqual(unsigned int columnId, span<const unsigned char> value)
+{
+	return Compare(Operator::LESS_OR_EQUAL, columnId, { vector<unsigned char>(value.begin(), value.end()) });
+}
+
+Predicate Predicate::Greater(unsigned int columnId, span<const unsigned char> value)
+{
+	return Compare(Operator::GREATER, columnId, { vector<unsigned char>(value.begin(), value.end()) });
+}
+
+Predicate Predicate::GreaterOrEqual(unsigned int columnId, span<const unsigned char> value)
+{
+	return Compare(Operator::GREATER_OR_EQUAL, columnId, { vector<unsigned char>(value.begin(), value.end()) });
+}
+
+Predicate Predicate::Between(unsigned int columnId, span<const unsigned char> min, span<const unsigned char> max)
+{
+	return Compare(Operator::BETWEEN, columnId, { vector<unsigned char>(min.begin(), min.end()), vector<unsigned char>(max.begin(), max.end()) });
+}
+
+Predicate Predicate::In(unsigned int columnId, const vector<vector<unsigned char>>& values)
+{
+	return Compare(Operator::IN, columnId, values);
+}
+
+Predicate Predicate::And(Predicate left, Predicate right)
+{
+	return Combine(Operator::AND, left, right);
+}
+
+Predicate Predicate::Or(Predicate left, Predicate right)
+{
+	return Combine(Operator::OR, left, right);
+}
+
+Predicate Predicate::Not(Predicate predicate)
+{
+	auto node = make_shared<Node>();
+	node->Type = Operator::NOT;
+	node->Left = predicate.m_Root;
+	return Predicate(node);
+}
+
+Predicate Predicate::Compare(Operator op, unsigned int columnId, vector<vector<unsigned char>> values)
+{
+	auto node = make_shared<Node>();
+	node->Type = op;
+	node->ColumnId = columnId;
+	node->Values = move(values);
+	return Predicate(node);
+}
+
+Predicate Predicate::Combine(Operator op, Predicate left, Predicate right)
+{
+	auto node = make_shared<Node>();
+	node->Type = op;
+	node->Left = left.m_Root;
+	node->Right = right.m_Root;
+	return Predicate(node);
+}
+
+void Predicate::Evaluate(Schema* schema, Block* block, SelectionBitmap& selection) const
+{
+	Evaluate(*m_Root, schema, block, selection);
+}
+
+RecordCursor::FilterFunction Predicate::ToFilter(Schema* schema) const
+{
+	auto predicate = *this;
+	return [predicate, schema](Block* block, SelectionBitmap& selection) {
+		predicate.Evaluate(schema, block, selection);
+	};
+}
+
+bool Predicate::GetRange(Schema* schema, unsigned int columnId, vector<unsigned char>& min, vector<unsigned char>& max) const
+{
+	min.clear();
+	max.clear();
+	return GetRange(*m_Root, schema->GetColumn(columnId), columnId, min, max);
+}
+
+bool Predicate::GetValues(unsigned int columnId, vector<vector<unsigned char>>& values) const
+{
+	values.clear();
+	return GetValues(*m_Root, columnId, values);
+}
+
+void Predicate::Evaluate(const Node& node, Schema* schema, Block* block, SelectionBitmap& selection)
+{
+	auto records = block->GetRecords();
+	auto recordSize = block->GetRecordSize();
+
+	switch (node.Type)
+	{
+	case Operator::EQUALS:
+		PredicateKernels::Equals(schema->GetColumn(node.ColumnId), records, recordSize, node.Values[0], selection);
+		return;
+	case Operator::LESS:
+		PredicateKernels::Less(schema->GetColumn(node.ColumnId), records, recordSize, node.Values[0], false, selection);
+		return;
+	case Operator::LESS_OR_EQUAL:
+		PredicateKernels::Less(schema->GetColumn(node.ColumnId), records, recordSize, node.Values[0], true, selection);
+		return;
+	case Operator::GREATER:
+		PredicateKernels::Less(schema->GetColumn(node.ColumnId), records, recordSize, node.Values[0], true, selection);
+		selection.Invert();
+		return;
+	case Operator::GREATER_OR_EQUAL:
+		PredicateKernels::Less(schema->GetColumn(node.ColumnId), records, recordSize, node.Values[0], false, selection);
+		selection.Invert();
+		return;
+	case Operator::BETWEEN:
+		PredicateKernels::Between(schema->GetColumn(node.ColumnId), records, recordSize, node.Values[0], node.Values[1], selection);
+		return;
+	case Operator::IN:
+	{
+		selection.Reset(block->GetRecordsCount());
+		SelectionBitmap matches;
+		for (auto& value : node.Values)
+		{
+			PredicateKernels::Equals(schema->GetColumn(node.ColumnId), records, recordSize, value, matches);
+			selection.Or(matches);
+		}
+		return;
+	}
+	case Operator::AND:
+	case Operator::OR:
+	{
+		Evaluate(*node.Left, schema, block, selection);
+		// Nothing left to keep (or to add), the other side is not evaluated
+		auto count = selection.Count();
+		if ((node.Type == Operator::AND && count == 0) || (node.Type == Operator::OR && count == selection.GetSize()))
+		{
+			return;
+		}
+
+		SelectionBitmap right;
+		Evaluate(*node.Right, schema, block, right);
+		if (node.Type == Operator::AND)
+		{
+			selection.And(right);
+		}
+		else
+		{
+			selection.Or(right);
+		}
+		return;
+	}
+	case Operator::NOT:
+		Evaluate(*node.Left, schema, block, selection);
+		selection.Invert();
+		return;
+	}
+}
+
+bool Predicate::GetRange(const Node& node, const Column& column, unsigned int columnId, vector<unsigned char>& min, vector<unsigned char>& max)
+{
+	auto isColumn = node.ColumnId == columnId;
+	switch (node.Type)
+	{
+	case Operator::EQUALS:
+	case Operator::BETWEEN:
+		if (!isColumn)
+		{
+			return false;
+		}
+		min = node.Values.front();
+		max = node.Values.back();
+		return true;
+	case Operator::LESS:
+	case Operator::LESS_OR_EQUAL:
+		if (!isColumn)
+		{
+			return false;
+		}
+		// The strict comparison keeps the value in the range, it is a bound to search from, not the result
+		max = node.Values[0];
+		return true;
+	case Operator::GREATER:
+	case Operator::GREATER_OR_EQUAL:
+		if (!isColumn)
+		{
+			return false;
+		}
+		min = node.Values[0];
+		return true;
+	case Operator::IN:
+	{
+		if (!isColumn || node.Values.empty())
+		{
+			return false;
+		}
+		min = node.Values[0];
+		max = node.Values[0];
+		for (auto value : node.Values)
+		{
+			if (Column::Compare(column, value, min) < 0)
+			{
+				min = value;
+			}
+			if (Column::Compare(column, value, max) > 0)
+			{
+				max = value;
+			}
+		}
+		return true;
+	}
+	case Operator::AND:
+	{
+		// Both sides must hold, the range is the intersection
+		vector<unsigned char> leftMin, leftMax, rightMin, rightMax;
+		auto left = GetRange(*node.Left, column, columnId, leftMin, leftMax);
+		auto right = GetRange(*node.Right, column, columnId, rightMin, rightMax);
+		if (!left && !right)
+		{
+			return false;
+		}
+		min = leftMin.empty() || (!rightMin.empty() && Column::Compare(column, rightMin, leftMin) > 0) ? rightMin : leftMin;
+		max = leftMax.empty() || (!rightMax.empty() && Column::Compare(column, rightMax, leftMax) < 0) ? rightMax : leftMax;
+		return true;
+	}
+	case Operator::OR:
+	{
+		// Either side may hold, the range covers both and is open on a side if any of them is
+		vector<unsigned char> leftMin, leftMax, rightMin, rightMax;
+		if (!GetRange(*node.Left, column, columnId, leftMin, leftMax) || !GetRange(*node.Right, column, columnId, rightMin, rightMax))
+		{
+			return false;
+		}
+		if (!leftMin.empty() && !rightMin.empty())
+		{
+			min = Column::Compare(column, leftMin, rightMin) <= 0 ? leftMin : rightMin;
+		}
+		if (!leftMax.empty() && !rightMax.empty())
+		{
+			max = Column::Compare(column, leftMax, rightMax) >= 0 ? leftMax : rightMax;
+		}
+		return !min.empty() || !max.empty();
+	}
+	default:
+		return false;
+	}
+}
+
+bool Predicate::GetValues(const Node& node, unsigned int columnId, vector<vector<unsigned char>>& values)
+{
+	switch (node.Type)
+	{
+	case Operator::EQUALS:
+	case Operator::IN:
+		if (node.ColumnId != columnId)
+		{
+			return false;
+		}
+		values.insert(values.end(), node.Values.begin(), node.Values.end());
+		return true;
+	case Operator::AND:
+	{
+		// Either side limits the values, the smaller set is kept
+		vector<vector<unsigned char>> leftValues, rightValues;
+		auto left = GetValues(*node.Left, columnId, leftValues);
+		auto right = GetValues(*node.Right, columnId, rightValues);
+		if (!left && !right)
+		{
+			return false;
+		}
+		auto& smaller = !right || (left && leftValues.size() <= rightValues.size()) ? leftValues : rightValues;
+		values.insert(values.end(), smaller.begin(), smaller.end());
+		return true;
+	}
+	case Operator::OR:
+		return GetValues(*node.Left, columnId, values) && GetValues(*node.Right, columnId, values);
+	default:
+		return false;
+	}
+}
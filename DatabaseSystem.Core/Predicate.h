@@ -0,0 +1,76 @@
+#pragma once
+#include "Schema.h"
+#include "RecordCursor.h"
+
+/*
+	Condition over the columns of a schema: comparisons of a column with constant values
+	(=, <, <=, >, >=, BETWEEN, IN) combined with And, Or and Not. For example "City = X AND Age > 30" is
+		Predicate::And(Predicate::Equals(cityId, SPANOF(city)), Predicate::Greater(ageId, SPANOF(age)))
+	A predicate is evaluated over all the records of a block at once: each comparison runs through
+	PredicateKernels and the selections are combined word by word, so any expression costs a single scan.
+	The values are copied and the expression tree is shared, predicates are cheap to copy and can be used
+	by several threads at once.
+*/
+class Predicate
+{
+public:
+	static Predicate Equals(unsigned int columnId, span<const unsigned char> value);
+	static Predicate Less(unsigned int columnId, span<const unsigned char> value);
+	static Predicate LessOrEqual(unsigned int columnId, span<const unsigned char> value);
+	static Predicate Greater(unsigned int columnId, span<const unsigned char> value);
+	static Predicate GreaterOrEqual(unsigned int columnId, span<const unsigned char> value);
+	// Both ends included
+	static Predicate Between(unsigned int columnId, span<const unsigned char> min, span<const unsigned char> max);
+	static Predicate In(unsigned int columnId, const vector<vector<unsigned char>>& values);
+	static Predicate And(Predicate left, Predicate right);
+	static Predicate Or(Predicate left, Predicate right);
+	static Predicate Not(Predicate predicate);
+
+	// Sets the bits of the records of the block that satisfy the predicate
+	void Evaluate(Schema* schema, Block* block, SelectionBitmap& selection) const;
+	// Block filter for the record cursors and the scans of the record managers
+	RecordCursor::FilterFunction ToFilter(Schema* schema) const;
+
+	/*
+	* Used by the organizations that keep a column in order (or hashed) to visit only the blocks that can match.
+	* GetRange gives the smallest and largest values of the column the predicate can hold for (both included,
+	* an empty bound is open) and returns false when it does not restrict the column.
+	* GetValues gives every value of the column the predicate can hold for, when they are a finite set (=, IN).
+	*/
+	bool GetRange(Schema* schema, unsigned int columnId, vector<unsigned char>& min, vector<unsigned char>& max) const;
+	bool GetValues(unsigned int columnId, vector<vector<unsigned char>>& values) const;
+
+private:
+	enum class Operator
+	{
+		EQUALS,
+		LESS,
+		LESS_OR_EQUAL,
+		GREATER,
+		GREATER_OR_EQUAL,
+		BETWEEN,
+		IN,
+		AND,
+		OR,
+		NOT
+	};
+
+	struct Node
+	{
+		Operator Type;
+		unsigned int ColumnId;
+		vector<vector<unsigned char>> Values;
+		shared_ptr<const Node> Left;
+		shared_ptr<const Node> Right;
+	};
+
+	shared_ptr<const Node> m_Root;
+
+	Predicate(shared_ptr<const Node> root);
+	static Predicate Compare(Operator op, unsigned int columnId, vector<vector<unsigned char>> values);
+	static Predicate Combine(Operator op, Predicate left, Predicate right);
+
+	static void Evaluate(const Node& node, Schema* schema, Block* block, SelectionBitmap& selection);
+	static bool GetRange(const Node& node, const Column& column, unsigned int columnId, vector<unsigned char>& min, vector<unsigned char>& max);
+	static bool GetValues(const Node& node, unsigned int columnId, vector<vector<unsigned char>>& values);
+};
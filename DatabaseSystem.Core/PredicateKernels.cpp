@@ -0,0 +1,660 @@
+#include "pch.h"
+#include "PredicateKernels.h"
+#include <cmath>
+#include <limits>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define KERNELS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(KERNELS_X86) && !defined(_MSC_VER)
+// GCC and Clang only emit the vector instructions in functions compiled for them
+#define TARGET_SSE __attribute__((target("sse4.2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE
+#define TARGET_AVX2
+#endif
+
+namespace
+{
+	SimdLevel DetectLevel()
+	{
+#if defined(KERNELS_X86) && defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		auto maxLeaf = info[0];
+		__cpuid(info, 1);
+		auto sse = (info[2] & (1 << 20)) != 0;
+		// AVX state must also be enabled by the OS
+		auto avx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+		auto avx2 = false;
+		if (maxLeaf >= 7 && avx)
+		{
+			__cpuidex(info, 7, 0);
+			avx2 = (info[1] & (1 << 5)) != 0;
+		}
+		return avx2 ? SimdLevel::AVX2 : (sse ? SimdLevel::SSE : SimdLevel::SCALAR);
+#elif defined(KERNELS_X86)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+		{
+			return SimdLevel::AVX2;
+		}
+		return __builtin_cpu_supports("sse4.2") ? SimdLevel::SSE : SimdLevel::SCALAR;
+#else
+		return SimdLevel::SCALAR;
+#endif
+	}
+
+	SimdLevel& CurrentLevel()
+	{
+		static SimdLevel level = PredicateKernels::GetSupportedLevel();
+		return level;
+	}
+
+	template<typename T>
+	T Load(const unsigned char* data)
+	{
+		// Fields of packed records are not aligned
+		T value;
+		memcpy(&value, data, sizeof(T));
+		return value;
+	}
+
+	// ------------------------------------------------ Scalar ------------------------------------------------
+
+	template<typename T>
+	void EqualsScalar(const unsigned char* field, size_t stride, size_t first, size_t count, T value, SelectionBitmap& selection)
+	{
+		for (auto i = first; i < count; i++)
+		{
+			if (Load<T>(field + i * stride) == value)
+			{
+				selection.Set(i);
+			}
+		}
+	}
+
+	template<typename T>
+	void BetweenScalar(const unsigned char* field, size_t stride, size_t first, size_t count, T min, T max, SelectionBitmap& selection)
+	{
+		for (auto i = first; i < count; i++)
+		{
+			auto value = Load<T>(field + i * stride);
+			if (value >= min && value <= max)
+			{
+				selection.Set(i);
+			}
+		}
+	}
+
+#ifdef KERNELS_X86
+
+	// ------------------------------------------------ AVX2 ------------------------------------------------
+	// Each function handles the records in groups of 8 (32 bits) or 4 (64 bits) values
+	// and returns how many it did, the remaining ones go through the scalar loop.
+
+	TARGET_AVX2 __m256i GatherIndices32(size_t stride)
+	{
+		return _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32((int)stride));
+	}
+
+	TARGET_AVX2 __m128i GatherIndices64(size_t stride)
+	{
+		return _mm_mullo_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32((int)stride));
+	}
+
+	TARGET_AVX2 size_t EqualsDwordAvx2(const unsigned char* field, size_t stride, size_t count, unsigned int value, SelectionBitmap& selection)
+	{
+		auto indices = GatherIndices32(stride);
+		auto target = _mm256_set1_epi32((int)value);
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			auto values = _mm256_i32gather_epi32((const int*)(field + i * stride), indices, 1);
+			auto mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(values, target)));
+			selection.SetMask(i, (unsigned int)mask);
+		}
+		return i;
+	}
+
+	TARGET_AVX2 size_t EqualsQwordAvx2(const unsigned char* field, size_t stride, size_t count, unsigned long long value, SelectionBitmap& selection)
+	{
+		auto indices = GatherIndices64(stride);
+		auto target = _mm256_set1_epi64x((long long)value);
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			auto values = _mm256_i32gather_epi64((const long long*)(field + i * stride), indices, 1);
+			auto mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(values, target)));
+			selection.SetMask(i, (unsigned int)mask);
+		}
+		return i;
+	}
+
+	TARGET_AVX2 size_t BetweenInt32Avx2(const unsigned char* field, size_t stride, size_t count, int min, int max, SelectionBitmap& selection)
+	{
+		auto indices = GatherIndices32(stride);
+		auto minValues = _mm256_set1_epi32(min);
+		auto maxValues = _mm256_set1_epi32(max);
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			auto values = _mm256_i32gather_epi32((const int*)(field + i * stride), indices, 1);
+			auto outside = _mm256_or_si256(_mm256_cmpgt_epi32(minValues, values), _mm256_cmpgt_epi32(values, maxValues));
+			auto mask = ~_mm256_movemask_ps(_mm256_castsi256_ps(outside)) & 0xFF;
+			selection.SetMask(i, (unsigned int)mask);
+		}
+		return i;
+	}
+
+	TARGET_AVX2 size_t BetweenInt64Avx2(const unsigned char* field, size_t stride, size_t count, long long min, long long max, SelectionBitmap& selection)
+	{
+		auto indices = GatherIndices64(stride);
+		auto minValues = _mm256_set1_epi64x(min);
+		auto maxValues = _mm256_set1_epi64x(max);
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			auto values = _mm256_i32gather_epi64((const long long*)(field + i * stride), indices, 1);
+			auto outside = _mm256_or_si256(_mm256_cmpgt_epi64(minValues, values), _mm256_cmpgt_epi64(values, maxValues));
+			auto mask = ~_mm256_movemask_pd(_mm256_castsi256_pd(outside)) & 0xF;
+			selection.SetMask(i, (unsigned int)mask);
+		}
+		return i;
+	}
+
+	TARGET_AVX2 size_t BetweenFloatAvx2(const unsigned char* field, size_t stride, size_t count, float min, float max, SelectionBitmap& selection)
+	{
+		auto indices = GatherIndices32(stride);
+		auto minValues = _mm256_set1_ps(min);
+		auto maxValues = _mm256_set1_ps(max);
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			auto values = _mm256_i32gather_ps((const float*)(field + i * stride), indices, 1);
+			auto inside = _mm256_and_ps(_mm256_cmp_ps(values, minValues, _CMP_GE_OQ), _mm256_cmp_ps(values, maxValues, _CMP_LE_OQ));
+			selection.SetMask(i, (unsigned int)_mm256_movemask_ps(inside));
+		}
+		return i;
+	}
+
+	TARGET_AVX2 size_t BetweenDoubleAvx2(const unsigned char* field, size_t stride, size_t count, double min, double max, SelectionBitmap& selection)
+	{
+		auto indices = GatherIndices64(stride);
+		auto minValues = _mm256_set1_pd(min);
+		auto maxValues = _mm256_set1_pd(max);
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			auto values = _mm256_i32gather_pd((const double*)(field + i * stride), indices, 1);
+			auto inside = _mm256_and_pd(_mm256_cmp_pd(values, minValues, _CMP_GE_OQ), _mm256_cmp_pd(values, maxValues, _CMP_LE_OQ));
+			selection.SetMask(i, (unsigned int)_mm256_movemask_pd(inside));
+		}
+		return i;
+	}
+
+	// Same result as memcmp, 32 bytes at a time
+	TARGET_AVX2 int CompareBytesAvx2(const unsigned char* a, const unsigned char* b, size_t length)
+	{
+		size_t i = 0;
+		for (; i + 32 <= length; i += 32)
+		{
+			auto equal = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(a + i)), _mm256_loadu_si256((const __m256i*)(b + i)));
+			auto different = ~(unsigned int)_mm256_movemask_epi8(equal);
+			if (different != 0)
+			{
+				auto j = i + countr_zero(different);
+				return (int)a[j] - (int)b[j];
+			}
+		}
+		for (; i + 16 <= length; i += 16)
+		{
+			auto equal = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i)), _mm_loadu_si128((const __m128i*)(b + i)));
+			auto different = ~(unsigned int)_mm_movemask_epi8(equal) & 0xFFFF;
+			if (different != 0)
+			{
+				auto j = i + countr_zero(different);
+				return (int)a[j] - (int)b[j];
+			}
+		}
+		return memcmp(a + i, b + i, length - i);
+	}
+
+	// ------------------------------------------------ SSE ------------------------------------------------
+	// There is no gather before AVX2, the lanes are filled from the records one by one
+
+	TARGET_SSE __m128i LoadDwords(const unsigned char* field, size_t stride)
+	{
+		return _mm_setr_epi32(Load<int>(field), Load<int>(field + stride), Load<int>(field + 2 * stride), Load<int>(field + 3 * stride));
+	}
+
+	TARGET_SSE __m128i LoadQwords(const unsigned char* field, size_t stride)
+	{
+		return _mm_set_epi64x(Load<long long>(field + stride), Load<long long>(field));
+	}
+
+	TARGET_SSE size_t EqualsDwordSse(const unsigned char* field, size_t stride, size_t count, unsigned int value, SelectionBitmap& selection)
+	{
+		auto target = _mm_set1_epi32((int)value);
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			auto values = LoadDwords(field + i * stride, stride);
+			auto mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(values, target)));
+			selection.SetMask(i, (unsigned int)mask);
+		}
+		return i;
+	}
+
+	TARGET_SSE size_t EqualsQwordSse(const unsigned char* field, size_t stride, size_t count, unsigned long long value, SelectionBitmap& selection)
+	{
+		auto target = _mm_set1_epi64x((long long)value);
+		size_t i = 0;
+		for (; i + 2 <= count; i += 2)
+		{
+			auto values = LoadQwords(field + i * stride, stride);
+			auto mask = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(values, target)));
+			selection.SetMask(i, (unsigned int)mask);
+		}
+		return i;
+	}
+
+	TARGET_SSE size_t BetweenInt32Sse(const unsigned char* field, size_t stride, size_t count, int min, int max, SelectionBitmap& selection)
+	{
+		auto minValues = _mm_set1_epi32(min);
+		auto maxValues = _mm_set1_epi32(max);
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			auto values = LoadDwords(field + i * stride, stride);
+			auto outside = _mm_or_si128(_mm_cmpgt_epi32(minValues, values), _mm_cmpgt_epi32(values, maxValues));
+			auto mask = ~_mm_movemask_ps(_mm_castsi128_ps(outside)) & 0xF;
+			selection.SetMask(i, (unsigned int)mask);
+		}
+		return i;
+	}
+
+	TARGET_SSE size_t BetweenInt64Sse(const unsigned char* field, size_t stride, size_t count, long long min, long long max, SelectionBitmap& selection)
+	{
+		auto minValues = _mm_set1_epi64x(min);
+		auto maxValues = _mm_set1_epi64x(max);
+		size_t i = 0;
+		for (; i + 2 <= count; i += 2)
+		{
+			auto values = LoadQwords(field + i * stride, stride);
+			auto outside = _mm_or_si128(_mm_cmpgt_epi64(minValues, values), _mm_cmpgt_epi64(values, maxValues));
+			auto mask = ~_mm_movemask_pd(_mm_castsi128_pd(outside)) & 0x3;
+			selection.SetMask(i, (unsigned int)mask);
+		}
+		return i;
+	}
+
+	TARGET_SSE size_t BetweenFloatSse(const unsigned char* field, size_t stride, size_t count, float min, float max, SelectionBitmap& selection)
+	{
+		auto minValues = _mm_set1_ps(min);
+		auto maxValues = _mm_set1_ps(max);
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			auto values = _mm_castsi128_ps(LoadDwords(field + i * stride, stride));
+			auto inside = _mm_and_ps(_mm_cmpge_ps(values, minValues), _mm_cmple_ps(values, maxValues));
+			selection.SetMask(i, (unsigned int)_mm_movemask_ps(inside));
+		}
+		return i;
+	}
+
+	TARGET_SSE size_t BetweenDoubleSse(const unsigned char* field, size_t stride, size_t count, double min, double max, SelectionBitmap& selection)
+	{
+		auto minValues = _mm_set1_pd(min);
+		auto maxValues = _mm_set1_pd(max);
+		size_t i = 0;
+		for (; i + 2 <= count; i += 2)
+		{
+			auto values = _mm_castsi128_pd(LoadQwords(field + i * stride, stride));
+			auto inside = _mm_and_pd(_mm_cmpge_pd(values, minValues), _mm_cmple_pd(values, maxValues));
+			selection.SetMask(i, (unsigned int)_mm_movemask_pd(inside));
+		}
+		return i;
+	}
+
+	TARGET_SSE int CompareBytesSse(const unsigned char* a, const unsigned char* b, size_t length)
+	{
+		size_t i = 0;
+		for (; i + 16 <= length; i += 16)
+		{
+			auto equal = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i)), _mm_loadu_si128((const __m128i*)(b + i)));
+			auto different = ~(unsigned int)_mm_movemask_epi8(equal) & 0xFFFF;
+			if (different != 0)
+			{
+				auto j = i + countr_zero(different);
+				return (int)a[j] - (int)b[j];
+			}
+		}
+		return memcmp(a + i, b + i, length - i);
+	}
+
+#endif
+
+	// ------------------------------------------------ Dispatch ------------------------------------------------
+
+	size_t EqualsDword(SimdLevel level, const unsigned char* field, size_t stride, size_t count, unsigned int value, SelectionBitmap& selection)
+	{
+#ifdef KERNELS_X86
+		switch (level)
+		{
+		case SimdLevel::AVX2:
+			return EqualsDwordAvx2(field, stride, count, value, selection);
+		case SimdLevel::SSE:
+			return EqualsDwordSse(field, stride, count, value, selection);
+		default:
+			break;
+		}
+#endif
+		return 0;
+	}
+
+	size_t EqualsQword(SimdLevel level, const unsigned char* field, size_t stride, size_t count, unsigned long long value, SelectionBitmap& selection)
+	{
+#ifdef KERNELS_X86
+		switch (level)
+		{
+		case SimdLevel::AVX2:
+			return EqualsQwordAvx2(field, stride, count, value, selection);
+		case SimdLevel::SSE:
+			return EqualsQwordSse(field, stride, count, value, selection);
+		default:
+			break;
+		}
+#endif
+		return 0;
+	}
+
+	size_t BetweenVector(SimdLevel level, const unsigned char* field, size_t stride, size_t count, int min, int max, SelectionBitmap& selection)
+	{
+#ifdef KERNELS_X86
+		switch (level)
+		{
+		case SimdLevel::AVX2:
+			return BetweenInt32Avx2(field, stride, count, min, max, selection);
+		case SimdLevel::SSE:
+			return BetweenInt32Sse(field, stride, count, min, max, selection);
+		default:
+			break;
+		}
+#endif
+		return 0;
+	}
+
+	size_t BetweenVector(SimdLevel level, const unsigned char* field, size_t stride, size_t count, long long min, long long max, SelectionBitmap& selection)
+	{
+#ifdef KERNELS_X86
+		switch (level)
+		{
+		case SimdLevel::AVX2:
+			return BetweenInt64Avx2(field, stride, count, min, max, selection);
+		case SimdLevel::SSE:
+			return BetweenInt64Sse(field, stride, count, min, max, selection);
+		default:
+			break;
+		}
+#endif
+		return 0;
+	}
+
+	size_t BetweenVector(SimdLevel level, const unsigned char* field, size_t stride, size_t count, float min, float max, SelectionBitmap& selection)
+	{
+#ifdef KERNELS_X86
+		switch (level)
+		{
+		case SimdLevel::AVX2:
+			return BetweenFloatAvx2(field, stride, count, min, max, selection);
+		case SimdLevel::SSE:
+			return BetweenFloatSse(field, stride, count, min, max, selection);
+		default:
+			break;
+		}
+#endif
+		return 0;
+	}
+
+	size_t BetweenVector(SimdLevel level, const unsigned char* field, size_t stride, size_t count, double min, double max, SelectionBitmap& selection)
+	{
+#ifdef KERNELS_X86
+		switch (level)
+		{
+		case SimdLevel::AVX2:
+			return BetweenDoubleAvx2(field, stride, count, min, max, selection);
+		case SimdLevel::SSE:
+			return BetweenDoubleSse(field, stride, count, min, max, selection);
+		default:
+			break;
+		}
+#endif
+		return 0;
+	}
+
+	template<typename T>
+	void BetweenTyped(SimdLevel level, const unsigned char* field, size_t stride, size_t count, span<const unsigned char> min, span<const unsigned char> max, SelectionBitmap& selection)
+	{
+		auto minValue = Load<T>(min.data());
+		auto maxValue = Load<T>(max.data());
+		auto done = BetweenVector(level, field, stride, count, minValue, maxValue, selection);
+		BetweenScalar(field, stride, done, count, minValue, maxValue, selection);
+	}
+
+	template<typename T>
+	void LessTyped(SimdLevel level, const unsigned char* field, size_t stride, size_t count, span<const unsigned char> value, bool inclusive, SelectionBitmap& selection)
+	{
+		// The range from the lowest value of the type, so the Between kernels do the work
+		auto minValue = numeric_limits<T>::has_infinity ? -numeric_limits<T>::infinity() : numeric_limits<T>::lowest();
+		auto maxValue = Load<T>(value.data());
+		if (!inclusive)
+		{
+			if (maxValue == minValue)
+			{
+				return;
+			}
+			if constexpr (is_floating_point_v<T>)
+			{
+				maxValue = nextafter(maxValue, minValue);
+			}
+			else
+			{
+				maxValue--;
+			}
+		}
+		auto done = BetweenVector(level, field, stride, count, minValue, maxValue, selection);
+		BetweenScalar(field, stride, done, count, minValue, maxValue, selection);
+	}
+
+	int CompareBytes(SimdLevel level, const unsigned char* a, const unsigned char* b, size_t length)
+	{
+#ifdef KERNELS_X86
+		switch (level)
+		{
+		case SimdLevel::AVX2:
+			return CompareBytesAvx2(a, b, length);
+		case SimdLevel::SSE:
+			return CompareBytesSse(a, b, length);
+		default:
+			break;
+		}
+#endif
+		return memcmp(a, b, length);
+	}
+}
+
+void PredicateKernels::Equals(const Column& column, span<const unsigned char> records, size_t recordSize, span<const unsigned char> value, SelectionBitmap& selection)
+{
+	if (value.size() != column.Length)
+	{
+		throw runtime_error("value.size() != column.getLength()");
+	}
+
+	auto count = records.size() / recordSize;
+	selection.Reset(count);
+	auto field = records.data() + column.Offset;
+	auto level = GetLevel();
+
+	// Equality is bytewise (see Column::Equals), so 4 and 8 bytes values of any type compare as integers
+	if (column.Length == sizeof(unsigned int))
+	{
+		auto target = Load<unsigned int>(value.data());
+		auto done = EqualsDword(level, field, recordSize, count, target, selection);
+		EqualsScalar(field, recordSize, done, count, target, selection);
+		return;
+	}
+	if (column.Length == sizeof(unsigned long long))
+	{
+		auto target = Load<unsigned long long>(value.data());
+		auto done = EqualsQword(level, field, recordSize, count, target, selection);
+		EqualsScalar(field, recordSize, done, count, target, selection);
+		return;
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		if (CompareBytes(level, field + i * recordSize, value.data(), column.Length) == 0)
+		{
+			selection.Set(i);
+		}
+	}
+}
+
+void PredicateKernels::Between(const Column& column, span<const unsigned char> records, size_t recordSize, span<const unsigned char> min, span<const unsigned char> max, SelectionBitmap& selection)
+{
+	if (min.size() != column.Length || max.size() != column.Length)
+	{
+		throw runtime_error("a.size() != b.size()");
+	}
+
+	auto count = records.size() / recordSize;
+	selection.Reset(count);
+	auto field = records.data() + column.Offset;
+	auto level = GetLevel();
+
+	if (column.ArraySize == 1)
+	{
+		switch (column.Type)
+		{
+		case ColumnType::INT32:
+			BetweenTyped<int>(level, field, recordSize, count, min, max, selection);
+			return;
+		case ColumnType::INT64:
+			BetweenTyped<long long>(level, field, recordSize, count, min, max, selection);
+			return;
+		case ColumnType::FLOAT:
+			BetweenTyped<float>(level, field, recordSize, count, min, max, selection);
+			return;
+		case ColumnType::DOUBLE:
+			BetweenTyped<double>(level, field, recordSize, count, min, max, selection);
+			return;
+		default:
+			break;
+		}
+	}
+
+	if (column.Type == +ColumnType::CHAR)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			auto value = field + i * recordSize;
+			if (CompareBytes(level, value, min.data(), column.Length) >= 0 && CompareBytes(level, value, max.data(), column.Length) <= 0)
+			{
+				selection.Set(i);
+			}
+		}
+		return;
+	}
+
+	// Arrays of numbers compare like Column::Compare does
+	auto minValue = span<unsigned char>((unsigned char*)min.data(), min.size());
+	auto maxValue = span<unsigned char>((unsigned char*)max.data(), max.size());
+	for (size_t i = 0; i < count; i++)
+	{
+		auto value = span<unsigned char>((unsigned char*)field + i * recordSize, column.Length);
+		if (Column::Compare(column, value, minValue) >= 0 && Column::Compare(column, value, maxValue) <= 0)
+		{
+			selection.Set(i);
+		}
+	}
+}
+
+void PredicateKernels::Less(const Column& column, span<const unsigned char> records, size_t recordSize, span<const unsigned char> value, bool inclusive, SelectionBitmap& selection)
+{
+	if (value.size() != column.Length)
+	{
+		throw runtime_error("value.size() != column.getLength()");
+	}
+
+	auto count = records.size() / recordSize;
+	selection.Reset(count);
+	auto field = records.data() + column.Offset;
+	auto level = GetLevel();
+
+	if (column.ArraySize == 1)
+	{
+		switch (column.Type)
+		{
+		case ColumnType::INT32:
+			LessTyped<int>(level, field, recordSize, count, value, inclusive, selection);
+			return;
+		case ColumnType::INT64:
+			LessTyped<long long>(level, field, recordSize, count, value, inclusive, selection);
+			return;
+		case ColumnType::FLOAT:
+			LessTyped<float>(level, field, recordSize, count, value, inclusive, selection);
+			return;
+		case ColumnType::DOUBLE:
+			LessTyped<double>(level, field, recordSize, count, value, inclusive, selection);
+			return;
+		default:
+			break;
+		}
+	}
+
+	auto maxCompare = inclusive ? 0 : -1;
+	if (column.Type == +ColumnType::CHAR)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			if (CompareBytes(level, field + i * recordSize, value.data(), column.Length) <= maxCompare)
+			{
+				selection.Set(i);
+			}
+		}
+		return;
+	}
+
+	auto maxValue = span<unsigned char>((unsigned char*)value.data(), value.size());
+	for (size_t i = 0; i < count; i++)
+	{
+		auto fieldValue = span<unsigned char>((unsigned char*)field + i * recordSize, column.Length);
+		if (Column::Compare(column, fieldValue, maxValue) <= maxCompare)
+		{
+			selection.Set(i);
+		}
+	}
+}
+
+SimdLevel PredicateKernels::GetLevel()
+{
+	return CurrentLevel();
+}
+
+void PredicateKernels::SetLevel(SimdLevel level)
+{
+	CurrentLevel() = level._to_integral() < GetSupportedLevel()._to_integral() ? level : GetSupportedLevel();
+}
+
+SimdLevel PredicateKernels::GetSupportedLevel()
+{
+	static SimdLevel supported = DetectLevel();
+	return supported;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "Column.h"
+#include "SelectionBitmap.h"
+#include "SimdLevel.h"
+
+/*
+	Evaluates a predicate on one column over all the records of a block at once and returns the
+	matching ones as a selection bitmap (bit i = record i).
+	records are the bytes of the records laid back to back, recordSize bytes each (Block::GetRecords).
+	The type is dispatched once per call, not per record. INT32/FLOAT and INT64/DOUBLE columns are
+	gathered 8/4 values at a time with AVX2 (4/2 with SSE), CHAR columns are compared 32/16 bytes at a time.
+	Results are the same as Column::Equals/Compare: equality is bytewise and ranges include both ends.
+*/
+class PredicateKernels
+{
+public:
+	static void Equals(const Column& column, span<const unsigned char> records, size_t recordSize, span<const unsigned char> value, SelectionBitmap& selection);
+	static void Between(const Column& column, span<const unsigned char> records, size_t recordSize, span<const unsigned char> min, span<const unsigned char> max, SelectionBitmap& selection);
+	// Values below value, or up to it when inclusive
+	static void Less(const Column& column, span<const unsigned char> records, size_t recordSize, span<const unsigned char> value, bool inclusive, SelectionBitmap& selection);
+
+	// Best level supported by the CPU, unless lowered by SetLevel
+	static SimdLevel GetLevel();
+	// Caps the instruction set used (e.g. SCALAR to compare results), clamped to what the CPU supports
+	static void SetLevel(SimdLevel level);
+	static SimdLevel GetSupportedLevel();
+};
@@ -0,0 +1,63 @@
+#include "pch.h"
+#include "Projection.h"
+
+Projection::Projection(const Schema* schema, const vector<unsigned int>& columnIds) :
+	m_Schema(make_unique<Schema>())
+{
+	// The Id column is added by the Schema constructor
+	m_Segments.push_back({ schema->GetOffset(0), 0, schema->GetColumn(0).Length });
+	for (auto columnId : columnIds)
+	{
+		if (columnId >= schema->GetColumnsCount())
+		{
+			throw runtime_error("Invalid column " + to_string(columnId));
+		}
+		if (columnId == 0)
+		{
+			continue;
+		}
+
+		auto& column = schema->GetColumn(columnId);
+		auto offset = m_Schema->GetSize();
+		m_Schema->AddColumn(column.Name, column.Type, column.ArraySize);
+
+		// Columns next to each other in the record are copied together
+		auto& last = m_Segments.back();
+		if (last.SourceOffset + last.Length == column.Offset)
+		{
+			last.Length += column.Length;
+		}
+		else
+		{
+			m_Segments.push_back({ column.Offset, offset, column.Length });
+		}
+	}
+}
+
+Projection::Projection(const Schema* schema, const vector<string>& columnNames) :
+	Projection(schema, GetColumnIds(schema, columnNames))
+{
+}
+
+Schema* Projection::GetSchema() const
+{
+	return m_Schema.get();
+}
+
+void Projection::Copy(span<const unsigned char> record, span<unsigned char> destination) const
+{
+	for (auto& segment : m_Segments)
+	{
+		memcpy(destination.data() + segment.Offset, record.data() + segment.SourceOffset, segment.Length);
+	}
+}
+
+vector<unsigned int> Projection::GetColumnIds(const Schema* schema, const vector<string>& columnNames)
+{
+	auto columnIds = vector<unsigned int>();
+	for (auto& columnName : columnNames)
+	{
+		columnIds.push_back(schema->GetColumnId(columnName));
+	}
+	return columnIds;
+}
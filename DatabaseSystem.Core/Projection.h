@@ -0,0 +1,38 @@
+#pragma once
+#include "Schema.h"
+
+/*
+	Subset of the columns of a schema, for the selects that only need a few of them. The projected schema
+	lays the chosen columns back to back (offsets computed once here), so a projected row takes only their
+	bytes and Copy moves them out of a record with one memcpy per run of adjacent columns.
+	The Id column is always kept first, the rows of every schema start with it.
+	Result sets built with a projection use its schema, the projection must outlive them.
+*/
+class Projection
+{
+public:
+	Projection(const Schema* schema, const vector<unsigned int>& columnIds);
+	Projection(const Schema* schema, const vector<string>& columnNames);
+
+	Projection(const Projection&) = delete;
+	Projection& operator=(const Projection&) = delete;
+	Projection(Projection&&) noexcept = default;
+	Projection& operator=(Projection&&) noexcept = default;
+
+	Schema* GetSchema() const;
+	// Copies the chosen columns of a record of the source schema into destination, that must hold the projected size
+	void Copy(span<const unsigned char> record, span<unsigned char> destination) const;
+
+private:
+	struct Segment
+	{
+		unsigned int SourceOffset;
+		unsigned int Offset;
+		unsigned int Length;
+	};
+
+	unique_ptr<Schema> m_Schema;
+	vector<Segment> m_Segments;
+
+	static vector<unsigned int> GetColumnIds(const Schema* schema, const vector<string>& columnNames);
+};
@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "Record.h"
+#include "CsvLoader.h"
 
 
 Record::Record(Schema* schema) : m_Schema(schema)
@@ -12,6 +13,11 @@ vector<unsigned char>* Record::GetData()
 	return &m_Data;
 }
 
+const vector<unsigned char>* Record::GetData() const
+{
+	return &m_Data;
+}
+
 void Record::SetData(size_t index, unsigned char value)
 {
 	m_Data[index] = value;
@@ -28,30 +34,17 @@ void Record::Write(ostream& out) {
 
 vector<Record> Record::LoadFromCsv(Schema& schema, string path, unsigned long long lines) {
 	auto result = vector<Record>();
+	auto recordSize = schema.GetSize();
 
-	ifstream infile(path);
-
-	string line;
-	
-	// Skip first line
-	getline(infile, line);
-	auto linesRead = 0ull;
-	while (getline(infile, line) && (lines < 0 || linesRead < lines))
+	auto loader = CsvLoader(&schema);
+	loader.Load(path, [&](span<const unsigned char> records)
 	{
-		linesRead++;
-		auto record = Record(&schema);
-		auto lineStream = istringstream(line);
-
-		int columnId = 1;
-		string cell;
-		while (getline(lineStream, cell, ','))
+		for (size_t offset = 0; offset < records.size(); offset += recordSize)
 		{
-			auto currentColumn = schema.GetColumn(columnId);
-			auto columnDataSpan = schema.GetValue(record.GetData(), columnId);
-			Column::Parse(currentColumn, columnDataSpan, cell);
-			columnId++;
+			auto record = Record(&schema);
+			memcpy(record.GetData()->data(), records.data() + offset, recordSize);
+			result.push_back(move(record));
 		}
-		result.push_back(record);
-	}
+	}, lines);
 	return result;
 }
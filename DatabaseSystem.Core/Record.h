@@ -6,6 +6,7 @@ class Record
 public:
 	Record(Schema* schema);
 	vector<unsigned char>* GetData();
+	const vector<unsigned char>* GetData() const;
 	void SetData(size_t index, unsigned char value);
 
 	unsigned long long getId() const;
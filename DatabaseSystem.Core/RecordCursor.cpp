@@ -0,0 +1,98 @@
+#include "pch.h"
+#include "RecordCursor.h"
+
+RecordCursor::RecordCursor(Schema* schema, unique_ptr<Block> buffer, NextBlockFunction nextBlock, FilterFunction filter) :
+	m_Schema(schema),
+	m_Buffer(move(buffer)),
+	m_NextBlock(nextBlock),
+	m_Filter(filter),
+	m_Block(nullptr),
+	m_RecordNumber(0),
+	m_ReadBlocksCount(0),
+	m_Finished(false)
+{
+}
+
+bool RecordCursor::MoveNext()
+{
+	if (m_Finished)
+	{
+		return false;
+	}
+
+	while (m_Block == nullptr || !MoveNextInBlock())
+	{
+		m_Block = m_NextBlock(m_Buffer.get());
+		if (m_Block == nullptr)
+		{
+			m_Finished = true;
+			return false;
+		}
+		m_ReadBlocksCount++;
+
+		auto recordsCount = m_Block->GetRecordsCount();
+		if (m_Filter != nullptr)
+		{
+			m_Filter(m_Block, m_Selection);
+		}
+		else
+		{
+			m_Selection.Reset(recordsCount);
+			for (size_t i = 0; i < recordsCount; i++)
+			{
+				m_Selection.Set(i);
+			}
+		}
+		// Starts before the first record
+		m_RecordNumber = (size_t)-1;
+	}
+	return true;
+}
+
+bool RecordCursor::MoveNextInBlock()
+{
+	auto records = m_Block->GetRecords();
+	auto recordSize = m_Block->GetRecordSize();
+	for (m_RecordNumber++; m_RecordNumber < m_Selection.GetSize(); m_RecordNumber++)
+	{
+		if (!m_Selection.Test(m_RecordNumber))
+		{
+			continue;
+		}
+
+		unsigned long long id;
+		memcpy(&id, records.data() + m_RecordNumber * recordSize, sizeof(id));
+		if (id != (unsigned long long)-1)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+RecordView RecordCursor::GetCurrent() const
+{
+	auto recordSize = m_Block->GetRecordSize();
+	return RecordView(m_Schema, m_Block->GetRecords().subspan(m_RecordNumber * recordSize, recordSize));
+}
+
+void RecordCursor::CopyCurrent(span<unsigned char> destination, const Projection* projection) const
+{
+	if (projection != nullptr)
+	{
+		auto recordSize = m_Block->GetRecordSize();
+		projection->Copy(m_Block->GetRecords().subspan(m_RecordNumber * recordSize, recordSize), destination);
+		return;
+	}
+	GetCurrent().CopyTo(destination);
+}
+
+size_t RecordCursor::GetRecordNumber() const
+{
+	return m_RecordNumber;
+}
+
+unsigned long long RecordCursor::GetReadBlocksCount() const
+{
+	return m_ReadBlocksCount;
+}
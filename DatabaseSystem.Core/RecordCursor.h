@@ -0,0 +1,50 @@
+#pragma once
+#include <functional>
+#include "Block.h"
+#include "RecordView.h"
+#include "SelectionBitmap.h"
+#include "Projection.h"
+
+/*
+	Streams the records of a query one block at a time, so a result of any size takes the memory
+	of a single block. The views returned by GetCurrent point into the block being visited and are
+	valid until MoveNext leaves it. Deleted records are skipped.
+	The record manager decides which blocks are visited (NextBlockFunction) and which of their records
+	match (FilterFunction, e.g. a PredicateKernels call). Changing the table while a cursor is open
+	invalidates it.
+*/
+class RecordCursor
+{
+public:
+	// Returns the next block to visit, either loaded into buffer or a block the manager holds, nullptr at the end
+	using NextBlockFunction = function<Block*(Block* buffer)>;
+	// Sets the bits of the records of the block that match
+	using FilterFunction = function<void(Block* block, SelectionBitmap& selection)>;
+
+	RecordCursor(Schema* schema, unique_ptr<Block> buffer, NextBlockFunction nextBlock, FilterFunction filter = nullptr);
+
+	RecordCursor(const RecordCursor&) = delete;
+	RecordCursor& operator=(const RecordCursor&) = delete;
+
+	bool MoveNext();
+	RecordView GetCurrent() const;
+	// Materializes the current record (only the columns of projection, if given) into a caller provided buffer
+	void CopyCurrent(span<unsigned char> destination, const Projection* projection = nullptr) const;
+	// Position of the current record in its block
+	size_t GetRecordNumber() const;
+
+	unsigned long long GetReadBlocksCount() const;
+
+private:
+	Schema* m_Schema;
+	unique_ptr<Block> m_Buffer;
+	NextBlockFunction m_NextBlock;
+	FilterFunction m_Filter;
+	Block* m_Block;
+	SelectionBitmap m_Selection;
+	size_t m_RecordNumber;
+	unsigned long long m_ReadBlocksCount;
+	bool m_Finished;
+
+	bool MoveNextInBlock();
+};
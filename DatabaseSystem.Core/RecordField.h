@@ -0,0 +1,52 @@
+#pragma once
+#include "Column.h"
+
+/*
+	Typed access to a field of a POD record type laid out exactly like its schema (e.g. FixedRecord).
+	The offset and the size are compile time constants, so reading a field of a record kept in a block
+	or in a Record is a single load, with no lookup in the schema.
+	Use the RECORD_FIELD macro to declare one: RECORD_FIELD(FixedRecord, Age)::Get(data).
+*/
+template<typename TRecord, typename TValue, size_t FieldOffset>
+struct RecordField
+{
+	static constexpr size_t Offset = FieldOffset;
+	static constexpr size_t Length = sizeof(TValue);
+
+	static_assert(is_trivially_copyable_v<TRecord>, "Records must be plain data");
+	static_assert(Offset + Length <= sizeof(TRecord), "Field out of the record");
+
+	// Arrays (CHAR columns) are only reachable through GetSpan
+	template<typename T = TValue> requires (!is_array_v<T>)
+	static T Get(const unsigned char* record)
+	{
+		// The record may be packed, do not assume the field is aligned
+		T value;
+		memcpy(&value, record + Offset, Length);
+		return value;
+	}
+
+	template<typename T = TValue> requires (!is_array_v<T>)
+	static void Set(unsigned char* record, const T& value)
+	{
+		memcpy(record + Offset, &value, Length);
+	}
+
+	static span<unsigned char> GetSpan(unsigned char* record)
+	{
+		return span<unsigned char>(record + Offset, Length);
+	}
+
+	static span<unsigned char> GetSpan(span<unsigned char> record)
+	{
+		return record.subspan(Offset, Length);
+	}
+
+	// Checks the field is where the schema column says it is
+	static bool Matches(const Column& column)
+	{
+		return column.Offset == Offset && column.Length == Length;
+	}
+};
+
+#define RECORD_FIELD(TRecord, Field) RecordField<TRecord, decltype(TRecord::Field), offsetof(TRecord, Field)>
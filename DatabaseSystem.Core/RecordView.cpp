@@ -0,0 +1,54 @@
+#include "pch.h"
+#include "RecordView.h"
+
+RecordView::RecordView() : m_Schema(nullptr)
+{
+}
+
+RecordView::RecordView(Schema* schema, span<const unsigned char> data) : m_Schema(schema), m_Data(data)
+{
+}
+
+unsigned long long RecordView::getId() const
+{
+	unsigned long long id;
+	memcpy(&id, m_Data.data(), sizeof(id));
+	return id;
+}
+
+Schema* RecordView::GetSchema() const
+{
+	return m_Schema;
+}
+
+span<const unsigned char> RecordView::GetData() const
+{
+	return m_Data;
+}
+
+span<const unsigned char> RecordView::GetValue(unsigned int columnId) const
+{
+	auto& column = m_Schema->GetColumn(columnId);
+	return m_Data.subspan(column.Offset, column.Length);
+}
+
+void RecordView::CopyTo(span<unsigned char> destination) const
+{
+	if (destination.size() < m_Data.size())
+	{
+		throw runtime_error("Destination smaller than the record");
+	}
+	memcpy(destination.data(), m_Data.data(), m_Data.size());
+}
+
+Record RecordView::ToRecord() const
+{
+	auto record = Record(m_Schema);
+	CopyTo(*record.GetData());
+	return record;
+}
+
+void RecordView::Write(ostream& out) const
+{
+	ToRecord().Write(out);
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "Record.h"
+
+/*
+	Non owning view of a record inside a block (or any other buffer).
+	It is only valid while the memory it points to is, for a RecordCursor that is until the
+	cursor moves to the next block. Copy the bytes out (CopyTo/ToRecord) to keep the record.
+*/
+class RecordView
+{
+public:
+	RecordView();
+	RecordView(Schema* schema, span<const unsigned char> data);
+
+	unsigned long long getId() const;
+	Schema* GetSchema() const;
+	span<const unsigned char> GetData() const;
+	span<const unsigned char> GetValue(unsigned int columnId) const;
+
+	// Copies the record bytes into destination, that must hold at least the schema size
+	void CopyTo(span<unsigned char> destination) const;
+	Record ToRecord() const;
+	void Write(ostream& out) const;
+
+	template <typename T>
+	const T* As() const
+	{
+		return (const T*)m_Data.data();
+	}
+
+private:
+	Schema* m_Schema;
+	span<const unsigned char> m_Data;
+};
@@ -0,0 +1,130 @@
+#include "pch.h"
+#include "ResultSet.h"
+#include <algorithm>
+
+ResultSet::Iterator::Iterator(const ResultSet* resultSet, size_t index) : m_ResultSet(resultSet), m_Index(index)
+{
+}
+
+RecordView ResultSet::Iterator::operator*() const
+{
+	return (*m_ResultSet)[m_Index];
+}
+
+ResultSet::Iterator& ResultSet::Iterator::operator++()
+{
+	m_Index++;
+	return *this;
+}
+
+ResultSet::Iterator ResultSet::Iterator::operator++(int)
+{
+	auto previous = *this;
+	m_Index++;
+	return previous;
+}
+
+bool ResultSet::Iterator::operator==(const Iterator& other) const
+{
+	return m_ResultSet == other.m_ResultSet && m_Index == other.m_Index;
+}
+
+bool ResultSet::Iterator::operator!=(const Iterator& other) const
+{
+	return !(*this == other);
+}
+
+ResultSet::ResultSet(Schema* schema) :
+	m_Schema(schema),
+	m_RecordSize(schema->GetSize()),
+	m_RecordsPerChunk(0),
+	m_Count(0)
+{
+	if (m_RecordSize == 0)
+	{
+		throw runtime_error("Invalid schema size");
+	}
+	// Rows never straddle two chunks, a chunk holds at least one of them
+	m_RecordsPerChunk = max((size_t)1, MinChunkSize / m_RecordSize);
+}
+
+span<unsigned char> ResultSet::Append()
+{
+	auto chunkStart = m_Chunks.size() > 1 ? m_ChunkEnds[m_Chunks.size() - 2] : 0;
+	if (m_Chunks.empty() || m_Count - chunkStart == m_RecordsPerChunk)
+	{
+		m_Chunks.push_back(make_unique<unsigned char[]>(m_RecordsPerChunk * m_RecordSize));
+		m_ChunkEnds.push_back(m_Count);
+		chunkStart = m_Count;
+	}
+
+	auto record = span<unsigned char>(m_Chunks.back().get() + (m_Count - chunkStart) * m_RecordSize, m_RecordSize);
+	m_Count++;
+	m_ChunkEnds.back() = m_Count;
+	return record;
+}
+
+void ResultSet::Append(span<const unsigned char> data)
+{
+	auto record = Append();
+	memcpy(record.data(), data.data(), min(data.size(), m_RecordSize));
+}
+
+void ResultSet::Append(ResultSet&& other)
+{
+	if (other.m_RecordSize != m_RecordSize)
+	{
+		throw runtime_error("Result sets of different schemas");
+	}
+
+	for (size_t i = 0; i < other.m_Chunks.size(); i++)
+	{
+		m_Chunks.push_back(move(other.m_Chunks[i]));
+		m_ChunkEnds.push_back(m_Count + other.m_ChunkEnds[i]);
+	}
+	m_Count += other.m_Count;
+	other.Clear();
+}
+
+void ResultSet::Clear()
+{
+	m_Chunks.clear();
+	m_ChunkEnds.clear();
+	m_Count = 0;
+}
+
+Schema* ResultSet::GetSchema() const
+{
+	return m_Schema;
+}
+
+size_t ResultSet::size() const
+{
+	return m_Count;
+}
+
+bool ResultSet::empty() const
+{
+	return m_Count == 0;
+}
+
+RecordView ResultSet::operator[](size_t index) const
+{
+	if (index >= m_Count)
+	{
+		throw runtime_error("Index out of range");
+	}
+	auto chunk = (size_t)(upper_bound(m_ChunkEnds.begin(), m_ChunkEnds.end(), index) - m_ChunkEnds.begin());
+	auto chunkStart = chunk > 0 ? m_ChunkEnds[chunk - 1] : 0;
+	return RecordView(m_Schema, span<const unsigned char>(m_Chunks[chunk].get() + (index - chunkStart) * m_RecordSize, m_RecordSize));
+}
+
+ResultSet::Iterator ResultSet::begin() const
+{
+	return Iterator(this, 0);
+}
+
+ResultSet::Iterator ResultSet::end() const
+{
+	return Iterator(this, m_Count);
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "RecordView.h"
+
+/*
+	Materialized result of a query. The rows are stored back to back (schema size bytes each) in
+	large chunks taken from a bump allocator, so a query with millions of matches makes a handful
+	of allocations and all of them are released at once when the set is destroyed.
+	A ResultSet owns its rows and can only be moved. The views it hands out are valid while the
+	set is alive and not cleared. Sets built apart (e.g. one per scan thread) are joined by moving
+	their chunks, so a chunk may be left partly filled.
+*/
+class ResultSet
+{
+public:
+	class Iterator
+	{
+	public:
+		using iterator_category = forward_iterator_tag;
+		using value_type = RecordView;
+		using difference_type = ptrdiff_t;
+		using pointer = void;
+		using reference = RecordView;
+
+		Iterator(const ResultSet* resultSet, size_t index);
+
+		RecordView operator*() const;
+		Iterator& operator++();
+		Iterator operator++(int);
+		bool operator==(const Iterator& other) const;
+		bool operator!=(const Iterator& other) const;
+
+	private:
+		const ResultSet* m_ResultSet;
+		size_t m_Index;
+	};
+
+	ResultSet(Schema* schema);
+
+	ResultSet(const ResultSet&) = delete;
+	ResultSet& operator=(const ResultSet&) = delete;
+	ResultSet(ResultSet&&) noexcept = default;
+	ResultSet& operator=(ResultSet&&) noexcept = default;
+
+	// Reserves the next row and returns its (zeroed) bytes to be filled by the caller
+	span<unsigned char> Append();
+	void Append(span<const unsigned char> data);
+	// Moves the rows of other, which must have the same schema, to the end of this set without copying them
+	void Append(ResultSet&& other);
+	void Clear();
+
+	Schema* GetSchema() const;
+	size_t size() const;
+	bool empty() const;
+	RecordView operator[](size_t index) const;
+
+	Iterator begin() const;
+	Iterator end() const;
+
+private:
+	static const size_t MinChunkSize = 64 * 1024;
+
+	Schema* m_Schema;
+	size_t m_RecordSize;
+	size_t m_RecordsPerChunk;
+	vector<unique_ptr<unsigned char[]>> m_Chunks;
+	// Number of rows up to the end of each chunk
+	vector<size_t> m_ChunkEnds;
+	size_t m_Count;
+};
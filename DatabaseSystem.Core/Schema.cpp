@@ -11,8 +11,9 @@ Schema::Schema() : m_Size(0), m_Columns(vector<Column>())
 void Schema::AddColumn(string name, ColumnType type, unsigned int arraySize)
 {
 	auto newColumn = Column(name, type, arraySize);
+	newColumn.Offset = m_Size;
 	m_Columns.push_back(newColumn);
-	m_Size += newColumn.GetLength();
+	m_Size += newColumn.Length;
 }
 
 unsigned int Schema::GetSize() const
@@ -20,7 +21,12 @@ unsigned int Schema::GetSize() const
 	return m_Size;
 }
 
-Column Schema::GetColumn(unsigned int columnId)
+size_t Schema::GetColumnsCount() const
+{
+	return m_Columns.size();
+}
+
+const Column& Schema::GetColumn(unsigned int columnId) const
 {
 	return m_Columns[columnId];
 }
@@ -37,22 +43,26 @@ unsigned int Schema::GetColumnId(string columnName) const
 	throw runtime_error("Invalid column " + columnName);
 }
 
-span<unsigned char> Schema::GetValue(vector<unsigned char>* data, unsigned int columnId)
+unsigned int Schema::GetOffset(unsigned int columnId) const
+{
+	return m_Columns[columnId].Offset;
+}
+
+span<unsigned char> Schema::GetValue(vector<unsigned char>* data, unsigned int columnId) const
+{
+	auto &column = m_Columns[columnId];
+	return span(data->data() + column.Offset, column.Length);
+}
+
+span<unsigned char> Schema::GetValue(span<unsigned char> data, unsigned int columnId) const
 {
-	size_t offset = 0;
-	for (size_t i = 0; i < columnId; i++)
-	{
-		auto &column = m_Columns[i];
-		offset += column.GetLength();
-	}
 	auto &column = m_Columns[columnId];
-	return span(&data->data()[offset], column.GetLength());
+	return data.subspan(column.Offset, column.Length);
 }
 
 void Schema::Write(ostream& out, vector<unsigned char>* data)
 {
 	out << "{" << endl;
-	size_t offset = 0;
 	for (size_t i = 0; i < m_Columns.size(); i++)
 	{
 		auto& column = m_Columns[i];
@@ -61,45 +71,43 @@ void Schema::Write(ostream& out, vector<unsigned char>* data)
 			out << "(" << column.ArraySize << ")";
 		}
 		out << "]" << " = ";
-		auto columnValue = span(&data->data()[offset], column.GetLength());
-		Column::WriteValue(out, column, columnValue);
+		Column::WriteValue(out, column, GetValue(data, i));
 		out << "," << endl;
-
-		offset += column.GetLength();
 	}
 	out << '\b' << "}";
 }
 
 void Schema::Serialize(iostream& dst)
 {
-	auto size = m_Columns.size();
-	dst << size << endl;
+	WriteField(dst, (unsigned int)m_Columns.size());
 	for (auto &column : m_Columns)
 	{
-		dst << column.Name << "," << (int)column.Type << "," << column.ArraySize << endl;
+		WriteString(dst, column.Name);
+		WriteField(dst, (int)column.Type);
+		WriteField(dst, column.ArraySize);
 	}
 }
 
 void Schema::Deserialize(iostream& src)
 {
-	size_t size;
-	src >> size;
-	string line;
-	getline(src, line);
-	for (size_t i = 0; i < size; i++)
-	{
-		string line;
-		getline(src, line);
+	// The stored columns already include the Id one
+	m_Columns.clear();
+	m_Size = 0;
 
-		vector<string> row;
-		string word;
-		stringstream str(line);
-		while (getline(str, word, ','))
-			row.push_back(word);
+	unsigned int size;
+	ReadField(src, size);
+	for (unsigned int i = 0; i < size; i++)
+	{
+		auto name = ReadString(src);
+		int type;
+		unsigned int arraySize;
+		ReadField(src, type);
+		ReadField(src, arraySize);
 
-		if (row.size() != 3) {
-			throw runtime_error("Missing fields in schema");
+		auto columnType = ColumnType::_from_integral_nothrow(type);
+		if (!columnType) {
+			throw runtime_error("Invalid column type in schema");
 		}
-		AddColumn(row[0], ColumnType::_from_index(stoi(row[1])), stoi(row[2]));
+		AddColumn(name, *columnType, arraySize);
 	}
 }
@@ -8,9 +8,13 @@ public:
 	Schema();
 	void AddColumn(string name, ColumnType type, unsigned int arraySize = 1);
 	unsigned int GetSize() const;
-	Column GetColumn(unsigned int columnId);
+	size_t GetColumnsCount() const;
+	// Columns keep their offset in the record, so reading a value costs no more than an index
+	const Column& GetColumn(unsigned int columnId) const;
 	unsigned int GetColumnId(string columnName) const;
-	span<unsigned char> GetValue(vector<unsigned char>* data, unsigned int columnId);
+	unsigned int GetOffset(unsigned int columnId) const;
+	span<unsigned char> GetValue(vector<unsigned char>* data, unsigned int columnId) const;
+	span<unsigned char> GetValue(span<unsigned char> data, unsigned int columnId) const;
 
 	void Write(ostream& out, vector<unsigned char>* data);
 
@@ -0,0 +1,206 @@
+#include "pch.h"
+#include "SecondaryIndex.h"
+#include <numeric>
+
+SecondaryIndex::SecondaryIndex(size_t blockSize, BufferPool* bufferPool) :
+	m_Tree(blockSize, bufferPool),
+	m_ColumnId(0),
+	m_ValueOffset(0),
+	m_ReadBlocksCount(0)
+{
+}
+
+string SecondaryIndex::GetPath(string recordsPath, unsigned int columnId)
+{
+	return recordsPath + ".index" + to_string(columnId);
+}
+
+void SecondaryIndex::RemoveFiles(string recordsPath, unsigned int columnId)
+{
+	auto path = GetPath(recordsPath, columnId);
+	filesystem::remove(path);
+	filesystem::remove(path + ".nodes");
+}
+
+void SecondaryIndex::Create(string recordsPath, Schema* recordSchema, unsigned int columnId)
+{
+	m_ColumnId = columnId;
+	m_ValueOffset = recordSchema->GetOffset(columnId);
+
+	// Id, value, block id, record number in block
+	auto& column = recordSchema->GetColumn(columnId);
+	auto entrySchema = Schema();
+	entrySchema.AddColumn(column.Name, column.Type, column.ArraySize);
+	entrySchema.AddColumn("BlockId", ColumnType::INT64);
+	entrySchema.AddColumn("RecordNumberInBlock", ColumnType::INT64);
+	m_Tree.Create(GetPath(recordsPath, columnId), &entrySchema, 1);
+}
+
+void SecondaryIndex::Open(string recordsPath, Schema* recordSchema, unsigned int columnId)
+{
+	m_ColumnId = columnId;
+	m_ValueOffset = recordSchema->GetOffset(columnId);
+	m_Tree.Open(GetPath(recordsPath, columnId));
+}
+
+void SecondaryIndex::Close()
+{
+	m_Tree.Close();
+}
+
+void SecondaryIndex::Checkpoint()
+{
+	m_Tree.Checkpoint();
+}
+
+void SecondaryIndex::SetFileAccessMode(FileAccessMode mode)
+{
+	m_Tree.SetFileAccessMode(mode);
+}
+
+void SecondaryIndex::SetWriteBack(bool enabled)
+{
+	m_Tree.SetWriteBack(enabled);
+}
+
+unsigned int SecondaryIndex::GetColumnId()
+{
+	return m_ColumnId;
+}
+
+unsigned long long SecondaryIndex::GetEntriesCount()
+{
+	return m_Tree.GetEntriesCount();
+}
+
+unsigned long long SecondaryIndex::GetReadBlocksCount() const
+{
+	return m_ReadBlocksCount;
+}
+
+void SecondaryIndex::Insert(span<const unsigned char> record, unsigned long long blockId, unsigned long long recordNumberInBlock)
+{
+	m_Tree.Insert(MakeEntry(record, blockId, recordNumberInBlock));
+}
+
+void SecondaryIndex::Remove(span<const unsigned char> record)
+{
+	auto& column = m_Tree.GetSchema()->GetColumn(1);
+	unsigned long long id;
+	memcpy(&id, record.data(), sizeof(id));
+	m_Tree.Remove(record.subspan(m_ValueOffset, column.Length), id);
+}
+
+void SecondaryIndex::AppendEntry(vector<unsigned char>& entries, span<const unsigned char> record, unsigned long long blockId, unsigned long long recordNumberInBlock)
+{
+	auto entry = MakeEntry(record, blockId, recordNumberInBlock);
+	entries.insert(entries.end(), entry.begin(), entry.end());
+}
+
+void SecondaryIndex::Load(vector<unsigned char>& entries)
+{
+	auto schema = m_Tree.GetSchema();
+	auto entrySize = (size_t)schema->GetSize();
+	auto entriesCount = entries.size() / entrySize;
+	auto& column = schema->GetColumn(1);
+
+	auto order = vector<size_t>(entriesCount);
+	iota(order.begin(), order.end(), 0);
+	sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		auto valueA = span<unsigned char>(entries.data() + a * entrySize + column.Offset, column.Length);
+		auto valueB = span<unsigned char>(entries.data() + b * entrySize + column.Offset, column.Length);
+		auto compare = Column::Compare(column, valueA, valueB);
+		if (compare != 0)
+		{
+			return compare < 0;
+		}
+		return *(unsigned long long*)(entries.data() + a * entrySize) < *(unsigned long long*)(entries.data() + b * entrySize);
+	});
+
+	auto sortedEntries = vector<unsigned char>(entriesCount * entrySize);
+	for (size_t i = 0; i < entriesCount; i++)
+	{
+		memcpy(sortedEntries.data() + i * entrySize, entries.data() + order[i] * entrySize, entrySize);
+	}
+	m_Tree.Load(sortedEntries);
+}
+
+bool SecondaryIndex::Find(const Predicate& predicate, Schema* recordSchema, unsigned long long limit, vector<Entry>& entries)
+{
+	m_ReadBlocksCount = 0;
+	entries.clear();
+
+	// Each value (=, IN) is a range of its own, otherwise the range of the predicate is used if it has a bound
+	auto length = recordSchema->GetColumn(m_ColumnId).Length;
+	vector<vector<unsigned char>> values;
+	vector<pair<vector<unsigned char>, vector<unsigned char>>> ranges;
+	vector<unsigned char> min, max;
+	if (predicate.GetValues(m_ColumnId, values))
+	{
+		sort(values.begin(), values.end());
+		values.erase(unique(values.begin(), values.end()), values.end());
+		for (auto& value : values)
+		{
+			ranges.push_back({ value, value });
+		}
+	}
+	else if (predicate.GetRange(recordSchema, m_ColumnId, min, max) && (!min.empty() || !max.empty()))
+	{
+		ranges.push_back({ min, max });
+	}
+	else
+	{
+		return false;
+	}
+
+	for (auto& [rangeMin, rangeMax] : ranges)
+	{
+		if ((!rangeMin.empty() && rangeMin.size() != length) || (!rangeMax.empty() && rangeMax.size() != length))
+		{
+			return false;
+		}
+	}
+
+	m_Tree.ClearAccessCount();
+	auto found = true;
+	unsigned long long cursorReadsCount = 0;
+	for (auto& [rangeMin, rangeMax] : ranges)
+	{
+		auto cursor = m_Tree.OpenCursor(rangeMin, rangeMax);
+		while (found && cursor->MoveNext())
+		{
+			if (entries.size() == limit)
+			{
+				found = false;
+				break;
+			}
+			auto entry = cursor->GetCurrent().GetData();
+			auto& blockIdColumn = m_Tree.GetSchema()->GetColumn(2);
+			Entry match;
+			memcpy(&match.RecordId, entry.data(), sizeof(match.RecordId));
+			memcpy(&match.BlockId, entry.data() + blockIdColumn.Offset, sizeof(match.BlockId));
+			memcpy(&match.RecordNumberInBlock, entry.data() + blockIdColumn.Offset + sizeof(match.BlockId), sizeof(match.RecordNumberInBlock));
+			entries.push_back(match);
+		}
+		cursorReadsCount += cursor->GetReadBlocksCount();
+		if (!found)
+		{
+			break;
+		}
+	}
+	m_ReadBlocksCount = m_Tree.GetReadBlocksCount() + cursorReadsCount;
+	return found;
+}
+
+vector<unsigned char> SecondaryIndex::MakeEntry(span<const unsigned char> record, unsigned long long blockId, unsigned long long recordNumberInBlock)
+{
+	auto schema = m_Tree.GetSchema();
+	auto& column = schema->GetColumn(1);
+	auto& blockIdColumn = schema->GetColumn(2);
+	auto entry = vector<unsigned char>(schema->GetSize());
+	memcpy(entry.data(), record.data(), sizeof(unsigned long long));
+	memcpy(entry.data() + column.Offset, record.data() + m_ValueOffset, column.Length);
+	memcpy(entry.data() + blockIdColumn.Offset, &blockId, sizeof(blockId));
+	memcpy(entry.data() + blockIdColumn.Offset + sizeof(blockId), &recordNumberInBlock, sizeof(recordNumberInBlock));
+	return entry;
+}
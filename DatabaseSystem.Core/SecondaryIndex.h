@@ -0,0 +1,63 @@
+#pragma once
+#include "BPlusTree.h"
+#include "Predicate.h"
+
+/*
+	Index of the records of a file by one of their columns, kept in a BPlusTree file next to the records
+	file (path + ".index" + column id). An entry is the record Id, a copy of the column value and the
+	position of the record (block id and record number in the block), ordered by value and then by Id.
+	The positions are hints: organizations move records around (reorganizations, the write block), so
+	readers check the Id found at the position and rebuild the index when it does not match.
+*/
+class SecondaryIndex
+{
+public:
+	struct Entry
+	{
+		unsigned long long RecordId;
+		unsigned long long BlockId;
+		unsigned long long RecordNumberInBlock;
+	};
+
+	SecondaryIndex(size_t blockSize, BufferPool* bufferPool);
+
+	static string GetPath(string recordsPath, unsigned int columnId);
+	// Removes the files of the index of the column, if there are any
+	static void RemoveFiles(string recordsPath, unsigned int columnId);
+
+	void Create(string recordsPath, Schema* recordSchema, unsigned int columnId);
+	void Open(string recordsPath, Schema* recordSchema, unsigned int columnId);
+	void Close();
+	void Checkpoint();
+	// Same meaning as for the record files, before Create/Open
+	void SetFileAccessMode(FileAccessMode mode);
+	void SetWriteBack(bool enabled);
+
+	unsigned int GetColumnId();
+	unsigned long long GetEntriesCount();
+	// Blocks of the index read by the last Find
+	unsigned long long GetReadBlocksCount() const;
+
+	void Insert(span<const unsigned char> record, unsigned long long blockId, unsigned long long recordNumberInBlock);
+	void Remove(span<const unsigned char> record);
+	// Adds the entry of a record to entries, to be given to Load
+	void AppendEntry(vector<unsigned char>& entries, span<const unsigned char> record, unsigned long long blockId, unsigned long long recordNumberInBlock);
+	// Replaces the content of the index by the entries, in any order
+	void Load(vector<unsigned char>& entries);
+
+	/*
+	* Entries of the records whose value of the column may satisfy the predicate: those with one of its values
+	* (=, IN) or in its range. Returns false when the predicate does not restrict the column or when more than
+	* limit entries would be returned, a scan being cheaper then.
+	*/
+	bool Find(const Predicate& predicate, Schema* recordSchema, unsigned long long limit, vector<Entry>& entries);
+
+private:
+	BPlusTree m_Tree;
+	unsigned int m_ColumnId;
+	// Offset of the column in the records
+	unsigned int m_ValueOffset;
+	unsigned long long m_ReadBlocksCount;
+
+	vector<unsigned char> MakeEntry(span<const unsigned char> record, unsigned long long blockId, unsigned long long recordNumberInBlock);
+};
@@ -0,0 +1,108 @@
+#pragma once
+#include <bit>
+
+/*
+	One bit per record of a block, set when the record matches a predicate.
+	Kept as 64 bits words so the kernels can store the masks of several records at once.
+*/
+class SelectionBitmap
+{
+public:
+	SelectionBitmap(size_t bitsCount = 0)
+	{
+		Reset(bitsCount);
+	}
+
+	// Resizes to bitsCount bits, all clear
+	void Reset(size_t bitsCount)
+	{
+		m_BitsCount = bitsCount;
+		m_Words.assign((bitsCount + 63) / 64, 0);
+	}
+
+	size_t GetSize() const
+	{
+		return m_BitsCount;
+	}
+
+	void Set(size_t bit)
+	{
+		m_Words[bit / 64] |= 1ull << (bit % 64);
+	}
+
+	bool Test(size_t bit) const
+	{
+		return (m_Words[bit / 64] >> (bit % 64)) & 1;
+	}
+
+	// Ors the mask of count (<= 64) records starting at firstBit, that must not cross a word
+	void SetMask(size_t firstBit, unsigned long long mask)
+	{
+		m_Words[firstBit / 64] |= mask << (firstBit % 64);
+	}
+
+	// Keeps the bits also set in other, of the same size
+	void And(const SelectionBitmap& other)
+	{
+		for (size_t i = 0; i < m_Words.size(); i++)
+		{
+			m_Words[i] &= other.m_Words[i];
+		}
+	}
+
+	// Adds the bits set in other, of the same size
+	void Or(const SelectionBitmap& other)
+	{
+		for (size_t i = 0; i < m_Words.size(); i++)
+		{
+			m_Words[i] |= other.m_Words[i];
+		}
+	}
+
+	// Flips every bit, the ones past the size stay clear
+	void Invert()
+	{
+		for (auto& word : m_Words)
+		{
+			word = ~word;
+		}
+		if (m_BitsCount % 64 != 0)
+		{
+			m_Words.back() &= (1ull << (m_BitsCount % 64)) - 1;
+		}
+	}
+
+	size_t Count() const
+	{
+		size_t count = 0;
+		for (auto word : m_Words)
+		{
+			count += popcount(word);
+		}
+		return count;
+	}
+
+	// Calls visit(bit) for every set bit, in order
+	template<typename TVisit>
+	void ForEach(TVisit visit) const
+	{
+		for (size_t i = 0; i < m_Words.size(); i++)
+		{
+			auto word = m_Words[i];
+			while (word != 0)
+			{
+				visit(i * 64 + countr_zero(word));
+				word &= word - 1;
+			}
+		}
+	}
+
+	unsigned long long* GetWords()
+	{
+		return m_Words.data();
+	}
+
+private:
+	size_t m_BitsCount;
+	vector<unsigned long long> m_Words;
+};
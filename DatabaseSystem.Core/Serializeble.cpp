@@ -1,2 +1,26 @@
 #include "pch.h"
 #include "Serializeble.h"
+
+void Serializable::WriteString(ostream& dst, const string& value)
+{
+	WriteField(dst, (unsigned int)value.size());
+	dst.write(value.data(), value.size());
+}
+
+string Serializable::ReadString(istream& src)
+{
+	unsigned int size;
+	ReadField(src, size);
+	string value(size, '\0');
+	src.read(value.data(), size);
+	CheckRead(src);
+	return value;
+}
+
+void Serializable::CheckRead(istream& src)
+{
+	if (!src)
+	{
+		throw runtime_error("Corrupted file head");
+	}
+}
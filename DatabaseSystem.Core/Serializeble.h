@@ -1,9 +1,53 @@
 #pragma once
 
+/*
+	Heads are stored in binary: fixed size fields as their raw bytes (native byte order)
+	and strings as their length followed by the characters.
+*/
 class Serializable
 {
 public:
 	virtual void Serialize(iostream& dst) = 0;
 	virtual void Deserialize(iostream& src) = 0;
-};
 
+protected:
+	template<typename T>
+	static void WriteField(ostream& dst, const T& value)
+	{
+		static_assert(is_trivially_copyable_v<T>, "Only plain values can be written as bytes");
+		dst.write((const char*)&value, sizeof(T));
+	}
+
+	template<typename T>
+	static void ReadField(istream& src, T& value)
+	{
+		static_assert(is_trivially_copyable_v<T>, "Only plain values can be read as bytes");
+		src.read((char*)&value, sizeof(T));
+		CheckRead(src);
+	}
+
+	template<typename T>
+	static void WriteArray(ostream& dst, const vector<T>& values)
+	{
+		static_assert(is_trivially_copyable_v<T>, "Only plain values can be written as bytes");
+		WriteField(dst, (unsigned long long)values.size());
+		dst.write((const char*)values.data(), values.size() * sizeof(T));
+	}
+
+	template<typename T>
+	static void ReadArray(istream& src, vector<T>& values)
+	{
+		static_assert(is_trivially_copyable_v<T>, "Only plain values can be read as bytes");
+		unsigned long long size;
+		ReadField(src, size);
+		values.resize(size);
+		src.read((char*)values.data(), size * sizeof(T));
+		CheckRead(src);
+	}
+
+	static void WriteString(ostream& dst, const string& value);
+	static string ReadString(istream& src);
+
+private:
+	static void CheckRead(istream& src);
+};
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "BetterEnums.h"
+
+// Widest vector instruction set the predicate kernels use, see PredicateKernels::SetLevel
+BETTER_ENUM(SimdLevel, int, SCALAR, SSE, AVX2)
@@ -15,6 +15,11 @@ void Table::Close()
     m_RecordManager.Close();
 }
 
+void Table::Checkpoint()
+{
+    m_RecordManager.Checkpoint();
+}
+
 
 unsigned long long Table::GetSize()
 {
@@ -46,31 +51,68 @@ void Table::Insert(Record record)
     m_RecordManager.Insert(record);
 }
 
-void Table::InsertMany(vector<Record> records)
+void Table::InsertMany(const vector<Record>& records)
 {
     m_RecordManager.InsertMany(records);
 }
 
+unsigned long long Table::InsertFromCsv(string path, unsigned long long lines)
+{
+    return m_RecordManager.InsertFromCsv(path, lines);
+}
+
 Record* Table::Select(unsigned long long id)
 {
     return m_RecordManager.Select(id);
 }
 
-vector<Record*> Table::Select(vector<unsigned long long> ids)
+ResultSet Table::Select(vector<unsigned long long> ids)
 {
     return m_RecordManager.Select(ids);
 }
 
-vector<Record*> Table::SelectWhereBetween(string columnName, span<unsigned char> min, span<unsigned char> max)
+ResultSet Table::SelectWhereBetween(string columnName, span<unsigned char> min, span<unsigned char> max, const Projection* projection)
 {
     auto columnId = m_RecordManager.GetSchema()->GetColumnId(columnName);
-    return m_RecordManager.SelectWhereBetween(columnId, min, max);
+    return m_RecordManager.SelectWhereBetween(columnId, min, max, projection);
 }
 
-vector<Record*> Table::SelectWhereEquals(string columnName, span<unsigned char> data)
+ResultSet Table::SelectWhereEquals(string columnName, span<unsigned char> data, const Projection* projection)
 {
     auto columnId = m_RecordManager.GetSchema()->GetColumnId(columnName);
-    return m_RecordManager.SelectWhereEquals(columnId, data);
+    return m_RecordManager.SelectWhereEquals(columnId, data, projection);
+}
+
+ResultSet Table::SelectWhere(const Predicate& predicate, const Projection* projection)
+{
+    return m_RecordManager.SelectWhere(predicate, projection);
+}
+
+ResultSet Table::Aggregate(const Aggregation& aggregation, const Predicate* predicate)
+{
+    return m_RecordManager.Aggregate(aggregation, predicate);
+}
+
+unique_ptr<RecordCursor> Table::OpenCursor()
+{
+    return m_RecordManager.OpenCursor();
+}
+
+unique_ptr<RecordCursor> Table::OpenCursorWhereBetween(string columnName, span<unsigned char> min, span<unsigned char> max)
+{
+    auto columnId = m_RecordManager.GetSchema()->GetColumnId(columnName);
+    return m_RecordManager.OpenCursorWhereBetween(columnId, min, max);
+}
+
+unique_ptr<RecordCursor> Table::OpenCursorWhereEquals(string columnName, span<unsigned char> data)
+{
+    auto columnId = m_RecordManager.GetSchema()->GetColumnId(columnName);
+    return m_RecordManager.OpenCursorWhereEquals(columnId, data);
+}
+
+unique_ptr<RecordCursor> Table::OpenCursorWhere(const Predicate& predicate)
+{
+    return m_RecordManager.OpenCursorWhere(predicate);
 }
 
 void Table::Delete(unsigned long long id)
@@ -82,4 +124,19 @@ int Table::DeleteWhereEquals(string columnName, span<unsigned char> data)
 {
     auto columnId = m_RecordManager.GetSchema()->GetColumnId(columnName);
     return m_RecordManager.DeleteWhereEquals(columnId, data);
+}
+
+int Table::DeleteWhere(const Predicate& predicate)
+{
+    return m_RecordManager.DeleteWhere(predicate);
+}
+
+void Table::CreateIndex(string columnName)
+{
+    m_RecordManager.CreateIndex(m_RecordManager.GetSchema()->GetColumnId(columnName));
+}
+
+void Table::DropIndex(string columnName)
+{
+    m_RecordManager.DropIndex(m_RecordManager.GetSchema()->GetColumnId(columnName));
 }
\ No newline at end of file
@@ -10,6 +10,7 @@ public:
 	void Load(string path);
 	void Create(string path, Schema* schema);
 	void Close();
+	void Checkpoint();
 
 	unsigned long long GetSize();
 	Schema* GetSchema();
@@ -19,23 +20,43 @@ public:
 
 	// ---------------------------------------------- <INSERT> --------------------------------------------------------------------------
 	void Insert(Record record);
-	void InsertMany(vector<Record> records);
+	void InsertMany(const vector<Record>& records);
+	unsigned long long InsertFromCsv(string path, unsigned long long lines = (unsigned long long)-1);
 	// ---------------------------------------------- </INSERT> --------------------------------------------------------------------------
 
 
 	// ---------------------------------------------- <SELECT> --------------------------------------------------------------------------
 	Record* Select(unsigned long long id);
-	vector<Record*> Select(vector<unsigned long long> ids);
-	vector<Record*> SelectWhereBetween(string columnName, span<unsigned char> min, span<unsigned char> max);
-	vector<Record*> SelectWhereEquals(string columnName, span<unsigned char> data);
+	ResultSet Select(vector<unsigned long long> ids);
+	// The projection, if given, limits the columns of the results (see Projection)
+	ResultSet SelectWhereBetween(string columnName, span<unsigned char> min, span<unsigned char> max, const Projection* projection = nullptr);
+	ResultSet SelectWhereEquals(string columnName, span<unsigned char> data, const Projection* projection = nullptr);
+	ResultSet SelectWhere(const Predicate& predicate, const Projection* projection = nullptr);
+	ResultSet Aggregate(const Aggregation& aggregation, const Predicate* predicate = nullptr);
 	// ---------------------------------------------- </SELECT> --------------------------------------------------------------------------
+
+
+	// ---------------------------------------------- <CURSOR> --------------------------------------------------------------------------
+	unique_ptr<RecordCursor> OpenCursor();
+	unique_ptr<RecordCursor> OpenCursorWhereBetween(string columnName, span<unsigned char> min, span<unsigned char> max);
+	unique_ptr<RecordCursor> OpenCursorWhereEquals(string columnName, span<unsigned char> data);
+	unique_ptr<RecordCursor> OpenCursorWhere(const Predicate& predicate);
+	// ---------------------------------------------- </CURSOR> --------------------------------------------------------------------------
 	
 	
 	// ---------------------------------------------- <DELETE> --------------------------------------------------------------------------
 	void Delete(unsigned long long id);
 	int DeleteWhereEquals(string columnName, span<unsigned char> data);
+	int DeleteWhere(const Predicate& predicate);
 	// ---------------------------------------------- </DELETE> --------------------------------------------------------------------------
 
+
+	// ---------------------------------------------- <INDEX> --------------------------------------------------------------------------
+	// The selects and deletes use the indexes by themselves when they help
+	void CreateIndex(string columnName);
+	void DropIndex(string columnName);
+	// ---------------------------------------------- </INDEX> --------------------------------------------------------------------------
+
 private:
 	BaseRecordManager& m_RecordManager;
 };
\ No newline at end of file
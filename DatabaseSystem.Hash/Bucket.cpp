@@ -1,7 +1,7 @@
 #include "pch.h"
 #include "Bucket.h"
 
-Bucket::Bucket()
+Bucket::Bucket() : hash(0), blockNumber(InvalidBlockId), localDepth(0)
 {
 }
 
@@ -8,6 +8,10 @@ class Bucket
 public:
 	Bucket();
 	~Bucket();
+	// End of a chain, or a bucket without blocks
+	static constexpr unsigned long long InvalidBlockId = (unsigned long long)-1;
 	unsigned int hash;
 	unsigned long long blockNumber;
+	// Extendible hashing: low bits of the id shared by the entries of the directory that point to the same block
+	unsigned int localDepth;
 };
\ No newline at end of file
@@ -1,7 +1,7 @@
 #include "pch.h"
 #include "HashFileHead.h"
 
-HashFileHead::HashFileHead(Schema* schema) : Buckets(vector<Bucket>())
+HashFileHead::HashFileHead(Schema* schema) : Buckets(vector<Bucket>()), Mode(HashingMode::STATIC), GlobalDepth(0), RecordsCount(0), Level(0), SplitPointer(0), MaxLoadFactor(0)
 {
 	m_Schema = schema;
 }
@@ -9,11 +9,32 @@ HashFileHead::HashFileHead(Schema* schema) : Buckets(vector<Bucket>())
 void HashFileHead::Serialize(iostream& dst)
 {
 	FileHead::Serialize(dst);
-	dst << Buckets.size() << endl;
-	for (auto bucket : Buckets) {
-		dst << bucket.hash << endl;
-		dst << bucket.blockNumber << endl;
+
+	// The directory is stored as one array of block numbers, the bucket hash is its index
+	vector<unsigned long long> directory;
+	directory.reserve(Buckets.size());
+	for (auto& bucket : Buckets) {
+		directory.push_back(bucket.blockNumber);
+	}
+	WriteArray(dst, directory);
+
+	WriteField(dst, Mode._to_integral());
+	WriteField(dst, GlobalDepth);
+	// The local depths only mean something to extendible hashing
+	vector<unsigned int> localDepths;
+	if (Mode == +HashingMode::EXTENDIBLE) {
+		localDepths.reserve(Buckets.size());
+		for (auto& bucket : Buckets) {
+			localDepths.push_back(bucket.localDepth);
+		}
 	}
+	WriteArray(dst, localDepths);
+
+	WriteField(dst, RecordsCount);
+	WriteField(dst, Level);
+	WriteField(dst, SplitPointer);
+	WriteField(dst, MaxLoadFactor);
+	WriteArray(dst, FreeBlocks);
 }
 
 void HashFileHead::SetBucketCount(int count) {
@@ -22,7 +43,7 @@ void HashFileHead::SetBucketCount(int count) {
 	{
 		auto bucket = Bucket();
 		bucket.hash = i;
-		bucket.blockNumber = -1;
+		bucket.blockNumber = Bucket::InvalidBlockId;
 		Buckets.push_back(bucket);
 	}
 }
@@ -30,14 +51,30 @@ void HashFileHead::SetBucketCount(int count) {
 void HashFileHead::Deserialize(iostream& src)
 {
 	FileHead::Deserialize(src);
-	int bucketCount;
-	src >> bucketCount;
+	vector<unsigned long long> directory;
+	ReadArray(src, directory);
 	Buckets.clear();
-	Buckets.reserve(bucketCount);
-	for (int i = 0; i < bucketCount; i++) {
+	Buckets.reserve(directory.size());
+	for (size_t i = 0; i < directory.size(); i++) {
 		auto bucket = Bucket();
-		src >> bucket.hash;
-		src >> bucket.blockNumber;
+		bucket.hash = (unsigned int)i;
+		bucket.blockNumber = directory[i];
 		Buckets.push_back(bucket);
 	}
+
+	int mode;
+	ReadField(src, mode);
+	Mode = HashingMode::_from_integral(mode);
+	ReadField(src, GlobalDepth);
+	vector<unsigned int> localDepths;
+	ReadArray(src, localDepths);
+	for (size_t i = 0; i < localDepths.size() && i < Buckets.size(); i++) {
+		Buckets[i].localDepth = localDepths[i];
+	}
+
+	ReadField(src, RecordsCount);
+	ReadField(src, Level);
+	ReadField(src, SplitPointer);
+	ReadField(src, MaxLoadFactor);
+	ReadArray(src, FreeBlocks);
 }
\ No newline at end of file
@@ -1,12 +1,25 @@
 #pragma once
 #include "../DatabaseSystem.Core/FileHead.h"
 #include "Bucket.h"
+#include "HashingMode.h"
 
 class HashFileHead : public FileHead
 {
 public:
 	HashFileHead(Schema* schema);
+	// The directory: the bucket of an id is the index of its entry
 	vector<Bucket> Buckets;
+	HashingMode Mode;
+	// Extendible hashing: low bits of the id that index the directory, which has 2^GlobalDepth entries
+	unsigned int GlobalDepth;
+	unsigned long long RecordsCount;
+	// Linear hashing: times the number of buckets doubled, and the next bucket to split in this round
+	unsigned int Level;
+	unsigned int SplitPointer;
+	// Linear hashing: a bucket is split when the records fill more than this share of one block per bucket
+	float MaxLoadFactor;
+	// Blocks left empty by splits and deletes, new chain blocks are taken from here first
+	vector<unsigned long long> FreeBlocks;
 
 	void SetBucketCount(int count);
 	// Inherited via FileHead
@@ -2,28 +2,142 @@
 #include "HashRecordManager.h"
 #include "../DatabaseSystem.Core/Assertions.h"
 #include "HashFileHead.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <filesystem>
+#include <cmath>
 
-HashRecordManager::HashRecordManager(size_t blockSize, unsigned int numberOfBuckets) :
-    BaseRecordManager(),
-    m_File(new FileWrapper<HashFileHead>(blockSize, sizeof(unsigned long long))),
-    m_NumberOfBuckets(numberOfBuckets)
+HashRecordManager::HashRecordManager(size_t blockSize, unsigned int numberOfBuckets, BufferPool* bufferPool) :
+    BaseRecordManager(blockSize, bufferPool),
+    m_File(new FileWrapper<HashFileHead>(blockSize, sizeof(unsigned long long), m_BufferPool)),
+    m_NumberOfBuckets(numberOfBuckets),
+    m_Mode(HashingMode::STATIC),
+    m_MaxLoadFactor(0)
 {
 }
 
-void HashRecordManager::Create(string path, Schema* schema)
+HashRecordManager::HashRecordManager(size_t blockSize, HashingMode mode, unsigned int numberOfBuckets, float maxLoadFactor, BufferPool* bufferPool) :
+    HashRecordManager(blockSize, numberOfBuckets, bufferPool)
 {
-    BaseRecordManager::Create(path, schema);
-    m_File->GetHead()->SetBucketCount(m_NumberOfBuckets);
+    m_Mode = mode;
+    m_MaxLoadFactor = maxLoadFactor;
 }
 
 void HashRecordManager::Open(string path)
 {
     BaseRecordManager::Open(path);
-    Assert(m_NumberOfBuckets == m_File->GetHead()->Buckets.size(), "Buckets count missmatch");
+    // The file knows how it was hashed and into how many buckets, it may have grown or been resized since it was created
+    m_Mode = m_File->GetHead()->Mode;
+    m_NumberOfBuckets = (int)m_File->GetHead()->Buckets.size();
+}
+
+unsigned int HashRecordManager::GetRecommendedBucketCount(float loadFactor)
+{
+    auto recordsPerBucket = max(loadFactor * m_RecordsPerBlock, 1.0f);
+    return max((unsigned int)ceil(m_File->GetHead()->RecordsCount / recordsPerBucket), 1u);
+}
+
+void HashRecordManager::Resize(unsigned int numberOfBuckets)
+{
+    Assert(m_Mode == +HashingMode::STATIC, "Only static hash files have a fixed number of buckets");
+    Assert(numberOfBuckets > 0, "A hash file needs at least one bucket");
+    ClearAccessCount();
+
+    auto fileHead = m_File->GetHead();
+    auto path = m_File->GetPath();
+    auto resizedPath = path + ".resize";
+    auto resized = HashRecordManager(m_File->GetBlockSize(), numberOfBuckets, m_BufferPool);
+    resized.Create(resizedPath, GetSchema());
+
+    // Until it replaces the old file, any way out of here closes the new file and removes it.
+    // It runs while an error is already on its way out, so its own errors are swallowed
+    struct ResizeCleanup {
+        HashRecordManager* Resized;
+        string Path;
+        ~ResizeCleanup() {
+            if (Resized != nullptr) {
+                try {
+                    Resized->Close();
+                }
+                catch (...) {
+                }
+            }
+            if (!Path.empty()) {
+                error_code error;
+                filesystem::remove(Path, error);
+            }
+        }
+    } cleanup{ &resized, resizedPath };
+
+    auto recordSize = (size_t)GetSchema()->GetSize();
+    for (size_t bucketNumber = 0; bucketNumber < fileHead->Buckets.size(); bucketNumber++) {
+        // One chain at a time, its records grouped by their bucket in the new file
+        unordered_map<unsigned int, vector<unsigned char>> recordsByBucket;
+        auto blockNumber = fileHead->Buckets[bucketNumber].blockNumber;
+        while (blockNumber != Bucket::InvalidBlockId) {
+            if (!ReadBlock(m_ReadBlock, blockNumber)) {
+                Assert(false, "Invalid block");
+                return;
+            }
+            auto blockRecords = m_ReadBlock->GetRecords();
+            for (size_t offset = 0; offset < blockRecords.size(); offset += recordSize) {
+                auto record = blockRecords.subspan(offset, recordSize);
+                auto& bucketRecords = recordsByBucket[resized.hashFunction(*(unsigned long long*)record.data())];
+                bucketRecords.insert(bucketRecords.end(), record.begin(), record.end());
+            }
+            blockNumber = *(unsigned long long*)m_ReadBlock->GetHeader().data();
+        }
+        for (auto& [resizedBucketNumber, bucketRecords] : recordsByBucket) {
+            resized.AppendRecords(resizedBucketNumber, bucketRecords);
+        }
+    }
+
+    auto resizedHead = resized.m_File->GetHead();
+    resizedHead->NextId = fileHead->NextId;
+    resizedHead->RecordsCount = fileHead->RecordsCount;
+    m_LastQueryBlockWriteAccessCount += resized.m_LastQueryBlockWriteAccessCount;
+    // A close that fails is not tried again by the cleanup
+    cleanup.Resized = nullptr;
+    resized.Close();
+
+    // The new file takes the place of the old one, the rename replaces it as a whole
+    Close();
+    try {
+        filesystem::rename(resizedPath, path);
+        cleanup.Path.clear();
+        Open(path);
+    }
+    catch (...) {
+        // The manager is not left closed: the old file if the rename failed, the new one otherwise
+        Open(path);
+        if (cleanup.Path.empty()) {
+            InvalidateIndexes();
+        }
+        throw;
+    }
+    // Every record moved, the positions kept by the indexes are no longer valid
+    InvalidateIndexes();
 }
 
 unsigned int HashRecordManager::hashFunction(unsigned long long key)
 {
+    if (m_Mode == +HashingMode::EXTENDIBLE) {
+        // The low GlobalDepth bits of the id index the directory. The entries that share a bucket all
+        // return the first of them, so the ids of one bucket always hash to the same number
+        auto fileHead = m_File->GetHead();
+        auto entry = (unsigned int)(key & ((1ull << fileHead->GlobalDepth) - 1));
+        return entry & ((1u << fileHead->Buckets[entry].localDepth) - 1);
+    }
+    if (m_Mode == +HashingMode::LINEAR) {
+        // The buckets before the split pointer were split in this round, their ids are spread over twice as many buckets
+        auto fileHead = m_File->GetHead();
+        auto roundBuckets = fileHead->Buckets.size() - fileHead->SplitPointer;
+        auto bucket = key % roundBuckets;
+        if (bucket < fileHead->SplitPointer) {
+            bucket = key % (roundBuckets * 2);
+        }
+        return (unsigned int)bucket;
+    }
     return key % m_NumberOfBuckets;
 }
 
@@ -33,7 +147,7 @@ Record* HashRecordManager::Select(unsigned long long id)
     unsigned int bucketNumber = hashFunction(id);
     auto record = new Record(GetSchema());
     m_NextReadBlockNumber = m_File->GetHead()->Buckets[bucketNumber].blockNumber;
-    while (m_NextReadBlockNumber != -1) {
+    while (m_NextReadBlockNumber != Bucket::InvalidBlockId) {
         if (!ReadBlock(m_ReadBlock, m_NextReadBlockNumber)) {
             Assert(false, "Invalid block");
             return nullptr;
@@ -49,128 +163,554 @@ Record* HashRecordManager::Select(unsigned long long id)
     return nullptr;
 }
 
-bool HashRecordManager::SelectSpan(unsigned long long id, span<unsigned char>* data)
+bool HashRecordManager::FindRecord(unsigned long long id, unsigned long long& blockNumber, unsigned long long& recordNumberInBlock)
 {
-    ClearAccessCount();
-    unsigned int bucketNumber = hashFunction(id);
-    auto record = new Record(GetSchema());
-    auto blockNumber = m_File->GetHead()->Buckets[bucketNumber].blockNumber;
-    while (blockNumber != -1) {
+    blockNumber = m_File->GetHead()->Buckets[hashFunction(id)].blockNumber;
+    while (blockNumber != Bucket::InvalidBlockId) {
         if (!ReadBlock(m_ReadBlock, blockNumber)) {
             Assert(false, "Invalid block");
             return false;
         }
-        m_ReadBlock->MoveToStart();
-        while (m_ReadBlock->GetPosition() < m_ReadBlock->GetRecordsCount() && m_ReadBlock->GetCurrentSpan(data)) {
-            if (record->getId() == id) {
+        auto blockRecords = m_ReadBlock->GetRecords();
+        auto recordSize = m_ReadBlock->GetRecordSize();
+        for (recordNumberInBlock = 0; recordNumberInBlock < m_ReadBlock->GetRecordsCount(); recordNumberInBlock++) {
+            if (*(unsigned long long*)blockRecords.subspan(recordNumberInBlock * recordSize, recordSize).data() == id) {
                 return true;
             }
-            m_ReadBlock->Advance();
         }
         blockNumber = *(unsigned long long*)m_ReadBlock->GetHeader().data();
     }
     return false;
 }
 
-vector<Record*> HashRecordManager::SelectWhereEquals(unsigned int columnId, span<unsigned char> data)
+ResultSet HashRecordManager::Select(vector<unsigned long long> ids)
 {
-    if (columnId != 0) {
-        return BaseRecordManager::SelectWhereEquals(columnId, data);
-    }
     ClearAccessCount();
-    auto records = vector<Record*>();
-    auto id = *(unsigned long long*)data.data();
-    unsigned int bucketNumber = hashFunction(id);
-    auto record = new Record(GetSchema());
-    auto nextBucketBlockNumber = m_File->GetHead()->Buckets[bucketNumber].blockNumber;
-    while (nextBucketBlockNumber != -1) {
-        if (!ReadBlock(m_ReadBlock, nextBucketBlockNumber)) {
-            Assert(false, "Invalid block");
-            break;
+
+    // Group the ids by bucket so each chain is followed once, whatever the number of its ids
+    unordered_map<unsigned int, unordered_set<unsigned long long>> idsByBucket;
+    for (auto id : ids) {
+        idsByBucket[hashFunction(id)].insert(id);
+    }
+
+    // The heads of the chains are read together
+    vector<unsigned long long> headBlocks;
+    for (auto& [bucketNumber, bucketIds] : idsByBucket) {
+        auto blockNumber = m_File->GetHead()->Buckets[bucketNumber].blockNumber;
+        if (blockNumber != Bucket::InvalidBlockId) {
+            headBlocks.push_back(blockNumber);
         }
-        m_ReadBlock->MoveToStart();
-        while (m_ReadBlock->GetRecord(record->GetData())) {
-            records.push_back(record);
+    }
+    m_File->PrefetchBlocks(headBlocks);
+
+    auto records = ResultSet(GetSchema());
+    for (auto& [bucketNumber, bucketIds] : idsByBucket) {
+        auto blockNumber = m_File->GetHead()->Buckets[bucketNumber].blockNumber;
+        auto remaining = bucketIds.size();
+        while (blockNumber != Bucket::InvalidBlockId && remaining > 0) {
+            if (!ReadBlock(m_ReadBlock, blockNumber)) {
+                Assert(false, "Invalid block");
+                break;
+            }
+            auto blockRecords = m_ReadBlock->GetRecords();
+            auto recordSize = m_ReadBlock->GetRecordSize();
+            for (size_t i = 0; i < m_ReadBlock->GetRecordsCount() && remaining > 0; i++) {
+                auto record = blockRecords.subspan(i * recordSize, recordSize);
+                if (bucketIds.contains(*(unsigned long long*)record.data())) {
+                    records.Append(record);
+                    remaining--;
+                }
+            }
+            blockNumber = *(unsigned long long*)m_ReadBlock->GetHeader().data();
         }
-        nextBucketBlockNumber = *(unsigned long long*)m_ReadBlock->GetHeader().data();
     }
     return records;
 }
 
+ResultSet HashRecordManager::SelectWhere(const Predicate& predicate, const Projection* projection)
+{
+    vector<unsigned int> buckets;
+    if (!GetBuckets(predicate, buckets)) {
+        return BaseRecordManager::SelectWhere(predicate, projection);
+    }
+
+    // A few bucket chains, not worth a parallel scan
+    ClearAccessCount();
+    auto cursor = OpenBucketsCursor(buckets, predicate.ToFilter(GetSchema()));
+    return Materialize(*cursor, projection);
+}
+
+unique_ptr<RecordCursor> HashRecordManager::OpenCursorWhere(const Predicate& predicate)
+{
+    vector<unsigned int> buckets;
+    if (!GetBuckets(predicate, buckets)) {
+        return BaseRecordManager::OpenCursorWhere(predicate);
+    }
+    return OpenBucketsCursor(buckets, predicate.ToFilter(GetSchema()));
+}
+
+bool HashRecordManager::GetBuckets(const Predicate& predicate, vector<unsigned int>& buckets)
+{
+    // Only the buckets of the ids the predicate allows can hold its records: a set of ids (=, IN)
+    // or a range of them shorter than the number of buckets
+    vector<vector<unsigned char>> ids;
+    vector<unsigned char> min, max;
+    if (predicate.GetValues(0, ids)) {
+        for (auto& id : ids) {
+            if (id.size() != sizeof(unsigned long long)) {
+                return false;
+            }
+            buckets.push_back(hashFunction(*(unsigned long long*)id.data()));
+        }
+    }
+    else if (predicate.GetRange(GetSchema(), 0, min, max) && min.size() == sizeof(unsigned long long) && max.size() == sizeof(unsigned long long)) {
+        auto firstId = *(unsigned long long*)min.data();
+        auto lastId = *(unsigned long long*)max.data();
+        if (lastId >= firstId && lastId - firstId >= (unsigned long long)m_File->GetHead()->Buckets.size()) {
+            return false;
+        }
+        for (auto id = firstId; id <= lastId && lastId >= firstId; id++) {
+            buckets.push_back(hashFunction(id));
+        }
+    }
+    else {
+        return false;
+    }
+
+    sort(buckets.begin(), buckets.end());
+    buckets.erase(unique(buckets.begin(), buckets.end()), buckets.end());
+    return true;
+}
+
+unique_ptr<RecordCursor> HashRecordManager::OpenBucketsCursor(vector<unsigned int> buckets, RecordCursor::FilterFunction filter)
+{
+    // Follows the chains of the buckets one after the other
+    size_t nextBucket = 0;
+    unsigned long long nextBucketBlockNumber = Bucket::InvalidBlockId;
+    auto nextBlock = [this, buckets, nextBucket, nextBucketBlockNumber](Block* buffer) mutable -> Block* {
+        while (nextBucketBlockNumber == Bucket::InvalidBlockId) {
+            if (nextBucket == buckets.size()) {
+                return nullptr;
+            }
+            nextBucketBlockNumber = m_File->GetHead()->Buckets[buckets[nextBucket++]].blockNumber;
+        }
+        ReadBlock(buffer, nextBucketBlockNumber);
+        nextBucketBlockNumber = *(unsigned long long*)buffer->GetHeader().data();
+        return buffer;
+    };
+    return make_unique<RecordCursor>(GetSchema(), unique_ptr<Block>(m_File->CreateBlock()), nextBlock, filter);
+}
+
 void HashRecordManager::Insert(Record record)
 {
     ClearAccessCount();
 
+    auto fileHead = m_File->GetHead();
     auto hashRecord = record.As<HashRecord>();
-    hashRecord->Id = m_File->GetHead()->NextId;
-    m_File->GetHead()->NextId += 1;
+    hashRecord->Id = fileHead->NextId;
+    fileHead->NextId += 1;
+    fileHead->RecordsCount += 1;
+
+    if (m_Mode == +HashingMode::EXTENDIBLE) {
+        InsertExtendible(record);
+        return;
+    }
+
+    AppendToChain(hashFunction(hashRecord->Id), *record.GetData());
+
+    // At most one split per insert, so the cost of an insert does not depend on the size of the file
+    if (m_Mode == +HashingMode::LINEAR && fileHead->RecordsCount > fileHead->MaxLoadFactor * fileHead->Buckets.size() * m_RecordsPerBlock) {
+        SplitNextBucket();
+    }
+}
 
-    unsigned int bucketHash = hashFunction(hashRecord->Id);
-    auto nextBucketBlockNumber = m_File->GetHead()->Buckets[bucketHash].blockNumber;
-    unsigned long long previousBucketBlockNumber = -1;
-    if (nextBucketBlockNumber != -1) {
+void HashRecordManager::AppendToChain(unsigned int bucketNumber, span<const unsigned char> record)
+{
+    auto nextBucketBlockNumber = m_File->GetHead()->Buckets[bucketNumber].blockNumber;
+    unsigned long long previousBucketBlockNumber = Bucket::InvalidBlockId;
+    if (nextBucketBlockNumber != Bucket::InvalidBlockId) {
         if (!ReadBlock(m_ReadBlock, nextBucketBlockNumber)) {
             Assert(false, "Invalid block");
             return;
         }
         if (m_ReadBlock->GetRecordsCount() < m_RecordsPerBlock) {
-            m_ReadBlock->Append(*record.GetData());
+            m_ReadBlock->Append(record);
             WriteBlock(m_ReadBlock, nextBucketBlockNumber);
+            AddToIndexes(record, nextBucketBlockNumber, m_ReadBlock->GetRecordsCount() - 1);
             return;
         }
         previousBucketBlockNumber = nextBucketBlockNumber;
     }
 
     // Add new overflow block
+    nextBucketBlockNumber = AllocateBlock();
     m_WriteBlock->Clear();
     memcpy(m_WriteBlock->GetHeader().data(), (const char*)&previousBucketBlockNumber, sizeof(previousBucketBlockNumber));
-    m_WriteBlock->Append(*record.GetData());
+    m_WriteBlock->Append(record);
+    WriteAllocatedBlock(m_WriteBlock, nextBucketBlockNumber);
+    // The write block only holds records not in the file yet, scans read it too
+    m_WriteBlock->Clear();
+
+    m_File->GetHead()->Buckets[bucketNumber].blockNumber = nextBucketBlockNumber;
+    AddToIndexes(record, nextBucketBlockNumber, 0);
+}
+
+void HashRecordManager::InsertMany(span<const unsigned char> records)
+{
+    if (m_Mode != +HashingMode::STATIC) {
+        // The buckets split as they fill, one insert after the other
+        BaseRecordManager::InsertMany(records);
+        return;
+    }
+
+    ClearAccessCount();
+
+    auto fileHead = m_File->GetHead();
+    auto recordSize = (size_t)GetSchema()->GetSize();
+    auto recordsCount = records.size() / recordSize;
+    if (recordsCount == 0) {
+        return;
+    }
+
+    // Ids are given in input order, so the bucket of each record is known up front
+    auto firstId = fileHead->NextId;
+    fileHead->NextId += recordsCount;
+    fileHead->RecordsCount += recordsCount;
+
+    // Counting sort of the records by bucket, their ids are set on the way
+    auto bucketStarts = vector<size_t>(m_NumberOfBuckets + 1, 0);
+    for (size_t i = 0; i < recordsCount; i++) {
+        bucketStarts[hashFunction(firstId + i) + 1]++;
+    }
+    for (int bucket = 0; bucket < m_NumberOfBuckets; bucket++) {
+        bucketStarts[bucket + 1] += bucketStarts[bucket];
+    }
+    auto sortedRecords = vector<unsigned char>(recordsCount * recordSize);
+    auto nextPositions = bucketStarts;
+    for (size_t i = 0; i < recordsCount; i++) {
+        auto id = firstId + i;
+        auto sortedRecord = sortedRecords.data() + nextPositions[hashFunction(id)]++ * recordSize;
+        memcpy(sortedRecord, records.data() + i * recordSize, recordSize);
+        memcpy(sortedRecord, &id, sizeof(id));
+    }
+
+    for (int bucket = 0; bucket < m_NumberOfBuckets; bucket++) {
+        if (bucketStarts[bucket] < bucketStarts[bucket + 1]) {
+            auto bucketRecords = span<const unsigned char>(sortedRecords).subspan(bucketStarts[bucket] * recordSize, (bucketStarts[bucket + 1] - bucketStarts[bucket]) * recordSize);
+            AppendRecords(bucket, bucketRecords);
+        }
+    }
+}
+
+void HashRecordManager::AppendRecords(unsigned int bucketNumber, span<const unsigned char> records)
+{
+    auto fileHead = m_File->GetHead();
+    auto recordSize = (size_t)GetSchema()->GetSize();
+    auto recordsCount = records.size() / recordSize;
+    size_t next = 0;
+
+    auto appendNext = [&](Block* block, unsigned long long blockId) {
+        block->Append(records.subspan(next++ * recordSize, recordSize));
+        AddToIndexes(block, blockId, block->GetRecordsCount() - 1);
+    };
+
+    // Fill the room left in the head block of the chain
+    auto headBlockNumber = fileHead->Buckets[bucketNumber].blockNumber;
+    if (headBlockNumber != Bucket::InvalidBlockId) {
+        if (!ReadBlock(m_ReadBlock, headBlockNumber)) {
+            Assert(false, "Invalid block");
+            return;
+        }
+        if (m_ReadBlock->GetRecordsCount() < m_RecordsPerBlock) {
+            while (next < recordsCount && m_ReadBlock->GetRecordsCount() < m_RecordsPerBlock) {
+                appendNext(m_ReadBlock, headBlockNumber);
+            }
+            WriteBlock(m_ReadBlock, headBlockNumber);
+        }
+    }
+
+    // The rest goes to new overflow blocks, each one written once
+    while (next < recordsCount) {
+        auto blockNumber = AllocateBlock();
+        m_WriteBlock->Clear();
+        memcpy(m_WriteBlock->GetHeader().data(), (const char*)&headBlockNumber, sizeof(headBlockNumber));
+        while (next < recordsCount && m_WriteBlock->GetRecordsCount() < m_RecordsPerBlock) {
+            appendNext(m_WriteBlock, blockNumber);
+        }
+        WriteAllocatedBlock(m_WriteBlock, blockNumber);
+        headBlockNumber = blockNumber;
+    }
+    // The write block only holds records not in the file yet, scans read it too
+    m_WriteBlock->Clear();
+    fileHead->Buckets[bucketNumber].blockNumber = headBlockNumber;
+}
+
+void HashRecordManager::InsertExtendible(Record& record)
+{
+    auto fileHead = m_File->GetHead();
+    auto id = record.As<HashRecord>()->Id;
+    while (true) {
+        auto bucketNumber = hashFunction(id);
+        auto blockNumber = fileHead->Buckets[bucketNumber].blockNumber;
+        if (blockNumber == Bucket::InvalidBlockId) {
+            // First record of the bucket, its block is made now
+            unsigned long long noNextBlock = Bucket::InvalidBlockId;
+            m_WriteBlock->Clear();
+            memcpy(m_WriteBlock->GetHeader().data(), (const char*)&noNextBlock, sizeof(noNextBlock));
+            m_WriteBlock->Append(*record.GetData());
+            AddBlock(m_WriteBlock);
+            // The write block only holds records not in the file yet, scans read it too
+            m_WriteBlock->Clear();
+
+            blockNumber = fileHead->GetBlocksCount() - 1;
+            SetBucketBlock(bucketNumber, fileHead->Buckets[bucketNumber].localDepth, blockNumber);
+            AddToIndexes(*record.GetData(), blockNumber, 0);
+            return;
+        }
+
+        if (!ReadBlock(m_ReadBlock, blockNumber)) {
+            Assert(false, "Invalid block");
+            return;
+        }
+        if (m_ReadBlock->GetRecordsCount() < m_RecordsPerBlock) {
+            m_ReadBlock->Append(*record.GetData());
+            WriteBlock(m_ReadBlock, blockNumber);
+            AddToIndexes(*record.GetData(), blockNumber, m_ReadBlock->GetRecordsCount() - 1);
+            return;
+        }
+
+        // Full, the records may all go to the same half so the bucket of the id is looked up again
+        SplitBucket(bucketNumber);
+    }
+}
+
+void HashRecordManager::SplitBucket(unsigned int bucketNumber)
+{
+    auto fileHead = m_File->GetHead();
+    auto localDepth = fileHead->Buckets[bucketNumber].localDepth;
+    auto blockNumber = fileHead->Buckets[bucketNumber].blockNumber;
+
+    if (localDepth == fileHead->GlobalDepth) {
+        // Only one entry points to the bucket. The directory doubles, each new entry points where its lower half twin does
+        auto size = fileHead->Buckets.size();
+        fileHead->Buckets.reserve(size * 2);
+        for (size_t i = 0; i < size; i++) {
+            auto bucket = fileHead->Buckets[i];
+            bucket.hash = (unsigned int)(size + i);
+            fileHead->Buckets.push_back(bucket);
+        }
+        fileHead->GlobalDepth++;
+    }
+
+    // The records with the bit after the local depth set go to a new block, the others stay
+    auto splitBit = 1ull << localDepth;
+    auto recordSize = m_ReadBlock->GetRecordSize();
+    auto records = vector<unsigned char>(m_ReadBlock->GetRecords().begin(), m_ReadBlock->GetRecords().end());
+    auto recordsCount = m_ReadBlock->GetRecordsCount();
+
+    unsigned long long noNextBlock = Bucket::InvalidBlockId;
+    m_ReadBlock->Truncate(0);
+    m_WriteBlock->Clear();
+    memcpy(m_WriteBlock->GetHeader().data(), (const char*)&noNextBlock, sizeof(noNextBlock));
+    for (unsigned int i = 0; i < recordsCount; i++) {
+        auto record = span<const unsigned char>(records).subspan(i * recordSize, recordSize);
+        RemoveFromIndexes(record);
+        auto id = *(unsigned long long*)record.data();
+        ((id & splitBit) != 0 ? m_WriteBlock : m_ReadBlock)->Append(record);
+    }
+
+    auto newBlockNumber = fileHead->GetBlocksCount();
+    WriteBlock(m_ReadBlock, blockNumber);
     AddBlock(m_WriteBlock);
+    for (unsigned int i = 0; i < m_ReadBlock->GetRecordsCount(); i++) {
+        AddToIndexes(m_ReadBlock, blockNumber, i);
+    }
+    for (unsigned int i = 0; i < m_WriteBlock->GetRecordsCount(); i++) {
+        AddToIndexes(m_WriteBlock, newBlockNumber, i);
+    }
+    // The write block only holds records not in the file yet, scans read it too
+    m_WriteBlock->Clear();
+
+    SetBucketBlock(bucketNumber, localDepth + 1, blockNumber);
+    SetBucketBlock(bucketNumber | (unsigned int)splitBit, localDepth + 1, newBlockNumber);
+}
+
+void HashRecordManager::SetBucketBlock(unsigned int bucketNumber, unsigned int localDepth, unsigned long long blockNumber)
+{
+    auto& buckets = m_File->GetHead()->Buckets;
+    for (size_t entry = bucketNumber; entry < buckets.size(); entry += (size_t)1 << localDepth) {
+        buckets[entry].blockNumber = blockNumber;
+        buckets[entry].localDepth = localDepth;
+    }
+}
+
+void HashRecordManager::SplitNextBucket()
+{
+    auto fileHead = m_File->GetHead();
+    auto bucketNumber = fileHead->SplitPointer;
+    auto roundBuckets = fileHead->Buckets.size() - fileHead->SplitPointer;
+
+    // The whole chain is read, its blocks are written again with the records that stay and then the ones that move
+    auto records = vector<unsigned char>();
+    auto chainBlocks = vector<unsigned long long>();
+    auto blockNumber = fileHead->Buckets[bucketNumber].blockNumber;
+    while (blockNumber != Bucket::InvalidBlockId) {
+        if (!ReadBlock(m_ReadBlock, blockNumber)) {
+            Assert(false, "Invalid block");
+            return;
+        }
+        chainBlocks.push_back(blockNumber);
+        auto blockRecords = m_ReadBlock->GetRecords();
+        records.insert(records.end(), blockRecords.begin(), blockRecords.end());
+        blockNumber = *(unsigned long long*)m_ReadBlock->GetHeader().data();
+    }
+
+    auto newBucket = Bucket();
+    newBucket.hash = (unsigned int)fileHead->Buckets.size();
+    fileHead->Buckets.push_back(newBucket);
+    fileHead->SplitPointer++;
+    if (fileHead->SplitPointer == roundBuckets) {
+        // Every bucket of the round was split, the next round starts over with twice as many
+        fileHead->Level++;
+        fileHead->SplitPointer = 0;
+    }
+
+    auto recordSize = (size_t)GetSchema()->GetSize();
+    auto staying = vector<unsigned char>();
+    auto moving = vector<unsigned char>();
+    for (size_t offset = 0; offset < records.size(); offset += recordSize) {
+        auto record = span<const unsigned char>(records).subspan(offset, recordSize);
+        RemoveFromIndexes(record);
+        auto& half = hashFunction(*(unsigned long long*)record.data()) == bucketNumber ? staying : moving;
+        half.insert(half.end(), record.begin(), record.end());
+    }
+    fileHead->Buckets[bucketNumber].blockNumber = WriteChain(staying, chainBlocks);
+    fileHead->Buckets[newBucket.hash].blockNumber = WriteChain(moving, chainBlocks);
+
+    // Blocks the halves did not need are emptied so scans do not see their records twice, and kept for the next chains
+    unsigned long long noNextBlock = Bucket::InvalidBlockId;
+    for (auto unusedBlockNumber : chainBlocks) {
+        m_WriteBlock->Clear();
+        memcpy(m_WriteBlock->GetHeader().data(), (const char*)&noNextBlock, sizeof(noNextBlock));
+        WriteBlock(m_WriteBlock, unusedBlockNumber);
+        fileHead->FreeBlocks.push_back(unusedBlockNumber);
+    }
+    m_WriteBlock->Clear();
+}
+
+unsigned long long HashRecordManager::WriteChain(span<const unsigned char> records, vector<unsigned long long>& chainBlocks)
+{
+    // The full blocks come first, the last one has the room left and is the head of the chain
+    auto recordSize = (size_t)GetSchema()->GetSize();
+    auto recordsCount = records.size() / recordSize;
+    unsigned long long headBlockNumber = Bucket::InvalidBlockId;
+    for (size_t first = 0; first < recordsCount; first += m_RecordsPerBlock) {
+        m_WriteBlock->Clear();
+        memcpy(m_WriteBlock->GetHeader().data(), (const char*)&headBlockNumber, sizeof(headBlockNumber));
+        for (auto i = first; i < recordsCount && i < first + m_RecordsPerBlock; i++) {
+            m_WriteBlock->Append(records.subspan(i * recordSize, recordSize));
+        }
+
+        if (chainBlocks.empty()) {
+            headBlockNumber = AllocateBlock();
+        }
+        else {
+            headBlockNumber = chainBlocks.front();
+            chainBlocks.erase(chainBlocks.begin());
+        }
+        WriteAllocatedBlock(m_WriteBlock, headBlockNumber);
+        for (unsigned int i = 0; i < m_WriteBlock->GetRecordsCount(); i++) {
+            AddToIndexes(m_WriteBlock, headBlockNumber, i);
+        }
+    }
+    // The write block only holds records not in the file yet, scans read it too
+    m_WriteBlock->Clear();
+    return headBlockNumber;
+}
+
+unsigned long long HashRecordManager::AllocateBlock()
+{
+    auto& freeBlocks = m_File->GetHead()->FreeBlocks;
+    if (freeBlocks.empty()) {
+        return m_File->GetHead()->GetBlocksCount();
+    }
+    auto blockNumber = freeBlocks.back();
+    freeBlocks.pop_back();
+    return blockNumber;
+}
 
-    nextBucketBlockNumber = m_File->GetHead()->GetBlocksCount() - 1;
-    m_File->GetHead()->Buckets[bucketHash].blockNumber = nextBucketBlockNumber;
+void HashRecordManager::WriteAllocatedBlock(Block* block, unsigned long long blockNumber)
+{
+    if (blockNumber == m_File->GetHead()->GetBlocksCount()) {
+        AddBlock(block);
+        return;
+    }
+    WriteBlock(block, blockNumber);
 }
 
 void HashRecordManager::Delete(unsigned long long id)
 {
-    int removedCount = 0;
-    unsigned int bucketNumber = hashFunction(id);
-    auto schema = GetSchema();
+    ClearAccessCount();
 
-    span<unsigned char> recordToRemove;
-    if (SelectSpan(id, &recordToRemove)) {
-        Assert(false, "Record not found");
+    unsigned long long blockNumber, recordNumberInBlock;
+    if (!FindRecord(id, blockNumber, recordNumberInBlock)) {
         return;
     }
 
-    auto nextBucketBlockNumber = m_File->GetHead()->Buckets[bucketNumber].blockNumber;
-    while (nextBucketBlockNumber != 1) {
-        if (!ReadBlock(m_WriteBlock, nextBucketBlockNumber)) {
+    span<unsigned char> record;
+    m_ReadBlock->GetRecordSpan(recordNumberInBlock, &record);
+    RemoveFromIndexes(record);
+    RemoveRecord(id, blockNumber, recordNumberInBlock);
+}
+
+void HashRecordManager::RemoveRecord(unsigned long long id, unsigned long long blockNumber, unsigned long long recordNumberInBlock)
+{
+    // Only the head block of a chain gets new records, so taking its last record keeps the other blocks full
+    auto& bucket = m_File->GetHead()->Buckets[hashFunction(id)];
+    auto headBlock = m_ReadBlock;
+    auto otherBlock = unique_ptr<Block>();
+    if (blockNumber != bucket.blockNumber) {
+        otherBlock.reset(m_File->CreateBlock());
+        if (!ReadBlock(otherBlock.get(), bucket.blockNumber)) {
             Assert(false, "Invalid block");
             return;
         }
-        if (m_WriteBlock->GetRecordsCount() > 0)
-        {
-            break;
-        }
-        nextBucketBlockNumber = *(unsigned long long*)m_WriteBlock->GetHeader().data();
+        headBlock = otherBlock.get();
     }
 
-    m_WriteBlock->MoveToEnd();
-    m_WriteBlock->Retreat();
-    span<unsigned char> tmpRemovedRecord;
-    if (!m_WriteBlock->GetRecordSpan(m_WriteBlock->GetRecordsCount() - 1, &tmpRemovedRecord))
-    {
+    auto lastRecordNumber = headBlock->GetRecordsCount() - 1;
+    span<unsigned char> lastRecord;
+    if (!headBlock->GetRecordSpan(lastRecordNumber, &lastRecord)) {
         Assert(false, "Invalid record");
         return;
     }
-    m_WriteBlock->Remove();
 
-    memcpy(recordToRemove.data(), tmpRemovedRecord.data(), GetSchema()->GetSize());
+    auto moved = headBlock != m_ReadBlock || recordNumberInBlock != lastRecordNumber;
+    if (moved) {
+        // The last record changes place, and so does its position in the indexes
+        RemoveFromIndexes(lastRecord);
+        span<unsigned char> removedRecord;
+        m_ReadBlock->GetRecordSpan(recordNumberInBlock, &removedRecord);
+        memcpy(removedRecord.data(), lastRecord.data(), lastRecord.size());
+    }
+    headBlock->Truncate(lastRecordNumber);
 
-    auto blockId = m_NextReadBlockNumber - 1;
-    WriteBlock(m_ReadBlock, blockId);
-    WriteBlock(m_WriteBlock, nextBucketBlockNumber);
+    if (headBlock != m_ReadBlock) {
+        WriteBlock(m_ReadBlock, blockNumber);
+    }
+    WriteBlock(headBlock, bucket.blockNumber);
+    if (moved) {
+        AddToIndexes(m_ReadBlock, blockNumber, recordNumberInBlock);
+    }
+
+    m_File->GetHead()->RecordsCount -= 1;
+
+    // A chain drops its empty head block, the next one becomes the head and the block goes to the free list
+    auto nextBlockNumber = *(unsigned long long*)headBlock->GetHeader().data();
+    if (m_Mode != +HashingMode::EXTENDIBLE && headBlock->GetRecordsCount() == 0 && nextBlockNumber != Bucket::InvalidBlockId) {
+        m_File->GetHead()->FreeBlocks.push_back(bucket.blockNumber);
+        bucket.blockNumber = nextBlockNumber;
+    }
 }
 
 int HashRecordManager::DeleteWhereEquals(unsigned int columnId, span<unsigned char> data)
@@ -193,7 +733,26 @@ int HashRecordManager::DeleteWhereEquals(unsigned int columnId, span<unsigned ch
 
 FileHead* HashRecordManager::CreateNewFileHead(Schema* schema)
 {
-    return new HashFileHead(schema);
+    auto fileHead = new HashFileHead(schema);
+    if (schema != nullptr)
+    {
+        // New file, the directory is part of the head from the start so its size is known
+        fileHead->Mode = m_Mode;
+        if (m_Mode == +HashingMode::EXTENDIBLE) {
+            while ((1u << fileHead->GlobalDepth) < (unsigned int)m_NumberOfBuckets) {
+                fileHead->GlobalDepth++;
+            }
+            fileHead->SetBucketCount(1 << fileHead->GlobalDepth);
+            for (auto& bucket : fileHead->Buckets) {
+                bucket.localDepth = fileHead->GlobalDepth;
+            }
+        }
+        else {
+            fileHead->SetBucketCount(m_NumberOfBuckets);
+            fileHead->MaxLoadFactor = m_MaxLoadFactor;
+        }
+    }
+    return fileHead;
 }
 
 FileWrapper<FileHead>* HashRecordManager::GetFile()
@@ -203,7 +762,17 @@ FileWrapper<FileHead>* HashRecordManager::GetFile()
 
 void HashRecordManager::DeleteInternal(unsigned long long recordId, unsigned long long blockId, unsigned long long recordNumberInBlock)
 {
-    Delete(recordId);
+    // The position given is tried first. Earlier removals may have moved the record since it was taken,
+    // then it is looked up by id in the chain of its bucket
+    span<unsigned char> record;
+    auto blockNumber = blockId;
+    auto inPlace = blockId < GetBlocksCount() && ReadBlock(m_ReadBlock, blockId) &&
+        m_ReadBlock->GetRecordSpan(recordNumberInBlock, &record) && *(unsigned long long*)record.data() == recordId;
+    if (!inPlace && !FindRecord(recordId, blockNumber, recordNumberInBlock)) {
+        Assert(false, "Record not found");
+        return;
+    }
+    RemoveRecord(recordId, blockNumber, recordNumberInBlock);
 }
 
 void HashRecordManager::Reorganize()
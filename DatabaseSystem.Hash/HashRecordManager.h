@@ -9,19 +9,44 @@
 	Hash externo esttico, com registros distribudos segundo o campo Id como chave de hashing.
 	Foi utilizada a funo mdulo usando o nmero de buckets alocados como funo de hashing.
 	O tratamento de coliso foi feito por meio do conjunto de overflow buckets.
+	No modo extensvel (HashingMode::EXTENDIBLE) os bits menos significativos do Id indexam um diretrio de buckets
+	de um bloco cada. O bucket cheio  dividido em dois, dobrando o diretrio quando sua profundidade local alcana a global,
+	ento a busca por Id l um s bloco qualquer que seja o tamanho do arquivo. O diretrio fica no cabealho do arquivo.
+	No modo linear (HashingMode::LINEAR) um bucket  dividido a cada vez que a taxa de ocupao passa do limite, na ordem
+	dada pelo ponteiro de diviso, ento o arquivo cresce um bucket por vez e cada insero divide no mximo uma cadeia.
 */
 class HashRecordManager : public BaseRecordManager
 {
 public:
-	HashRecordManager(size_t blockSize, unsigned int numberOfBuckets);
-	virtual void Create(string path, Schema* schema) override;
+	HashRecordManager(size_t blockSize, unsigned int numberOfBuckets, BufferPool* bufferPool = nullptr);
+	// Extendible hashing starts with the number of buckets rounded up to a power of two, and grows from there.
+	// Linear hashing starts with the number of buckets and adds one when the load factor passes maxLoadFactor
+	HashRecordManager(size_t blockSize, HashingMode mode, unsigned int numberOfBuckets, float maxLoadFactor = DefaultMaxLoadFactor, BufferPool* bufferPool = nullptr);
+	// The number of buckets is the one of the file, the one given to the constructor is only used by Create
 	virtual void Open(string path) override;
 
+	static constexpr float DefaultMaxLoadFactor = 0.8f;
+	// Buckets needed for the records to fill their head blocks up to the load factor, without overflow blocks
+	unsigned int GetRecommendedBucketCount(float loadFactor = DefaultMaxLoadFactor);
+	/*
+	* Rebuilds a static hash file with another number of buckets. The chains are read one bucket at a time and
+	* their records written to a new file, which then replaces the old one with a single rename, so a failure
+	* before that point leaves the old file as it was. The indexes are built again when next used.
+	*/
+	void Resize(unsigned int numberOfBuckets);
+
 	// Inherited via BaseRecordManager
 	virtual Record* Select(unsigned long long id) override;
-	virtual vector<Record*> SelectWhereEquals(unsigned int columnId, span<unsigned char> data) override;
+	// Reads each bucket chain once for all of the ids hashed to it
+	virtual ResultSet Select(vector<unsigned long long> ids) override;
+	// Conditions on the id only visit the bucket chains of the ids they allow
+	virtual ResultSet SelectWhere(const Predicate& predicate, const Projection* projection = nullptr) override;
+	virtual unique_ptr<RecordCursor> OpenCursorWhere(const Predicate& predicate) override;
 
 	virtual void Insert(Record record) override;
+	// Groups the records by bucket and writes each bucket chain once
+	virtual void InsertMany(span<const unsigned char> records) override;
+	using BaseRecordManager::InsertMany;
 	virtual void Delete(unsigned long long id) override;
 	virtual int DeleteWhereEquals(unsigned int columnId, span<unsigned char> data);
 
@@ -35,9 +60,32 @@ protected:
 private:
 	FileWrapper<HashFileHead>* m_File;
 	int m_NumberOfBuckets;
+	HashingMode m_Mode;
+	float m_MaxLoadFactor;
 
 	unsigned int hashFunction(unsigned long long key);
-	bool SelectSpan(unsigned long long id, span<unsigned char>* data);
+	// Finds the block and the position of the record in the chain of its bucket, the block is left in m_ReadBlock
+	bool FindRecord(unsigned long long id, unsigned long long& blockNumber, unsigned long long& recordNumberInBlock);
+	// Fills the place of the record found by FindRecord with the last record of the head block of the chain
+	void RemoveRecord(unsigned long long id, unsigned long long blockNumber, unsigned long long recordNumberInBlock);
+	// Adds the record to the head block of the chain of the bucket, or to a new head block when it is full
+	void AppendToChain(unsigned int bucketNumber, span<const unsigned char> record);
+	// Fills the head block of the chain of the bucket and writes the rest of the records to new blocks, each one written once
+	void AppendRecords(unsigned int bucketNumber, span<const unsigned char> records);
+	void InsertExtendible(Record& record);
+	// Splits the full bucket in m_ReadBlock by the bit after its local depth, doubling the directory if needed
+	void SplitBucket(unsigned int bucketNumber);
+	// Points every entry of the directory that shares the low localDepth bits of bucketNumber to the block
+	void SetBucketBlock(unsigned int bucketNumber, unsigned int localDepth, unsigned long long blockNumber);
+	// Linear hashing: splits the bucket at the split pointer into itself and a new bucket at the end of the directory
+	void SplitNextBucket();
+	// Writes the records as a chain, into the given blocks of the old chain first, and returns its head block
+	unsigned long long WriteChain(span<const unsigned char> records, vector<unsigned long long>& chainBlocks);
+	// A block of the free list when there is one, otherwise the block after the last one. Written by WriteAllocatedBlock
+	unsigned long long AllocateBlock();
+	void WriteAllocatedBlock(Block* block, unsigned long long blockNumber);
+	bool GetBuckets(const Predicate& predicate, vector<unsigned int>& buckets);
+	unique_ptr<RecordCursor> OpenBucketsCursor(vector<unsigned int> buckets, RecordCursor::FilterFunction filter);
 	
 	struct HashRecord {
 		unsigned long long Id;
@@ -0,0 +1,7 @@
+#pragma once
+
+#include "../DatabaseSystem.Core/BetterEnums.h"
+
+// How a hash file finds the bucket of an id: a fixed number of buckets with overflow chains, a directory that grows,
+// or buckets added one at a time as the file fills (see HashRecordManager)
+BETTER_ENUM(HashingMode, int, STATIC, EXTENDIBLE, LINEAR)
@@ -13,11 +13,11 @@ OrderedFileHead::~OrderedFileHead()
 void OrderedFileHead::Serialize(iostream &dst)
 {
   FileHead::Serialize(dst);
-  dst << OrderedByColumnId << endl;
+  WriteField(dst, OrderedByColumnId);
 }
 
 void OrderedFileHead::Deserialize(iostream &src)
 {
   FileHead::Deserialize(src);
-  src >> OrderedByColumnId;
+  ReadField(src, OrderedByColumnId);
 }
\ No newline at end of file
@@ -1,19 +1,23 @@
 #include "pch.h"
 #include "OrderedRecordManager.h"
+#include <numeric>
+#include <queue>
+#include <unordered_set>
 #include "../DatabaseSystem.Core/Assertions.h"
 
-OrderedRecordManager::OrderedRecordManager(size_t blockSize) : 
-    BaseRecordManager(),
-    m_File(new FileWrapper<OrderedFileHead>(blockSize)),
-    m_ExtensionFile(new FileWrapper<OrderedFileHead>(blockSize)),
+OrderedRecordManager::OrderedRecordManager(size_t blockSize, BufferPool* bufferPool) : 
+    BaseRecordManager(blockSize, bufferPool),
+    m_File(new FileWrapper<OrderedFileHead>(blockSize, 0, m_BufferPool)),
+    m_ExtensionFile(new FileWrapper<OrderedFileHead>(blockSize, 0, m_BufferPool)),
     m_OrderedByColumnId(0),
     m_MaxExtensionFileSize(1000),
     m_DeletedRecords(0),
-    m_MaxPercentEmptySpace(0.2)
+    m_MaxPercentEmptySpace(0.2),
+    m_BulkInserting(false)
 {
 }
 
-OrderedRecordManager::OrderedRecordManager(size_t blockSize, unsigned int orderedByColumnId) : OrderedRecordManager(blockSize)
+OrderedRecordManager::OrderedRecordManager(size_t blockSize, unsigned int orderedByColumnId, BufferPool* bufferPool) : OrderedRecordManager(blockSize, bufferPool)
 {
     m_OrderedByColumnId = orderedByColumnId;
 }
@@ -39,10 +43,29 @@ void OrderedRecordManager::Close()
     {
         ReorganizeInternal();
     }
+    CloseIndexes();
     m_File->Close();
     m_ExtensionFile->Close();
 }
 
+void OrderedRecordManager::SetFileAccessMode(FileAccessMode mode)
+{
+    m_File->SetAccessMode(mode);
+    m_ExtensionFile->SetAccessMode(mode);
+}
+
+void OrderedRecordManager::SetWriteBack(bool enabled)
+{
+    m_File->SetWriteBack(enabled);
+    m_ExtensionFile->SetWriteBack(enabled);
+}
+
+void OrderedRecordManager::Checkpoint()
+{
+    BaseRecordManager::Checkpoint();
+    m_ExtensionFile->Checkpoint();
+}
+
 
 unsigned long long OrderedRecordManager::GetBlocksCount()
 {
@@ -64,7 +87,7 @@ void OrderedRecordManager::Insert(Record record)
         m_WriteBlock->Clear();
 
         auto blocksCount = m_ExtensionFile->GetHead()->GetBlocksCount();
-        if (blocksCount == m_MaxExtensionFileSize)
+        if (blocksCount >= m_MaxExtensionFileSize)
         {
             // if Extension File has reached max size, call Reorder
             ReorganizeInternal();
@@ -73,6 +96,8 @@ void OrderedRecordManager::Insert(Record record)
 
     auto recordData = record.GetData();
     m_WriteBlock->Append(*recordData);
+    // The write block is written as the block after the last one
+    AddToIndexes(*recordData, GetBlocksCount(), m_WriteBlock->GetRecordsCount() - 1);
 }
 
 Record *OrderedRecordManager::Select(unsigned long long id)
@@ -115,185 +140,337 @@ Record *OrderedRecordManager::Select(unsigned long long id)
     return BaseRecordManager::Select(id);
 }
 
-vector<Record *> OrderedRecordManager::SelectWhereBetween(unsigned int columnId, span<unsigned char> min, span<unsigned char> max)
+ResultSet OrderedRecordManager::Select(vector<unsigned long long> ids)
 {
-    // if the file is ordered by the column we are selecting
-    if (columnId == m_OrderedByColumnId) {
-        ClearAccessCount();
-        unsigned long long accessedBlocks = 0;
-
-        auto records = vector<Record*>();
-        auto schema = GetSchema();
-        auto column = schema->GetColumn(columnId);
-
-        unsigned long long blockId;
-        unsigned long long recordNumberInBlock;
+    // Only a main file ordered by the id can be merged against the ids
+    if (m_OrderedByColumnId != 0) {
+        return BaseRecordManager::Select(ids);
+    }
 
-        // binary search min
-        auto evalFunc = [](int eval) {
-            if (eval >= 0) { // value >= target
+    ClearAccessCount();
+    sort(ids.begin(), ids.end());
+    ids.erase(unique(ids.begin(), ids.end()), ids.end());
+
+    auto records = ResultSet(GetSchema());
+    auto recordSize = m_ReadBlock->GetRecordSize();
+    auto findInBlock = [&](Block* block, unsigned long long id) {
+        auto blockRecords = block->GetRecords();
+        for (size_t i = 0; i < block->GetRecordsCount(); i++) {
+            auto record = blockRecords.subspan(i * recordSize, recordSize);
+            if (*(unsigned long long*)record.data() == id) {
+                records.Append(record);
                 return true;
             }
-            return false;
-        };
-        auto currentRecord = BinarySearch(min, evalFunc, accessedBlocks);
-        if (currentRecord != nullptr)
-        {
-            // if min was found, it might not be the first instance
-            // MovePrev until finding first
-            while (MovePrev(currentRecord, accessedBlocks, blockId, recordNumberInBlock))
-            {
-                auto value = schema->GetValue(currentRecord->GetData(), columnId);
+        }
+        return false;
+    };
 
-                if (Column::Compare(column, value, min) < 0)
-                {
-                    break;
-                }
+    // Largest id of a block of the main file, the removed records are marked and skipped
+    unsigned long long loadedBlock = -1;
+    auto lastIdOf = [&](unsigned long long blockNumber) {
+        if (loadedBlock != blockNumber) {
+            GetBlockFromMainFile(m_ReadBlock, blockNumber);
+            loadedBlock = blockNumber;
+        }
+        auto blockRecords = m_ReadBlock->GetRecords();
+        unsigned long long lastId = 0;
+        for (size_t i = 0; i < m_ReadBlock->GetRecordsCount(); i++) {
+            auto id = *(unsigned long long*)(blockRecords.data() + i * recordSize);
+            if (id != (unsigned long long)-1) {
+                lastId = max(lastId, id);
             }
+        }
+        return lastId;
+    };
 
-            // at this point we should be at the first record 
-            // MoveNext while record is smaller than max
-            while (MoveNext(currentRecord, accessedBlocks, blockId, recordNumberInBlock))
-            {
-                auto value = schema->GetValue(currentRecord->GetData(), columnId);
+    // The ids only move forward in the main file: gallop from the block of the previous id
+    // and binary search the range found, so close ids cost a block or two and far ones a log.
+    // When there are enough ids to touch most blocks anyway, a sequential merge reads each block once
+    unsigned long long blocksCount = m_File->GetHead()->GetBlocksCount();
+    auto gallop = ids.size() * bit_width(blocksCount) < blocksCount;
+    unsigned long long firstBlock = 0;
+    unordered_set<unsigned long long> notFound;
+    for (auto id : ids) {
+        auto low = firstBlock;
+        auto high = firstBlock;
+        unsigned long long step = 1;
+        while (high < blocksCount && lastIdOf(high) < id) {
+            low = high + 1;
+            high += step;
+            if (gallop) {
+                step *= 2;
+            }
+        }
+        if (low >= blocksCount) {
+            firstBlock = blocksCount;
+            notFound.insert(id);
+            continue;
+        }
 
-                if (Column::Compare(column, value, max) > 0) {
-                    break;
-                }
+        high = min(high, blocksCount - 1);
+        while (low < high) {
+            auto middle = low + (high - low) / 2;
+            if (lastIdOf(middle) < id) {
+                low = middle + 1;
+            }
+            else {
+                high = middle;
+            }
+        }
+        firstBlock = low;
 
-                if (Column::Compare(column, value, min) >= 0 && Column::Compare(column, value, max) <= 0)
-                {
-                    auto newRecord = new Record(schema);
-                    memcpy(newRecord->GetData()->data(), currentRecord->GetData()->data(), schema->GetSize());
-                    records.push_back(newRecord);
-                }
+        lastIdOf(low);
+        if (!findInBlock(m_ReadBlock, id)) {
+            notFound.insert(id);
+        }
+    }
+
+    // The rest can only be in the extension file or in the write block, both unordered
+    auto takeFromBlock = [&](Block* block) {
+        auto blockRecords = block->GetRecords();
+        for (size_t i = 0; i < block->GetRecordsCount() && !notFound.empty(); i++) {
+            auto record = blockRecords.subspan(i * recordSize, recordSize);
+            if (notFound.erase(*(unsigned long long*)record.data()) > 0) {
+                records.Append(record);
             }
         }
-        // at this point, the range is not present in the main file 
-        // OR we found all records in the range in the main file 
-        // OR we stopped somewhere in the extension file
-        // there might still be records in the range in the extension file
+    };
+    auto extensionBlocksCount = m_ExtensionFile->GetHead()->GetBlocksCount();
+    for (unsigned long long blockNumber = 0; blockNumber < extensionBlocksCount && !notFound.empty(); blockNumber++) {
+        GetBlockFromExtension(m_ReadBlock, blockNumber);
+        takeFromBlock(m_ReadBlock);
+    }
+    if (!notFound.empty()) {
+        takeFromBlock(m_WriteBlock);
+    }
+    return records;
+}
 
-        auto mainFileblocksCount = m_File->GetHead()->GetBlocksCount();
-        if (m_NextReadBlockNumber < mainFileblocksCount || currentRecord == nullptr) // we stopped somewhere in the main file
+void OrderedRecordManager::InsertMany(span<const unsigned char> records)
+{
+    ClearAccessCount();
+    auto schema = GetSchema();
+    auto recordSize = (size_t)schema->GetSize();
+    auto recordsCount = records.size() / recordSize;
+    auto extensionHead = m_ExtensionFile->GetHead();
+
+    // Ids follow the input order, then the batch is sorted by the ordering column
+    auto batch = vector<unsigned char>(records.begin(), records.begin() + recordsCount * recordSize);
+    for (size_t i = 0; i < recordsCount; i++)
+    {
+        auto id = extensionHead->NextId;
+        extensionHead->NextId += 1;
+        memcpy(batch.data() + i * recordSize, &id, sizeof(id));
+    }
+
+    auto& column = schema->GetColumn(m_OrderedByColumnId);
+    auto order = vector<size_t>(recordsCount);
+    iota(order.begin(), order.end(), 0);
+    sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        auto valueA = span<unsigned char>(batch.data() + a * recordSize + column.Offset, column.Length);
+        auto valueB = span<unsigned char>(batch.data() + b * recordSize + column.Offset, column.Length);
+        return Column::Compare(column, valueA, valueB) < 0;
+    });
+
+    // The full blocks of the sorted batch are a run of the extension file, each block written once.
+    // A run that starts after the last record of the main file (always the case when ordered by Id)
+    // is appended to the main file instead and never has to be merged
+    auto runBlocksCount = recordsCount / m_RecordsPerBlock;
+    size_t next = 0;
+    if (runBlocksCount > 0)
+    {
+        auto appendToMainFile = true;
+        auto mainBlocksCount = m_File->GetHead()->GetBlocksCount();
+        if (mainBlocksCount > 0)
         {
-            // we found all records in the range in the main file
-            // move to the star of extension file and continue
-            MoveToExtension();
-            currentRecord = new Record(schema);
+            GetBlockFromMainFile(m_ReadBlock, mainBlocksCount - 1);
+            span<unsigned char> lastRecord;
+            m_ReadBlock->GetRecordSpan(m_ReadBlock->GetRecordsCount() - 1, &lastRecord);
+            auto firstValue = span<unsigned char>(batch.data() + order[0] * recordSize + column.Offset, column.Length);
+            appendToMainFile = Column::Compare(column, firstValue, lastRecord.subspan(column.Offset, column.Length)) >= 0;
         }
-
-        // m_NextBlockNumber is somewhere in the extension file
-        // linear search extension file continuing from that point
-        while (MoveNext(currentRecord, accessedBlocks, blockId, recordNumberInBlock))
+        if (appendToMainFile && GetBlocksCount() + m_WriteBlock->GetRecordsCount() > mainBlocksCount)
         {
-            auto value = schema->GetValue(currentRecord->GetData(), columnId);
+            // The extension blocks and the write block come after the main file, they move with it
+            InvalidateIndexes();
+        }
+
+        Partition run;
+        run.firstBlock = extensionHead->GetBlocksCount();
+        run.blocksCount = runBlocksCount;
+        run.level = 0;
 
-            if (Column::Compare(column, value, min) >= 0 && Column::Compare(column, value, max) <= 0)
+        auto block = unique_ptr<Block>(m_File->CreateBlock());
+        for (unsigned long long blockId = 0; blockId < runBlocksCount; blockId++)
+        {
+            block->Clear();
+            while (block->GetRecordsCount() < m_RecordsPerBlock)
+            {
+                block->Append(span<const unsigned char>(batch.data() + order[next++] * recordSize, recordSize));
+            }
+            auto runBlockId = appendToMainFile ? (unsigned long long)m_File->GetHead()->GetBlocksCount() : GetBlocksCount();
+            if (appendToMainFile)
+            {
+                AddBlock(block.get());
+            }
+            else
             {
-                auto newRecord = new Record(schema);
-                memcpy(newRecord->GetData()->data(), currentRecord->GetData()->data(), schema->GetSize());
-                records.push_back(newRecord);
+                AddToExtension(block.get());
+            }
+            for (unsigned int recordNumber = 0; recordNumber < block->GetRecordsCount(); recordNumber++)
+            {
+                AddToIndexes(block.get(), runBlockId, recordNumber);
             }
         }
-        return records;
+        if (!appendToMainFile)
+        {
+            m_ExtensionRuns.push_back(run);
+        }
     }
-    // if the file is not ordered by id, linear search everything
-    return BaseRecordManager::SelectWhereBetween(columnId, min, max);
 
+    // The rest waits in the write block, like the records inserted one by one
+    for (; next < recordsCount; next++)
+    {
+        if (m_WriteBlock->GetRecordsCount() == m_RecordsPerBlock)
+        {
+            AddToExtension(m_WriteBlock);
+            m_WriteBlock->Clear();
+        }
+        m_WriteBlock->Append(span<const unsigned char>(batch.data() + order[next] * recordSize, recordSize));
+        AddToIndexes(m_WriteBlock, GetBlocksCount(), m_WriteBlock->GetRecordsCount() - 1);
+    }
+
+    if (!m_BulkInserting && extensionHead->GetBlocksCount() >= m_MaxExtensionFileSize)
+    {
+        ReorganizeInternal();
+    }
 }
 
-vector<Record *> OrderedRecordManager::SelectWhereEquals(unsigned int columnId, span<unsigned char> data)
+void OrderedRecordManager::BeginBulkInsert()
 {
-    // if the file is ordered by the column we are selecting
-    if (columnId == m_OrderedByColumnId) {
+    m_BulkInserting = true;
+}
 
-        ClearAccessCount();
-        unsigned long long accessedBlocks = 0;
+void OrderedRecordManager::EndBulkInsert()
+{
+    m_BulkInserting = false;
+    if (!m_ExtensionRuns.empty())
+    {
+        ReorganizeInternal();
+    }
+}
 
-        unsigned long long blockId;
-        unsigned long long recordNumberInBlock;
+ResultSet OrderedRecordManager::SelectWhere(const Predicate& predicate, const Projection* projection)
+{
+    vector<unsigned char> min, max;
+    if (!predicate.GetRange(GetSchema(), m_OrderedByColumnId, min, max))
+    {
+        return BaseRecordManager::SelectWhere(predicate, projection);
+    }
 
-        auto records = vector<Record*>();
-        auto schema = GetSchema();
-        auto column = schema->GetColumn(columnId);
+    // The blocks read by the search are not returned by the cursor, they are added back
+    ClearAccessCount();
+    auto cursor = OpenRangeCursor(min, max, predicate.ToFilter(GetSchema()));
+    auto searchReadsCount = m_LastQueryBlockReadAccessCount;
+    auto records = Materialize(*cursor, projection);
+    m_LastQueryBlockReadAccessCount += searchReadsCount;
+    return records;
+}
 
-        // try to binary search m_File
-        auto evalFunc = [](int eval) {
-            if (eval == 0) { // equal
-                return true;
-            }
-            return false;
-        };
-        auto currentRecord = BinarySearch(data, evalFunc, accessedBlocks);
-        if (currentRecord != nullptr)
+unique_ptr<RecordCursor> OrderedRecordManager::OpenCursorWhere(const Predicate& predicate)
+{
+    vector<unsigned char> min, max;
+    if (!predicate.GetRange(GetSchema(), m_OrderedByColumnId, min, max))
+    {
+        return BaseRecordManager::OpenCursorWhere(predicate);
+    }
+    return OpenRangeCursor(min, max, predicate.ToFilter(GetSchema()));
+}
+
+unique_ptr<RecordCursor> OrderedRecordManager::OpenRangeCursor(vector<unsigned char> min, vector<unsigned char> max, RecordCursor::FilterFunction filter)
+{
+    // Visits the write block, the main file blocks that can hold values in [min, max] and the whole extension file.
+    // An empty bound is open
+    auto& column = GetSchema()->GetColumn(m_OrderedByColumnId);
+    auto mainBlocksCount = m_File->GetHead()->GetBlocksCount();
+    auto firstBlockId = min.empty() ? 0 : FindFirstBlock(min);
+
+    auto nextBlockId = firstBlockId;
+    auto writeBlockVisited = false;
+    auto nextBlock = [this, &column, max, mainBlocksCount, nextBlockId, writeBlockVisited](Block* buffer) mutable -> Block* {
+        if (!writeBlockVisited)
         {
-            // if data was found, it might not be the first instance
-            // MovePrev until finding first
-            while (MovePrev(currentRecord, accessedBlocks, blockId, recordNumberInBlock))
+            writeBlockVisited = true;
+            if (m_WriteBlock->GetRecordsCount() > 0)
             {
-                auto value = schema->GetValue(currentRecord->GetData(), columnId);
-
-                if (!Column::Equals(column, value, data))
-                {
-                    break;
-                }
+                m_LastQueryBlockReadAccessCount++;
+                return m_WriteBlock;
             }
-
-            // at this point we should be at the first record 
-            // MoveNext until record is different than data
-            auto enteredRange = false;
-            while (MoveNext(currentRecord, accessedBlocks, blockId, recordNumberInBlock))
+        }
+        if (nextBlockId < mainBlocksCount)
+        {
+            GetBlockFromMainFile(buffer, nextBlockId++, false);
+            span<unsigned char> firstValue;
+            if (max.empty() || !GetValidValue(buffer, true, &firstValue) || Column::Compare(column, firstValue, max) <= 0)
             {
-                auto value = schema->GetValue(currentRecord->GetData(), columnId);
-
-                // the value of records found here should all be equal to data
-                // when records value != data, we left the range and should stop adding data to the return vector
-                // however, we can move too far back when searching for first instance
-                if (enteredRange && !Column::Equals(column, value, data)) { // if we have started to see records with value == data AND the current value is different
-                    // we have left the range and should stop
-                    break;
-                }
-
-                if (Column::Equals(column, value, data))
-                {
-                    enteredRange = true; // found something equal to data, we are inside the range
-                    auto newRecord = new Record(schema);
-                    memcpy(newRecord->GetData()->data(), currentRecord->GetData()->data(), schema->GetSize());
-                    records.push_back(newRecord);
-                }
+                return buffer;
             }
+            // Past the range, the following blocks of the main file only hold larger values
+            nextBlockId = mainBlocksCount;
         }
-        // at this point, the data is not present in the main file OR we found all records equal to data in the main file OR we stopped somewhere in the extension file
-        // there might still be records in the range in the extension file
-
-        auto mainFileblocksCount = m_File->GetHead()->GetBlocksCount();
-        if (m_NextReadBlockNumber < mainFileblocksCount || currentRecord == nullptr) // we stopped somewhere in the main file
+        auto extensionBlockId = nextBlockId - mainBlocksCount;
+        if (extensionBlockId >= m_ExtensionFile->GetHead()->GetBlocksCount())
         {
-            // we found all records equal to data in the main file
-            // move to the star of extension file and continue
-            MoveToExtension();
-            currentRecord = new Record(schema);
+            return nullptr;
         }
+        GetBlockFromExtension(buffer, extensionBlockId, false);
+        nextBlockId++;
+        return buffer;
+    };
+    return make_unique<RecordCursor>(GetSchema(), unique_ptr<Block>(m_File->CreateBlock()), nextBlock, filter);
+}
 
-
-        // m_NextBlockNumber is somewhere in the extension file
-        // linear search extension file continuing from that point
-        while (MoveNext(currentRecord, accessedBlocks, blockId, recordNumberInBlock))
+unsigned long long OrderedRecordManager::FindFirstBlock(span<unsigned char> min)
+{
+    // Binary search of the first block of the main file whose last value is not smaller than min.
+    // Blocks where every record was deleted are taken as not smaller, the search may only start earlier
+    auto& column = GetSchema()->GetColumn(m_OrderedByColumnId);
+    auto block = unique_ptr<Block>(m_File->CreateBlock());
+    unsigned long long low = 0;
+    auto high = m_File->GetHead()->GetBlocksCount();
+    while (low < high)
+    {
+        auto middle = low + (high - low) / 2;
+        GetBlockFromMainFile(block.get(), middle);
+        span<unsigned char> lastValue;
+        if (GetValidValue(block.get(), false, &lastValue) && Column::Compare(column, lastValue, min) < 0)
         {
-            auto value = schema->GetValue(currentRecord->GetData(), columnId);
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return low;
+}
 
-            if (Column::Equals(column, value, data))
-            {
-                auto newRecord = new Record(schema);
-                memcpy(newRecord->GetData()->data(), currentRecord->GetData()->data(), schema->GetSize());
-                records.push_back(newRecord);
-            }
+bool OrderedRecordManager::GetValidValue(Block* block, bool first, span<unsigned char>* value)
+{
+    // Value of the ordering column of the first (or last) record of the block that was not deleted
+    auto& column = GetSchema()->GetColumn(m_OrderedByColumnId);
+    auto recordsCount = block->GetRecordsCount();
+    for (unsigned int i = 0; i < recordsCount; i++)
+    {
+        span<unsigned char> record;
+        block->GetRecordSpan(first ? i : recordsCount - 1 - i, &record);
+        if (((OrderedRecord*)record.data())->Id != -1)
+        {
+            *value = record.subspan(column.Offset, column.Length);
+            return true;
         }
-        return records;
     }
-    // if the file is not ordered by id, linear search everything
-    return BaseRecordManager::SelectWhereEquals(columnId, data);
+    return false;
 }
 
 void OrderedRecordManager::Delete(unsigned long long id)
@@ -301,6 +478,10 @@ void OrderedRecordManager::Delete(unsigned long long id)
     auto schema = GetSchema();
     
     auto record = Select(id);
+    if (record != nullptr)
+    {
+        RemoveFromIndexes(*record->GetData());
+    }
     auto blockId = m_NextReadBlockNumber - 1;
     auto recordNumberInBlock = m_ReadBlock->GetPosition() - 1;
 
@@ -329,7 +510,7 @@ int OrderedRecordManager::DeleteWhereEquals(unsigned int columnId, span<unsigned
         unsigned long long recordNumberInBlock;
 
         int removedCount = 0;
-        auto column = schema->GetColumn(columnId);
+        auto& column = schema->GetColumn(columnId);
 
         // try to binary search m_File
         auto evalFunc = [](int eval) {
@@ -372,6 +553,7 @@ int OrderedRecordManager::DeleteWhereEquals(unsigned int columnId, span<unsigned
                 {
                     enteredRange = true; // found something equal to data, we are inside the range
                     removedCount++;
+                    RemoveFromIndexes(*currentRecord->GetData());
                     DeleteInternal(currentRecord->getId(), blockId, recordNumberInBlock);
                 }
             }
@@ -397,6 +579,7 @@ int OrderedRecordManager::DeleteWhereEquals(unsigned int columnId, span<unsigned
             if (Column::Equals(column, value, data))
             {
                 removedCount++;
+                RemoveFromIndexes(*currentRecord->GetData());
                 DeleteInternal(currentRecord->getId(), blockId, recordNumberInBlock);
             }
         }
@@ -555,19 +738,17 @@ void OrderedRecordManager::WriteToExtension(Block* block, unsigned long long blo
     m_LastQueryBlockWriteAccessCount++;
 }
 
-bool OrderedRecordManager::GetBlockFromExtension(Block* block, unsigned long long blockNumber)
+bool OrderedRecordManager::GetBlockFromExtension(Block* block, unsigned long long blockNumber, bool keepInPool)
 {
-    block->Clear();
-    auto r = m_ExtensionFile->GetBlock(blockNumber, block);
+    auto r = m_ExtensionFile->GetBlock(blockNumber, block, keepInPool);
     block->MoveToStart();
     m_LastQueryBlockReadAccessCount++;
     return r;
 }
 
-bool OrderedRecordManager::GetBlockFromMainFile(Block* block, unsigned long long blockNumber)
+bool OrderedRecordManager::GetBlockFromMainFile(Block* block, unsigned long long blockNumber, bool keepInPool)
 {
-    block->Clear();
-    auto r = m_File->GetBlock(blockNumber, block);
+    auto r = m_File->GetBlock(blockNumber, block, keepInPool);
     block->MoveToStart();
     m_LastQueryBlockReadAccessCount++;
     return r;
@@ -592,22 +773,36 @@ FileWrapper<FileHead>* OrderedRecordManager::GetFile()
     return (FileWrapper<FileHead>*)m_File;
 }
 
-bool OrderedRecordManager::ReadBlock(Block* block, unsigned long long blockId)
+bool OrderedRecordManager::ReadBlock(Block* block, unsigned long long blockId, bool keepInPool)
 {
     bool r;
-    block->Clear();
     auto mainFileBlockCount = m_File->GetHead()->GetBlocksCount();
     if (blockId < mainFileBlockCount) {
-        r = GetBlockFromMainFile(block, blockId);
+        r = GetBlockFromMainFile(block, blockId, keepInPool);
     }
     else {
-        auto correctedBlockId = m_NextReadBlockNumber - mainFileBlockCount;
-        r = GetBlockFromExtension(block, correctedBlockId);
+        auto correctedBlockId = blockId - mainFileBlockCount;
+        r = GetBlockFromExtension(block, correctedBlockId, keepInPool);
     }
     block->MoveToStart();
     return r;
 }
 
+void OrderedRecordManager::ReadBlocks(unsigned long long firstBlockId, size_t count, span<unsigned char> destination)
+{
+    // A range may start in the main file and end in the extension file
+    auto mainFileBlockCount = m_File->GetHead()->GetBlocksCount();
+    size_t mainFileCount = 0;
+    if (firstBlockId < mainFileBlockCount) {
+        mainFileCount = (size_t)min((unsigned long long)count, mainFileBlockCount - firstBlockId);
+        m_File->ReadBlocks(firstBlockId, mainFileCount, destination);
+    }
+    if (mainFileCount < count) {
+        auto extensionData = destination.subspan(mainFileCount * m_File->GetBlockSize());
+        m_ExtensionFile->ReadBlocks(firstBlockId + mainFileCount - mainFileBlockCount, count - mainFileCount, extensionData);
+    }
+}
+
 bool GetRecord(Block *block, Record *record)
 {
     auto recordData = record->GetData();
@@ -622,7 +817,8 @@ bool GetRecord(Block *block, Record *record, unsigned int offset)
 
 function<bool(Record, Record)> MakeComparer(Schema* schema, unsigned int columnId)
 {
-    return [schema, columnId](Record a, Record b) {
+    auto& column = schema->GetColumn(columnId);
+    return [schema, columnId, &column](Record a, Record b) {
 
 
         // if both records deleted, keep order
@@ -636,7 +832,6 @@ function<bool(Record, Record)> MakeComparer(Schema* schema, unsigned int columnI
 
         auto valueA = schema->GetValue(a.GetData(), columnId);
         auto valueB = schema->GetValue(b.GetData(), columnId);
-        auto column = schema->GetColumn(columnId);
 
         // if both record valid, swap records if first is larger
         return Column::Compare(column, valueA, valueB) < 0;
@@ -657,75 +852,156 @@ void OrderedRecordManager::Reorganize()
 
 void OrderedRecordManager::ReorganizeInternal()
 {
-    auto schema = GetSchema();
     if (DEBUG)
     {
         MemoryReorder();
         return;
     }
+    MergeExtension();
+}
 
-    unsigned long long accessedBlocks = 0;
-
-    Record record = Record(schema);
-    auto recordSize = schema->GetSize();
-
-    auto comparer = MakeComparer(schema, m_OrderedByColumnId);
-
-    // Sort blocks from m_ExtensionFile and insert them into m_File
-    auto blocksCount = m_ExtensionFile->GetHead()->GetBlocksCount();
+void OrderedRecordManager::MergeExtension()
+{
+    auto schema = GetSchema();
+    auto& column = schema->GetColumn(m_OrderedByColumnId);
+    auto recordSize = (size_t)schema->GetSize();
+    auto mainBlocksCount = m_File->GetHead()->GetBlocksCount();
+    auto extensionBlocksCount = m_ExtensionFile->GetHead()->GetBlocksCount();
+    if (extensionBlocksCount == 0)
+    {
+        m_ExtensionRuns.clear();
+        return;
+    }
+    // Every record may move to another block
+    InvalidateIndexes();
 
-    unsigned long long blockId;
-    for (blockId = 0; blockId < blocksCount; blockId++)
+    // The main file is one run, the extension blocks outside the runs of InsertMany are runs of their own
+    auto runs = vector<MergeRun>();
+    if (mainBlocksCount > 0)
     {
-        auto blockRecords = vector<Record>();
-        GetBlockFromExtension(m_ReadBlock, blockId);
-        while (GetRecord(m_ReadBlock, &record))
+        runs.push_back({ m_File, 0, mainBlocksCount, true });
+    }
+    sort(m_ExtensionRuns.begin(), m_ExtensionRuns.end(), [](const Partition& a, const Partition& b) {
+        return a.firstBlock < b.firstBlock;
+    });
+    unsigned long long blockId = 0;
+    for (auto& extensionRun : m_ExtensionRuns)
+    {
+        for (; blockId < extensionRun.firstBlock; blockId++)
         {
-            blockRecords.push_back(record);
+            runs.push_back({ m_ExtensionFile, blockId, blockId + 1, false });
         }
+        runs.push_back({ m_ExtensionFile, extensionRun.firstBlock, extensionRun.firstBlock + extensionRun.blocksCount, true });
+        blockId = extensionRun.firstBlock + extensionRun.blocksCount;
+    }
+    for (; blockId < extensionBlocksCount; blockId++)
+    {
+        runs.push_back({ m_ExtensionFile, blockId, blockId + 1, false });
+    }
 
-        sort(blockRecords.begin(), blockRecords.end(), comparer);
-
-        // Write sorted data into block and add block into m_File
-        m_WriteBlock->Clear();
-        for (auto record : blockRecords)
+    auto getLast = [&](MergeRun& run) {
+        return span<unsigned char>(run.Records.data() + (run.RecordsLeft - 1) * recordSize + column.Offset, column.Length);
+    };
+    auto isBefore = [&](size_t a, size_t b) {
+        return Column::Compare(column, getLast(runs[a]), getLast(runs[b])) < 0;
+    };
+    auto queue = priority_queue<size_t, vector<size_t>, decltype(isBefore)>(isBefore);
+    auto buffer = unique_ptr<Block>(m_File->CreateBlock());
+    for (size_t i = 0; i < runs.size(); i++)
+    {
+        if (LoadPrevBlock(runs[i], buffer.get()))
         {
-            auto recordData = record.GetData();
-            m_WriteBlock->Append(*recordData);
+            queue.push(i);
         }
-        AddBlock(m_WriteBlock);
     }
-    m_ExtensionFile->SeekHead();
 
-    // Split m_File into partitions of size 1 block
-    blocksCount = m_File->GetHead()->GetBlocksCount();
-    auto partitions = vector<Partition>();
-    Partition fullFile;
-    fullFile.firstBlock = 0;
-    fullFile.blocksCount = blocksCount;
-    fullFile.level = 0;
-    partitions.push_back(fullFile);
-    while (partitions.size() < blocksCount)
+    /*
+    * Every block is full, so the merged file has the blocks of both files and the largest records
+    * can be written first, from its last block backwards. The output block being written never
+    * comes before the main file block being read, whose records are already in memory.
+    */
+    auto outputBlockId = mainBlocksCount + extensionBlocksCount;
+    m_File->GetHead()->SetBlocksCount(outputBlockId);
+    // The write block keeps the records that are in neither file
+    auto outputBlock = unique_ptr<Block>(m_File->CreateBlock());
+    auto outputRecords = vector<unsigned char>(m_RecordsPerBlock * recordSize);
+    auto outputLeft = (size_t)m_RecordsPerBlock;
+    while (!queue.empty())
     {
-        partitions = SplitPartitions(partitions);
-    }
+        auto i = queue.top();
+        queue.pop();
+        auto& run = runs[i];
+
+        outputLeft--;
+        memcpy(outputRecords.data() + outputLeft * recordSize, run.Records.data() + (run.RecordsLeft - 1) * recordSize, recordSize);
+        run.RecordsLeft--;
+        if (run.RecordsLeft > 0 || LoadPrevBlock(run, buffer.get()))
+        {
+            queue.push(i);
+        }
 
-    // Merge partitions into m_File, reordering
-    unsigned long deepestLevel = ceil(log2(blocksCount));
-    while (partitions.size() > 1)
-    {
-        partitions = MergePartitions(partitions, deepestLevel);
-        deepestLevel--;
+        if (outputLeft == 0)
+        {
+            outputBlock->Clear();
+            for (size_t recordNumber = 0; recordNumber < m_RecordsPerBlock; recordNumber++)
+            {
+                outputBlock->Append(span<const unsigned char>(outputRecords.data() + recordNumber * recordSize, recordSize));
+            }
+            WriteBlock(outputBlock.get(), --outputBlockId);
+            outputLeft = m_RecordsPerBlock;
+        }
     }
+    Assert(outputBlockId == 0 && outputLeft == m_RecordsPerBlock, "Merged blocks should fill the main file");
+
+    m_ExtensionRuns.clear();
+    m_ExtensionFile->SeekHead();
+    m_ExtensionFile->Trim();
+}
 
-    if (deepestLevel != 0)
+bool OrderedRecordManager::LoadPrevBlock(MergeRun& run, Block* buffer)
+{
+    auto schema = GetSchema();
+    auto recordSize = (size_t)schema->GetSize();
+    while (run.NextBlock > run.FirstBlock)
     {
-        Assert(false, "After full merge the full file partition should have level 0");
+        run.NextBlock--;
+        run.File->GetBlock(run.NextBlock, buffer, false);
+        m_LastQueryBlockReadAccessCount++;
+        Assert(buffer->GetRecordsCount() == m_RecordsPerBlock, "Merged blocks should be full");
+
+        // Copied out, the block may be written over by the merge before the run is done with it
+        auto records = buffer->GetRecords();
+        run.Records.assign(records.begin(), records.end());
+        run.RecordsLeft = buffer->GetRecordsCount();
+        if (!run.Sorted)
+        {
+            auto& column = schema->GetColumn(m_OrderedByColumnId);
+            auto order = vector<size_t>(run.RecordsLeft);
+            iota(order.begin(), order.end(), 0);
+            sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+                auto valueA = span<unsigned char>(run.Records.data() + a * recordSize + column.Offset, column.Length);
+                auto valueB = span<unsigned char>(run.Records.data() + b * recordSize + column.Offset, column.Length);
+                return Column::Compare(column, valueA, valueB) < 0;
+            });
+            auto sortedRecords = vector<unsigned char>(run.Records.size());
+            for (size_t i = 0; i < order.size(); i++)
+            {
+                memcpy(sortedRecords.data() + i * recordSize, run.Records.data() + order[i] * recordSize, recordSize);
+            }
+            run.Records = move(sortedRecords);
+        }
+
+        if (run.RecordsLeft > 0)
+        {
+            return true;
+        }
     }
+    return false;
 }
 
 void OrderedRecordManager::MemoryReorder()
 {
+    InvalidateIndexes();
     auto records = vector<Record>();
     auto schema = GetSchema();
     auto record = Record(schema);
@@ -753,6 +1029,7 @@ void OrderedRecordManager::MemoryReorder()
         }
     }
     m_ExtensionFile->SeekHead();
+    m_ExtensionFile->Trim();
 
     // Sort all records
     auto comparer = MakeComparer(schema, m_OrderedByColumnId);
@@ -771,13 +1048,15 @@ void OrderedRecordManager::MemoryReorder()
             m_WriteBlock->Clear();
         }
     }
+    // Deleted records may have left the file with fewer blocks than before
+    m_File->Trim();
 }
 
 Record* OrderedRecordManager::BinarySearch(span<unsigned char> target, EvalFunctionType evalFunc, unsigned long long& accessedBlocks)
 {
     auto recordCount = m_File->GetHead()->GetBlocksCount() * m_RecordsPerBlock;
     auto schema = GetSchema();
-    auto column = schema->GetColumn(m_OrderedByColumnId);
+    auto& column = schema->GetColumn(m_OrderedByColumnId);
 
     auto currentRecord = new Record(schema);
 
@@ -810,192 +1089,6 @@ Record* OrderedRecordManager::BinarySearch(span<unsigned char> target, EvalFunct
         }
     }
 
+    delete currentRecord;
     return nullptr;
 }
-
-vector<Partition> OrderedRecordManager::SplitPartitions(vector<Partition> partitions)
-{
-    auto splitPartitions = vector<Partition>();
-    // [                           (0,10,0)          ]
-    // [           (0,5,1),                    (5,5,1)   ] 
-    // [   (0,3,2),         (3,2,2),        (5,3,2),   (8,2,2) ]
-    // [(0,2,3),(2,1,3),(3,1,3),(4,1,3),(5,2,3)(7,1,3), (8,1,3), (9,1,3)]
-    // [(0,1,4),(1,1,4)(2,1,3),(3,1,3),(4,1,3),(5,1,4),(6,1,4),(7,1,3),(8,1,3),(9,1,3)]
-    // [(0,2,3),(2,1,3),(3,1,3),(4,1,3),(5,1,4),(6,1,4),(7,1,3),(8,1,3),(9,1,3)]
-    // [(0,2,3),(2,1,3),(3,1,3),(4,1,3),(5,2,3),(7,1,3),(8,1,3),(9,1,3)]
-    // [(0,3,2),(3,1,3),(4,1,3),(5,2,3),(7,1,3),(8,1,3),(9,1,3)]
-    // [(0,3,2),(3,2,2),(5,2,3),(7,1,3),(8,1,3),(9,1,3)]
-    // [(0,3,2),(3,2,2),(5,3,2),(8,1,3),(9,1,3)]
-    // [(0,3,2),(3,2,2),(5,3,2),(8,2,2)]
-    // [(0,5,1),(5,3,2),(8,2,2)]
-    // [(0,5,1),(5,5,1)]
-    // [(0,10,0)]
-    for (auto p : partitions)
-    {
-        if (p.blocksCount == 1)
-        {
-            splitPartitions.push_back(p);
-            continue;
-        }
-
-        auto splitP = Split(p);
-
-        splitPartitions.push_back(splitP[0]);
-        splitPartitions.push_back(splitP[1]);
-    }
-
-    return splitPartitions;
-}
-
-vector<Partition> OrderedRecordManager::Split(Partition p)
-{
-    auto splitPartition = vector<Partition>();
-    auto newBlocksCount = p.blocksCount / 2;
-    Partition p1;
-    Partition p2;
-
-    p1.firstBlock = p.firstBlock;
-    p1.blocksCount = newBlocksCount;
-    p1.level = p.level + 1;
-
-    p2.firstBlock = p.firstBlock + newBlocksCount;
-    p2.blocksCount = newBlocksCount;
-    p2.level = p.level + 1;
-
-    if (p.blocksCount % 2 != 0) // odd number of blocks in partition
-    {
-        p1.blocksCount += 1;
-        p2.firstBlock += 1;
-    }
-
-    splitPartition.push_back(p1);
-    splitPartition.push_back(p2);
-
-    return splitPartition;
-}
-
-vector<Partition> OrderedRecordManager::MergePartitions(vector<Partition> partitions, unsigned long deepestLevel)
-{
-    auto mergedPartitions = vector<Partition>();
-    auto i = 0;
-    while(i < partitions.size())
-    {
-        auto p1 = partitions[i];
-
-        if (p1.level < deepestLevel)
-        {
-            mergedPartitions.push_back(p1);
-            i++;
-            continue;
-        }
-        else if (p1.level == deepestLevel)
-        {
-            auto p2 = partitions[i + 1];
-
-            auto p = Merge(p1, p2);
-            mergedPartitions.push_back(p);
-            i += 2;
-        }
-        else
-        {
-            Assert(false, "Should not have partitions deeper than the deepest level");
-        }
-    }
-
-    return mergedPartitions;
-}
-
-Partition OrderedRecordManager::Merge(Partition p1, Partition p2)
-{
-    if (p1.level != p2.level)
-    {
-        Assert(false, "Should not merge partitions of different levels");
-    }
-    auto schema = GetSchema();
-    auto comparer = MakeComparer(schema, m_OrderedByColumnId);
-
-    auto recordPointer1 = p1.firstBlock * m_RecordsPerBlock;
-    auto lastRecordP1 = recordPointer1 + p1.blocksCount*m_RecordsPerBlock - 1;
-
-    auto recordPointer2 = p2.firstBlock * m_RecordsPerBlock;
-    auto lastRecordP2 = recordPointer2 + p2.blocksCount*m_RecordsPerBlock - 1;
-
-    auto readBlock1 = m_File->CreateBlock();
-    auto record1 = Record(schema);
-
-    auto readBlock2 = m_File->CreateBlock();
-    auto record2 = Record(schema);
-
-    unsigned long long writeBlockPointer = min(recordPointer1, recordPointer2) / m_RecordsPerBlock;
-
-    m_WriteBlock->Clear();
-    while (recordPointer1 <= lastRecordP1 && recordPointer2 <= lastRecordP2)
-    {
-        auto blockPointer1 = recordPointer1 / m_RecordsPerBlock;
-        auto recordOffset1 = recordPointer1 % m_RecordsPerBlock;
-
-        GetBlockFromMainFile(readBlock1, blockPointer1);
-        GetRecord(readBlock1, &record1, recordOffset1);
-
-
-        auto blockPointer2 = recordPointer2 / m_RecordsPerBlock;
-        auto recordOffset2 = recordPointer2 % m_RecordsPerBlock;
-
-        GetBlockFromMainFile(readBlock2, blockPointer2);
-        GetRecord(readBlock2, &record2, recordOffset2);
-
-        if (comparer(record1, record2)) // record 1 should come before record 2
-        {
-            auto recordData = record1.GetData();
-            m_WriteBlock->Append(*recordData);
-            recordPointer1++;
-        }
-        else // record 2 should come before record 1
-        {
-            auto recordData = record2.GetData();
-            m_WriteBlock->Append(*recordData);
-            recordPointer2++;
-        }
-
-        auto recordsInWriteBlock = m_WriteBlock->GetRecordsCount();
-        if (recordsInWriteBlock == m_RecordsPerBlock)
-        {
-            // write block to m_File at writeBlockPointer
-            WriteBlock(m_WriteBlock, writeBlockPointer);
-            m_WriteBlock->Clear();
-            writeBlockPointer++;
-        }
-    }
-
-    // one of the partitions is over, copy everything in the remaining partition into the file
-    auto remainingRecordPointer = (recordPointer1 > lastRecordP1) ? recordPointer2 : recordPointer1;
-    auto lastRecord = (remainingRecordPointer == recordPointer2) ? lastRecordP2 : lastRecordP1;
-    while (remainingRecordPointer <= lastRecord)
-    {
-        auto blockPointer = remainingRecordPointer / m_RecordsPerBlock;
-        auto recordOffset = remainingRecordPointer % m_RecordsPerBlock;
-
-        GetBlockFromMainFile(readBlock1, blockPointer);
-        GetRecord(readBlock1, &record1, recordOffset);
-
-        auto recordData = record1.GetData();
-        m_WriteBlock->Append(*recordData);
-        remainingRecordPointer++;
-
-        auto recordsInWriteBlock = m_WriteBlock->GetRecordsCount();
-        if (recordsInWriteBlock == m_RecordsPerBlock)
-        {
-            // write block to m_File at writeBlockPointer
-            WriteBlock(m_WriteBlock, writeBlockPointer);
-            m_WriteBlock->Clear();
-            writeBlockPointer++;
-        }
-    }
-
-    Partition mergedPartition;
-    mergedPartition.firstBlock = min(p1.firstBlock, p2.firstBlock);
-    mergedPartition.blocksCount = p1.blocksCount + p2.blocksCount;
-    mergedPartition.level = p1.level - 1;
-
-    return mergedPartition;
-}
@@ -22,17 +22,28 @@ typedef struct partition
 class OrderedRecordManager : public BaseRecordManager
 {
 public:
-    OrderedRecordManager(size_t blockSize);
-    OrderedRecordManager(size_t blockSize, unsigned int orderedByColumnId);
+    OrderedRecordManager(size_t blockSize, BufferPool* bufferPool = nullptr);
+    OrderedRecordManager(size_t blockSize, unsigned int orderedByColumnId, BufferPool* bufferPool = nullptr);
     virtual void Create(string path, Schema* schema) override;
     virtual void Open(string path) override;
     virtual void Close() override;
+    virtual void SetFileAccessMode(FileAccessMode mode) override;
+    virtual void SetWriteBack(bool enabled) override;
+    virtual void Checkpoint() override;
 
     // Inherited via BaseRecordManager
     virtual void Insert(Record record) override;
+    // Sorts the batch and writes its full blocks to the extension file as a run, merged into the main file later
+    virtual void InsertMany(span<const unsigned char> records) override;
+    using BaseRecordManager::InsertMany;
+    virtual void BeginBulkInsert() override;
+    virtual void EndBulkInsert() override;
     virtual Record* Select(unsigned long long id) override;
-    virtual vector<Record*> SelectWhereBetween(unsigned int columnId, span<unsigned char> min, span<unsigned char> max) override;
-    virtual vector<Record*> SelectWhereEquals(unsigned int columnId, span<unsigned char> data) override;
+    // Merges the sorted ids against the main file with a galloping search when ordered by the id
+    virtual ResultSet Select(vector<unsigned long long> ids) override;
+    // Conditions on the ordering column only read the main file blocks of their range
+    virtual ResultSet SelectWhere(const Predicate& predicate, const Projection* projection = nullptr) override;
+    virtual unique_ptr<RecordCursor> OpenCursorWhere(const Predicate& predicate) override;
     virtual void Delete(unsigned long long id) override;
     virtual int DeleteWhereEquals(unsigned int columnId, span<unsigned char> data) override;
 
@@ -43,7 +54,8 @@ protected:
     virtual FileHead* CreateNewFileHead(Schema* schema) override;
     virtual FileWrapper<FileHead>* GetFile() override;
     virtual unsigned long long GetBlocksCount() override;
-    virtual bool ReadBlock(Block* block, unsigned long long blockId) override;
+    virtual bool ReadBlock(Block* block, unsigned long long blockId, bool keepInPool = true) override;
+    virtual void ReadBlocks(unsigned long long firstBlockId, size_t count, span<unsigned char> destination) override;
     void MoveToExtension();
     bool MovePrev(Record* record, unsigned long long& accessedBlocks, unsigned long long& blockId, unsigned long long& recordNumberInBlock);
     virtual void DeleteInternal(unsigned long long recordId, unsigned long long blockNumber, unsigned long long recordNumberInBlock);
@@ -58,19 +70,35 @@ private:
     unsigned long long m_MaxExtensionFileSize;
     unsigned long long m_DeletedRecords;
     float m_MaxPercentEmptySpace;
+    // Sorted runs of blocks written by InsertMany, the other extension blocks are not sorted
+    vector<Partition> m_ExtensionRuns;
+    bool m_BulkInserting;
+
+    // A sorted run read backwards, one block at a time, by MergeExtension
+    struct MergeRun
+    {
+        FileWrapper<OrderedFileHead>* File;
+        unsigned long long FirstBlock;
+        unsigned long long NextBlock; // one past the next block to read
+        bool Sorted;
+        // Read buffer of the run, filled as the merge goes
+        vector<unsigned char> Records = {};
+        size_t RecordsLeft = 0;
+    };
 
     void AddToExtension(Block* block);
     void WriteToExtension(Block* block, unsigned long long blockNumber);
-    bool GetBlockFromExtension(Block* block, unsigned long long blockNumber);
-    bool GetBlockFromMainFile(Block* block, unsigned long long blockNumber);
+    bool GetBlockFromExtension(Block* block, unsigned long long blockNumber, bool keepInPool = true);
+    bool GetBlockFromMainFile(Block* block, unsigned long long blockNumber, bool keepInPool = true);
     void ReadPrevBlock();
     void MemoryReorder(); // reads all records from main file and extension file into memory and reorders, for debugging
     void ReorganizeInternal();  // inserts records from extension file into main file, reordering
+    void MergeExtension(); // merges the main file and every run of the extension file in a single pass
+    bool LoadPrevBlock(MergeRun& run, Block* buffer);
+    unique_ptr<RecordCursor> OpenRangeCursor(vector<unsigned char> min, vector<unsigned char> max, RecordCursor::FilterFunction filter);
+    unsigned long long FindFirstBlock(span<unsigned char> min);
+    bool GetValidValue(Block* block, bool first, span<unsigned char>* value);
     Record* BinarySearch(span<unsigned char> target, EvalFunctionType evalFunc, unsigned long long& accessedBlocks);
-    vector<Partition> SplitPartitions(vector<Partition> partitons);
-    vector<Partition> Split(Partition p);
-    vector<Partition> MergePartitions(vector<Partition> partitions, unsigned long deepestLevel);
-    Partition Merge(Partition p1, Partition p2);
 
     struct OrderedRecord
     {
@@ -8,31 +8,34 @@
 #include "../DatabaseSystems.Heap/HeapRecordManager.h"
 #include "../DatabaseSystem.Hash/HashRecordManager.h"
 #include "../DatabaseSystem.Ordered/OrderedRecordManager.h"
+#include "../DatabaseSystem.BTree/BTreeRecordManager.h"
 
 #define SPANOF(value) span<unsigned char>((unsigned char*)&value, sizeof(value))
 
 void runBenchmark(Table& table);
 void insertMany(Table& table, vector<Record> records);
+void insertFromCsv(Table& table, string path, unsigned long long lines);
 void findOne(Table& table);
 void findAllSet(Table& table);
 void findAllBetween(Table& table);
 void findAllEquals(Table& table);
 void deleteOne(Table& table);
 void deleteAllEquals(Table& table);
-void printRecords(vector<Record*> records, string label = "Records");
+void printRecords(const ResultSet& records, string label = "Records");
 
 int main()
 {
     auto fixedSchema = FixedRecord::CreateSchema();
 
     auto dbPath = ".\\test.db";
+    //auto heap = BTreeRecordManager(4096);
+    //auto heap = HashRecordManager(4096, HashingMode::EXTENDIBLE, 10);
+    //auto heap = HashRecordManager(4096, HashingMode::LINEAR, 10, 0.8f);
     auto heap = HashRecordManager(4096, 10);
     auto table = Table(heap);
     //table.Load(dbPath);
     table.Create(dbPath, fixedSchema);
-    auto records = Record::LoadFromCsv(*fixedSchema, ".\\cbd.csv", 9001);
-
-    insertMany(table, records);
+    insertFromCsv(table, ".\\cbd.csv", 9001);
     /*
     findOne(table);
     findAllSet(table);
@@ -43,7 +46,7 @@ int main()
     //*
     deleteAllEquals(table);
     findAllEquals(table);
-    //insertMany(table, records);
+    //insertFromCsv(table, ".\\cbd.csv", 9001);
     //*/
 
     table.Close();
@@ -64,6 +67,21 @@ void insertMany(Table& table, vector<Record> records)
     cout << endl;
 }
 
+void insertFromCsv(Table& table, string path, unsigned long long lines)
+{
+    cout << "[InsertFromCsv]" << endl;
+    auto start = std::chrono::high_resolution_clock::now();
+    auto count = table.InsertFromCsv(path, lines);
+    auto finish = std::chrono::high_resolution_clock::now();
+    auto microseconds = std::chrono::duration_cast<std::chrono::milliseconds>(finish - start);
+    cout << "- Count = " << count << endl;
+    cout << "- Duration = " << microseconds.count() << " ms" << endl;
+    cout << "- Space usage = " << table.GetSize() << " Bytes" << endl;
+    cout << "- Read Blocks = " << table.GetLastQueryBlockReadAccessCount() << endl;
+    cout << "- Write Blocks = " << table.GetLastQueryBlockWriteAccessCount() << endl;
+    cout << endl;
+}
+
 void findOne(Table& table)
 {
     cout << "[Find] Random Id" << endl;
@@ -179,13 +197,13 @@ void deleteAllEquals(Table& table)
     cout << endl;
 }
 
-void printRecords(vector<Record*> records, string label)
+void printRecords(const ResultSet& records, string label)
 {
     cout << "- " << label << " (" << records.size() << ") = [ ";
     for (auto record : records)
     {
         cout << endl;
-        record->Write(cout);
+        record.Write(cout);
         cout << ",";
     }
     cout << '\b' << "]" << endl;
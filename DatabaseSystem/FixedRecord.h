@@ -3,8 +3,9 @@
 #include "nameof.hpp"
 #include "../DatabaseSystem.Core/Record.h"
 #include "../DatabaseSystem.Core/Schema.h"
+#include "../DatabaseSystem.Core/RecordField.h"
 
-#pragma pack(1)
+#pragma pack(push, 1)
 struct FixedRecord {
     unsigned long long Id;
     char Gender;
@@ -24,4 +25,14 @@ struct FixedRecord {
 
     static Schema* CreateSchema();
 };
+#pragma pack(pop)
 
+// Typed fields of FixedRecord, at the offsets CreateSchema gives the columns
+namespace FixedRecordFields
+{
+    using Id = RECORD_FIELD(FixedRecord, Id);
+    using City = RECORD_FIELD(FixedRecord, City);
+    using Age = RECORD_FIELD(FixedRecord, Age);
+    using Weigth = RECORD_FIELD(FixedRecord, Weigth);
+    using Height = RECORD_FIELD(FixedRecord, Height);
+}
@@ -16,19 +16,15 @@ HeapFileHead::~HeapFileHead()
 void HeapFileHead::Serialize(iostream& dst)
 {
     FileHead::Serialize(dst);
-    dst << RemovedCount << endl;
-    dst << RemovedRecordHead.BlockId << endl;
-    dst << RemovedRecordHead.RecordNumberInBlock << endl;
-    dst << RemovedRecordTail.BlockId << endl;
-    dst << RemovedRecordTail.RecordNumberInBlock << endl;
+    WriteField(dst, RemovedCount);
+    WriteField(dst, RemovedRecordHead);
+    WriteField(dst, RemovedRecordTail);
 }
 
 void HeapFileHead::Deserialize(iostream& src)
 {
     FileHead::Deserialize(src);
-    src >> RemovedCount;
-    src >> RemovedRecordHead.BlockId;
-    src >> RemovedRecordHead.RecordNumberInBlock;
-    src >> RemovedRecordTail.BlockId;
-    src >> RemovedRecordTail.RecordNumberInBlock;
+    ReadField(src, RemovedCount);
+    ReadField(src, RemovedRecordHead);
+    ReadField(src, RemovedRecordTail);
 }
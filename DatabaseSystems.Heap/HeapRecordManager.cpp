@@ -2,9 +2,9 @@
 #include "HeapRecordManager.h"
 #include "../DatabaseSystem.Core/Assertions.h"
 
-HeapRecordManager::HeapRecordManager(size_t blockSize, float maxPercentEmptySpace) :
-    BaseRecordManager(),
-    m_File(new FileWrapper<HeapFileHead>(blockSize)),
+HeapRecordManager::HeapRecordManager(size_t blockSize, float maxPercentEmptySpace, BufferPool* bufferPool) :
+    BaseRecordManager(blockSize, bufferPool),
+    m_File(new FileWrapper<HeapFileHead>(blockSize, 0, m_BufferPool)),
     m_MaxPercentEmptySpace(maxPercentEmptySpace)
 {
 }
@@ -38,11 +38,11 @@ void HeapRecordManager::Insert(Record record)
         auto recordToRemoveHeapData = Record::Cast<HeapRecord>(&recordToReplace);
         fileHead->RemovedRecordHead = recordToRemoveHeapData->NextDeleted;
 
-        memcpy(recordToReplace.data(), record.GetData(), GetSchema()->GetSize());
-        
-        recordToRemoveHeapData->NextDeleted = fileHead->RemovedRecordHead;
+        memcpy(recordToReplace.data(), record.GetData()->data(), GetSchema()->GetSize());
+
         WriteBlock(m_ReadBlock, pointerToRecordToReplace.BlockId);
         fileHead->RemovedCount -= 1;
+        AddToIndexes(*record.GetData(), pointerToRecordToReplace.BlockId, pointerToRecordToReplace.RecordNumberInBlock);
         return;
     }
 
@@ -56,6 +56,46 @@ write_block:
 
     auto recordData = record.GetData();
     m_WriteBlock->Append(*recordData);
+    // The write block is written as the block after the last one
+    AddToIndexes(*recordData, GetBlocksCount(), m_WriteBlock->GetRecordsCount() - 1);
+}
+
+void HeapRecordManager::InsertMany(span<const unsigned char> records)
+{
+    ClearAccessCount();
+    unsigned long long readAccessedBlocks = 0;
+    unsigned long long writeAccessedBlocks = 0;
+
+    auto fileHead = m_File->GetHead();
+    auto recordSize = (size_t)GetSchema()->GetSize();
+    size_t offset = 0;
+
+    // Each removed slot costs a read and a write anyway, reuse them as Insert does
+    auto record = Record(GetSchema());
+    while (fileHead->RemovedCount > 0 && offset + recordSize <= records.size())
+    {
+        memcpy(record.GetData()->data(), records.data() + offset, recordSize);
+        Insert(record);
+        offset += recordSize;
+
+        readAccessedBlocks += m_LastQueryBlockReadAccessCount;
+        writeAccessedBlocks += m_LastQueryBlockWriteAccessCount;
+    }
+    m_LastQueryBlockReadAccessCount = readAccessedBlocks;
+    m_LastQueryBlockWriteAccessCount = writeAccessedBlocks;
+
+    // The rest goes through the write block, each block is written once when full
+    for (; offset + recordSize <= records.size(); offset += recordSize)
+    {
+        if (m_WriteBlock->GetRecordsCount() == m_RecordsPerBlock)
+        {
+            AddBlock(m_WriteBlock);
+            m_WriteBlock->Clear();
+        }
+        AppendRecord(m_WriteBlock, records.subspan(offset, recordSize), fileHead->NextId);
+        fileHead->NextId += 1;
+        AddToIndexes(m_WriteBlock, GetBlocksCount(), m_WriteBlock->GetRecordsCount() - 1);
+    }
 }
 
 FileHead* HeapRecordManager::CreateNewFileHead(Schema* schema)
@@ -150,6 +190,8 @@ void HeapRecordManager::Reorganize()
         return;
     }
 
+    // The last records are moved into the removed slots
+    InvalidateIndexes();
     auto pointerToRecordToReplace = fileHead->RemovedRecordHead;
     ReadBlock(m_WriteBlock, pointerToRecordToReplace.BlockId);
 
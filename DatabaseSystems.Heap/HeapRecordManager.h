@@ -13,10 +13,13 @@
 class HeapRecordManager : public BaseRecordManager
 {
 public:
-	HeapRecordManager(size_t blockSize, float reorderCount);
+	HeapRecordManager(size_t blockSize, float reorderCount, BufferPool* bufferPool = nullptr);
 
 	// Inherited via BaseRecordManager
 	virtual void Insert(Record record) override;
+	// Fills the removed slots first, then writes full blocks one after the other at the end of the file
+	virtual void InsertMany(span<const unsigned char> records) override;
+	using BaseRecordManager::InsertMany;
 
 protected:
 	// Inherited via BaseRecordManager